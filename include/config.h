@@ -67,6 +67,8 @@
 #endif
 #ifdef MADWEASEL_MUEHLE_PERFECT_AI
 #define MADWEASEL_MUEHLE_RULE
+/// Probe the perfect database layers in memory as a tablebase during the search
+#define PERFECT_DATABASE_PROBE_ENABLE
 #endif
 #endif
 #endif
@@ -95,9 +97,33 @@
 //#define TRANSPOSITION_TABLE_DEBUG
 #endif
 
+/// Resolve pending removes and immediate mill closures at the leaves of the
+/// search instead of evaluating them statically. Off by default: it costs
+/// search time and has not yet been shown to gain strength.
+//#define QUIESCENCE_ENABLE
+
+/// Cache static evaluations per thread, sized by the "EvalCache" UCI option
+#define EVAL_CACHE_ENABLE
+
+#ifdef EVAL_CACHE_ENABLE
+//#define EVAL_CACHE_DEBUG
+#endif
+
+/// Build the optional NNUE evaluation, selected by the "UseNNUE" and
+/// "EvalFile" UCI options. The accumulator makes Position larger, which slows
+/// down the search even while the scalar evaluation is used.
+//#define NNUE_ENABLE
+
+/// Probe the transposition table and the endgame hash map with a key that is
+/// shared by all 16 symmetric images of a position.
+//#define SYMMETRY_KEY_ENABLE
+
 //#define DISABLE_PREFETCH
 
 //#define BITBOARD_DEBUG
+
+/// Verify the incrementally updated hash key against a full recomputation
+//#define HASH_KEY_DEBUG
 #ifndef USE_POPCNT
 #define USE_POPCNT
 #endif
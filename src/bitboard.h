@@ -45,6 +45,8 @@ constexpr Bitboard FileABB = 0x0000FF00;
 constexpr Bitboard FileBBB = FileABB << (8 * 1);
 constexpr Bitboard FileCBB = FileABB << (8 * 2);
 
+constexpr Bitboard BoardBB = FileABB | FileBBB | FileCBB;
+
 constexpr Bitboard Rank1BB = 0x01010100;
 constexpr Bitboard Rank2BB = Rank1BB << 1;
 constexpr Bitboard Rank3BB = Rank1BB << 2;
@@ -168,4 +170,35 @@ inline int popcount(Bitboard b) noexcept
 #endif
 }
 
+
+/// lsb() returns the least significant bit in a non-zero bitboard
+
+inline Square lsb(Bitboard b) noexcept
+{
+    assert(b);
+
+#if defined(_MSC_VER) && !defined(__INTEL_COMPILER)
+
+    unsigned long idx;
+    _BitScanForward(&idx, b);
+    return (Square)idx;
+
+#else // Assumed gcc or compatible compiler
+
+    return Square(__builtin_ctz(b));
+
+#endif
+}
+
+
+/// pop_lsb() finds and clears the least significant bit in a non-zero bitboard
+
+inline Square pop_lsb(Bitboard *b) noexcept
+{
+    assert(*b);
+    const Square s = lsb(*b);
+    *b &= *b - 1;
+    return s;
+}
+
 #endif // #ifndef BITBOARD_H_INCLUDED
@@ -19,36 +19,274 @@
 #include "endgame.h"
 
 #ifdef ENDGAME_LEARNING
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
 static constexpr int endgameHashSize = 0x1000000;   // 16M
 HashMap<Key, Endgame> endgameHashMap(endgameHashSize);
 
-void mergeEndgameFile(const string &file1, const string &file2, const string &mergedFile)
+namespace {
+
+typedef HashNode<Key, Endgame> EndgameNode;
+
+// Number of slots each worker buffers per step, shared by all inputs. Inputs
+// are direct-mapped tables of the same size, so slot i of every file competes
+// for slot i of the output and the k-way merge is a slot-aligned sweep.
+constexpr size_t MERGE_CHUNK_SLOTS = 0x10000;
+
+bool is_empty(const EndgameNode &node)
+{
+    return node.getKey() == 0;
+}
+
+bool same_node(const EndgameNode &a, const EndgameNode &b)
+{
+    return memcmp(&a, &b, sizeof(EndgameNode)) == 0;
+}
+
+/// resolve_slot() picks the output node for one slot from the occupants
+/// found in the inputs, and updates the agreement statistics.
+
+EndgameNode resolve_slot(const EndgameNode *cands, size_t n,
+                         EndgameMergePolicy policy, EndgameMergeStats &stats)
+{
+    EndgameNode result;
+    const EndgameNode *first = nullptr;
+    bool keyConflict = false;
+    bool resultConflict = false;
+
+    memset((void *)&result, 0, sizeof(result));
+
+    for (size_t i = 0; i < n; i++) {
+        if (is_empty(cands[i]))
+            continue;
+
+        if (first == nullptr) {
+            first = &cands[i];
+        } else if (cands[i].getKey() != first->getKey()) {
+            keyConflict = true;
+        } else if (!same_node(cands[i], *first)) {
+            resultConflict = true;
+        }
+    }
+
+    if (first == nullptr)
+        return result;
+
+    stats.occupied++;
+
+    if (keyConflict)
+        stats.keyConflicts++;
+    if (resultConflict)
+        stats.resultConflicts++;
+
+    if (!keyConflict && !resultConflict) {
+        stats.unanimous++;
+        result = *first;
+    } else if (policy == EndgameMergePolicy::first) {
+        result = *first;
+    } else if (policy == EndgameMergePolicy::majority) {
+        // Vote on the key first, then on the result among nodes with that key.
+        // Ties go to the occupant seen first, as in the legacy merge.
+        size_t bestVotes = 0;
+
+        for (size_t i = 0; i < n; i++) {
+            if (is_empty(cands[i]))
+                continue;
+
+            size_t keyVotes = 0;
+            size_t nodeVotes = 0;
+
+            for (size_t j = 0; j < n; j++) {
+                if (cands[j].getKey() == cands[i].getKey()) {
+                    keyVotes++;
+                    if (same_node(cands[j], cands[i]))
+                        nodeVotes++;
+                }
+            }
+
+            size_t votes = keyVotes * (n + 1) + nodeVotes;
+
+            if (votes > bestVotes) {
+                bestVotes = votes;
+                result = cands[i];
+            }
+        }
+    }
+
+    if (is_empty(result))
+        stats.dropped++;
+    else
+        stats.merged++;
+
+    return result;
+}
+
+/// merge_range() merges the slots [begin, end) of all inputs into the output.
+/// Every worker owns its own streams, so no locking is needed. The buffer
+/// holds MERGE_CHUNK_SLOTS slots in total, so each input gets a share of it.
+
+bool merge_range(const vector<string> &inputs, const string &output,
+                 EndgameMergePolicy policy, size_t begin, size_t end,
+                 EndgameMergeStats &stats)
+{
+    const size_t k = inputs.size();
+    const size_t chunkSlots = std::max<size_t>(1, MERGE_CHUNK_SLOTS / k);
+    vector<ifstream> in(k);
+    vector<EndgameNode> chunks(k * chunkSlots);
+    vector<EndgameNode> merged(chunkSlots);
+    vector<EndgameNode> cands(k);
+    fstream out(output, ios::in | ios::out | ios::binary);
+
+    if (!out)
+        return false;
+
+    for (size_t f = 0; f < k; f++) {
+        in[f].open(inputs[f], ios::in | ios::binary);
+        if (!in[f].is_open())
+            return false;
+    }
+
+    for (size_t base = begin; base < end; base += chunkSlots) {
+        size_t count = std::min(chunkSlots, end - base);
+        streamoff offset = (streamoff)(base * sizeof(EndgameNode));
+
+        // Short inputs simply contribute empty slots
+        memset((void *)chunks.data(), 0, sizeof(EndgameNode) * k * chunkSlots);
+
+        for (size_t f = 0; f < k; f++) {
+            in[f].clear();
+            in[f].seekg(offset);
+            in[f].read((char *)&chunks[f * chunkSlots],
+                       (streamsize)(count * sizeof(EndgameNode)));
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            for (size_t f = 0; f < k; f++) {
+                cands[f] = chunks[f * chunkSlots + i];
+            }
+            merged[i] = resolve_slot(cands.data(), k, policy, stats);
+        }
+
+        stats.slots += count;
+
+        out.seekp(offset);
+        out.write((const char *)merged.data(), (streamsize)(count * sizeof(EndgameNode)));
+    }
+
+    return (bool)out;
+}
+
+} // namespace
+
+/// mergeEndgameFiles() merges any number of learned endgame files into one.
+/// The slot range is split across 'threads' workers, each of which streams
+/// its part of every input through a buffer of fixed size, so no input is
+/// ever fully loaded. Every worker opens all inputs, so 'threads' times the
+/// number of inputs files are open at once. A missing input fails the merge.
+
+bool mergeEndgameFiles(const vector<string> &inputs, const string &output,
+                       EndgameMergePolicy policy, size_t threads,
+                       EndgameMergeStats &stats)
 {
-    HashMap<Key, Endgame> map1(endgameHashSize);
-    HashMap<Key, Endgame> map2(endgameHashSize);
+    const size_t slots = endgameHashSize;
+
+    stats = EndgameMergeStats();
+
+    if (inputs.empty())
+        return false;
+
+    for (const auto &input : inputs) {
+        ifstream file(input, ios::in | ios::binary);
+        if (!file.is_open()) {
+            loggerDebug("[endgame] Cannot open %s\n", input.c_str());
+            return false;
+        }
+    }
+
+    threads = std::max<size_t>(1, std::min(threads, slots / MERGE_CHUNK_SLOTS));
 
-    map1.load(file1);
-    map2.load(file2);
+    // Merge into a temporary file, so that an input may also be the output
+    const string tmpFile = output + ".tmp";
 
-    map1.merge(map2);
+    {
+        ofstream file(tmpFile, ios::out | ios::binary | ios::trunc);
+        file.seekp((streamoff)(slots * sizeof(EndgameNode) - 1));
+        file.put(0);
+        if (!file)
+            return false;
+    }
+
+    vector<EndgameMergeStats> partial(threads);
+    vector<std::thread> workers;
+    vector<char> ok(threads, 0);
+    size_t step = (slots / threads + MERGE_CHUNK_SLOTS - 1) / MERGE_CHUNK_SLOTS * MERGE_CHUNK_SLOTS;
+
+    for (size_t t = 0; t < threads; t++) {
+        size_t begin = std::min(slots, t * step);
+        size_t end = std::min(slots, begin + step);
+
+        workers.emplace_back([&, t, begin, end] {
+            ok[t] = merge_range(inputs, tmpFile, policy, begin, end, partial[t]);
+        });
+    }
+
+    for (auto &w : workers) {
+        w.join();
+    }
+
+    for (size_t t = 0; t < threads; t++) {
+        if (!ok[t]) {
+            remove(tmpFile.c_str());
+            return false;
+        }
+
+        stats.slots += partial[t].slots;
+        stats.occupied += partial[t].occupied;
+        stats.merged += partial[t].merged;
+        stats.unanimous += partial[t].unanimous;
+        stats.keyConflicts += partial[t].keyConflicts;
+        stats.resultConflicts += partial[t].resultConflicts;
+        stats.dropped += partial[t].dropped;
+    }
+
+    remove(output.c_str());
+
+    if (rename(tmpFile.c_str(), output.c_str()) != 0)
+        return false;
 
-    map1.dump(mergedFile);
+    loggerDebug("[endgame] Merged %zu files to %s: occupied = %zu, merged = %zu, "
+                "unanimous = %zu (%f%%), keyConflicts = %zu, resultConflicts = %zu, dropped = %zu\n",
+                inputs.size(), output.c_str(), stats.occupied, stats.merged,
+                stats.unanimous, stats.occupied ? (double)stats.unanimous * 100 / stats.occupied : 0.0,
+                stats.keyConflicts, stats.resultConflicts, stats.dropped);
 
-    loggerDebug("[endgame] Merge %s to %s and save to %s\n",
-                file2.c_str(),
-                file1.c_str(),
-                mergedFile.c_str());
+    return true;
+}
+
+void mergeEndgameFile(const string &file1, const string &file2, const string &mergedFile)
+{
+    EndgameMergeStats stats;
+
+    mergeEndgameFiles({ file1, file2 }, mergedFile, EndgameMergePolicy::first,
+                      std::thread::hardware_concurrency(), stats);
 }
 
 int mergeEndgameFile_main()
 {
-    string filename;
+    vector<string> inputs { "endgame.txt" };
+    EndgameMergeStats stats;
 
     for (char ch = '0'; ch <= '9'; ch++) {
-        filename = ch + "/endgame.txt";
-        mergeEndgameFile("endgame.txt", filename, "endgame.txt");
+        inputs.push_back(string(1, ch) + "/endgame.txt");
     }
 
+    mergeEndgameFiles(inputs, "endgame.txt", EndgameMergePolicy::first,
+                      std::thread::hardware_concurrency(), stats);
+
 #ifdef _WIN32
     system("pause");
 #endif
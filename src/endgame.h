@@ -23,6 +23,7 @@
 
 #ifdef ENDGAME_LEARNING
 
+#include <string>
 #include <vector>
 
 #include "types.h"
@@ -48,6 +49,31 @@ struct Endgame
 
 extern HashMap<Key, Endgame> endgameHashMap;
 
+/// How a slot is resolved when the input files disagree on it
+enum class EndgameMergePolicy
+{
+    first,      // Keep the first occupant in input order (legacy behaviour)
+    majority,   // Keep the most frequent key, then its most frequent result
+    unanimous,  // Keep the slot only if every occupant agrees on key and result
+};
+
+struct EndgameMergeStats
+{
+    size_t slots {0};           // Slots scanned
+    size_t occupied {0};        // Slots occupied in at least one input
+    size_t merged {0};          // Slots written to the output
+    size_t unanimous {0};       // Occupied slots on which all inputs agree
+    size_t keyConflicts {0};    // Slots holding different keys
+    size_t resultConflicts {0}; // Slots holding the same key with different results
+    size_t dropped {0};         // Occupied slots left empty by the policy
+};
+
+bool mergeEndgameFiles(const vector<string> &inputs, const string &output,
+                       EndgameMergePolicy policy, size_t threads,
+                       EndgameMergeStats &stats);
+void mergeEndgameFile(const string &file1, const string &file2, const string &mergedFile);
+int mergeEndgameFile_main();
+
 #endif // ENDGAME_LEARNING
 
 #endif // #ifndef ENDGAME_H_INCLUDED
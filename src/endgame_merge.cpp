@@ -0,0 +1,101 @@
+﻿/*
+  This file is part of Sanmill.
+  Copyright (C) 2019-2021 The Sanmill developers (see AUTHORS file)
+
+  Sanmill is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Sanmill is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "endgame.h"
+
+#ifdef ENDGAME_LEARNING
+
+/// Standalone tool that merges the endgame.txt files collected from many
+/// self-play workers into one file:
+///
+///   sanmill-endgame-merge [-j threads] [-p first|majority|unanimous]
+///                         -o merged.txt input1.txt input2.txt ...
+
+namespace {
+
+int usage()
+{
+    std::cerr << "Usage: sanmill-endgame-merge [-j threads] [-p first|majority|unanimous] "
+                 "-o output input..." << std::endl;
+    return EXIT_FAILURE;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    vector<string> inputs;
+    string output;
+    size_t threads = std::thread::hardware_concurrency();
+    EndgameMergePolicy policy = EndgameMergePolicy::majority;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+
+        if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "-j" && i + 1 < argc) {
+            threads = (size_t)std::max(1, atoi(argv[++i]));
+        } else if (arg == "-p" && i + 1 < argc) {
+            string p = argv[++i];
+
+            if (p == "first")
+                policy = EndgameMergePolicy::first;
+            else if (p == "majority")
+                policy = EndgameMergePolicy::majority;
+            else if (p == "unanimous")
+                policy = EndgameMergePolicy::unanimous;
+            else
+                return usage();
+        } else if (!arg.empty() && arg[0] == '-') {
+            return usage();
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (output.empty() || inputs.empty())
+        return usage();
+
+    EndgameMergeStats stats;
+
+    if (!mergeEndgameFiles(inputs, output, policy, threads, stats)) {
+        std::cerr << "Failed to merge into " << output << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "inputs:           " << inputs.size() << "\n"
+              << "slots:            " << stats.slots << "\n"
+              << "occupied:         " << stats.occupied << "\n"
+              << "merged:           " << stats.merged << "\n"
+              << "unanimous:        " << stats.unanimous << "\n"
+              << "key conflicts:    " << stats.keyConflicts << "\n"
+              << "result conflicts: " << stats.resultConflicts << "\n"
+              << "dropped:          " << stats.dropped << std::endl;
+
+    return EXIT_SUCCESS;
+}
+
+#endif // ENDGAME_LEARNING
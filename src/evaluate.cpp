@@ -16,14 +16,20 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+
 #include "bitboard.h"
 #include "evaluate.h"
+#include "movegen.h"
 #include "thread.h"
 #include "option.h"
 
+#include "nnue/evaluate_nnue.h"
+
 namespace
 {
 
+template<class R>
 class Evaluation
 {
 public:
@@ -43,7 +49,8 @@ private:
 // parts of the evaluation and returns the value of the position from the point
 // of view of the side to move.
 
-Value Evaluation::value()
+template<class R>
+Value Evaluation<R>::value()
 {
     Value value = VALUE_ZERO;
 
@@ -57,15 +64,27 @@ Value Evaluation::value()
         break;
 
     case Phase::placing:
-        if (gameOptions.getConsiderMobility()) {
-            value += pos.get_mobility_diff();
-        }
+#ifdef NNUE_ENABLE
+        // The network replaces the material, mobility and pattern terms
+        if (Eval::useNNUE) {
+            value = Eval::NNUE::evaluate(pos);
+        } else
+#endif // NNUE_ENABLE
+        {
+            if (gameOptions.getConsiderMobility()) {
+                value += pos.get_mobility_diff();
+            }
 
-        pieceInHandDiffCount = pos.piece_in_hand_count(WHITE) - pos.piece_in_hand_count(BLACK);
-        value += VALUE_EACH_PIECE_INHAND * pieceInHandDiffCount;
+            pieceInHandDiffCount = pos.piece_in_hand_count(WHITE) - pos.piece_in_hand_count(BLACK);
+            value += VALUE_EACH_PIECE_INHAND * pieceInHandDiffCount;
 
-        pieceOnBoardDiffCount = pos.piece_on_board_count(WHITE) - pos.piece_on_board_count(BLACK);
-        value += VALUE_EACH_PIECE_ONBOARD * pieceOnBoardDiffCount;
+            pieceOnBoardDiffCount = pos.piece_on_board_count(WHITE) - pos.piece_on_board_count(BLACK);
+            value += VALUE_EACH_PIECE_ONBOARD * pieceOnBoardDiffCount;
+
+            if (gameOptions.getConsiderPattern()) {
+                value += pos.pattern_value();
+            }
+        }
 
         switch (pos.get_action()) {
         case Action::select:
@@ -82,11 +101,22 @@ Value Evaluation::value()
         break;
 
     case Phase::moving:
-        if (gameOptions.getConsiderMobility()) {
-            value += pos.get_mobility_diff();
-        }
+#ifdef NNUE_ENABLE
+        if (Eval::useNNUE) {
+            value = Eval::NNUE::evaluate(pos);
+        } else
+#endif // NNUE_ENABLE
+        {
+            if (gameOptions.getConsiderMobility()) {
+                value += pos.get_mobility_diff();
+            }
+
+            value = (pos.piece_on_board_count(WHITE) - pos.piece_on_board_count(BLACK)) * VALUE_EACH_PIECE_ONBOARD;
 
-        value = (pos.piece_on_board_count(WHITE) - pos.piece_on_board_count(BLACK)) * VALUE_EACH_PIECE_ONBOARD;
+            if (gameOptions.getConsiderPattern()) {
+                value += pos.pattern_value();
+            }
+        }
 
         switch (pos.get_action()) {
         case Action::select:
@@ -104,20 +134,20 @@ Value Evaluation::value()
 
     case Phase::gameOver:
         if (pos.piece_on_board_count(WHITE) + pos.piece_on_board_count(BLACK) >= EFFECTIVE_SQUARE_NB) {
-            if (rule.isWhiteLoseButNotDrawWhenBoardFull) {
+            if (R::rule.isWhiteLoseButNotDrawWhenBoardFull) {
                 value -= VALUE_MATE;
             } else {
                 value = VALUE_DRAW;
             }
         } else if (pos.get_action() == Action::select &&
-                   pos.is_all_surrounded(pos.side_to_move()) &&
-                   rule.isLoseButNotChangeSideWhenNoWay) {
+                   pos.is_all_surrounded<R>(pos.side_to_move()) &&
+                   R::rule.isLoseButNotChangeSideWhenNoWay) {
             const Value delta = pos.side_to_move() == WHITE ? -VALUE_MATE : VALUE_MATE;
             value += delta;
         }
-        else if (pos.piece_on_board_count(WHITE) < rule.piecesAtLeastCount) {
+        else if (pos.piece_on_board_count(WHITE) < R::rule.piecesAtLeastCount) {
             value -= VALUE_MATE;
-        } else if (pos.piece_on_board_count(BLACK) < rule.piecesAtLeastCount) {
+        } else if (pos.piece_on_board_count(BLACK) < R::rule.piecesAtLeastCount) {
             value += VALUE_MATE;
         }
 
@@ -132,7 +162,7 @@ Value Evaluation::value()
     }
 
 #if EVAL_DRAW_WHEN_NOT_KNOWN_WIN_IF_MAY_FLY
-    if (pos.get_phase() == Phase::moving && rule.mayFly && !rule.hasDiagonalLines) {
+    if (pos.get_phase() == Phase::moving && R::rule.mayFly && !R::rule.hasDiagonalLines) {
         int piece_on_board_count_future_white = pos.piece_on_board_count(WHITE);
         int piece_on_board_count_future_black = pos.piece_on_board_count(BLACK);
 
@@ -162,7 +192,99 @@ Value Evaluation::value()
 /// evaluate() is the evaluator for the outer world. It returns a static
 /// evaluation of the position from the point of view of the side to move.
 
+template<class R>
 Value Eval::evaluate(Position &pos)
 {
-    return Evaluation(pos).value();
+#ifdef EVAL_CACHE_ENABLE
+    Thread *th = pos.this_thread();
+
+    if (th != nullptr) {
+        Value v;
+
+        if (th->evalCache.probe(pos.key(), v)) {
+            return v;
+        }
+
+        v = Evaluation<R>(pos).value();
+        th->evalCache.save(pos.key(), v);
+
+        return v;
+    }
+#endif // EVAL_CACHE_ENABLE
+
+    return Evaluation<R>(pos).value();
 }
+
+#define INSTANTIATE_EVALUATE(R) \
+    template Value Eval::evaluate<R>(Position &pos);
+
+FOR_EACH_RULE_VARIANT(INSTANTIATE_EVALUATE)
+
+#undef INSTANTIATE_EVALUATE
+
+int Eval::LineConfigValue[LINE_CONFIG_NB];
+int Eval::SquareValue[SQUARE_NB];
+
+/// Eval::init_pattern() fills the pattern tables. It must be called after the
+/// adjacency and mill tables of the current rule are built. A line with two
+/// pieces of one colour and an empty square threatens a mill, a closed mill
+/// may be opened and closed again; squares with more neighbours give a piece
+/// more room to move.
+
+void Eval::init_pattern()
+{
+    for (int config = 0; config < LINE_CONFIG_NB; config++) {
+        int count[COLOR_NB] = { 0 };
+
+        for (int c = config; c; c /= 3) {
+            if (c % 3) {
+                count[c % 3 == 1 ? WHITE : BLACK]++;
+            }
+        }
+
+        int v = 0;
+
+        if (count[BLACK] == 0) {
+            v = count[WHITE] == 2 ? 2 : count[WHITE] == 3 ? 1 : 0;
+        } else if (count[WHITE] == 0) {
+            v = count[BLACK] == 2 ? -2 : count[BLACK] == 3 ? -1 : 0;
+        }
+
+        LineConfigValue[config] = v;
+    }
+
+    for (Square s = SQ_0; s < SQUARE_NB; ++s) {
+        SquareValue[s] = s >= SQ_BEGIN && s < SQ_END ?
+            std::max(popcount(MoveList<LEGAL>::adjacentSquaresBB[s]) - 2, 0) : 0;
+    }
+}
+
+#ifdef EVAL_CACHE_ENABLE
+
+/// Eval::Cache::resize() sets the size of the cache, measured in megabytes.
+/// The number of entries is rounded down to a power of two.
+
+void Eval::Cache::resize(size_t mbSize)
+{
+    size_t count = mbSize * 1024 * 1024 / sizeof(Entry);
+
+    while (count & (count - 1)) {
+        count &= count - 1;
+    }
+
+    table.assign(count, Entry());
+    mask = count ? (Key)(count - 1) : 0;
+    hits = misses = 0;
+}
+
+
+/// Eval::Cache::clear() invalidates all entries, e.g. when the rules or the
+/// evaluation options change.
+
+void Eval::Cache::clear() noexcept
+{
+    std::fill(table.begin(), table.end(), Entry());
+    hits = misses = 0;
+}
+
+#endif // EVAL_CACHE_ENABLE
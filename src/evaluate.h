@@ -20,15 +20,85 @@
 #define EVALUATE_H_INCLUDED
 
 #include <string>
+#include <vector>
 
+#include "config.h"
+#include "rule.h"
 #include "types.h"
 
 class Position;
 
 namespace Eval {
 
+template<class R = CustomRule>
 Value evaluate(Position &pos);
 
+/// Pattern evaluation. Every mill line is scored by the colour configuration
+/// of its three squares, indexed in base 3 (empty 0, white 1, black 2), and
+/// every piece by the square it stands on. The position keeps the sum of the
+/// table values up to date from WHITE's point of view, see Position::pattern_on().
+
+constexpr int LINE_CONFIG_NB = 27;
+
+extern int LineConfigValue[LINE_CONFIG_NB];
+extern int SquareValue[SQUARE_NB];
+
+void init_pattern();
+
+#ifdef EVAL_CACHE_ENABLE
+
+/// Eval::Cache is a small direct-mapped table of static evaluations indexed
+/// by the position key. Every search thread owns one, so no locking is needed.
+/// An empty cache (size 0) disables caching.
+
+class Cache
+{
+public:
+    void resize(size_t mbSize);
+    void clear() noexcept;
+
+    bool probe(Key key, Value &value) noexcept
+    {
+        if (table.empty()) {
+            return false;
+        }
+
+        const Entry &e = table[key & mask];
+
+        if (e.key == key && e.used) {
+            value = e.value;
+            hits++;
+            return true;
+        }
+
+        misses++;
+        return false;
+    }
+
+    void save(Key key, Value value) noexcept
+    {
+        if (!table.empty()) {
+            table[key & mask] = { key, value, true };
+        }
+    }
+
+    size_t hits { 0 };
+    size_t misses { 0 };
+
+private:
+    struct Entry
+    {
+        Key key;
+        Value value;
+        bool used;
+    };
+
+    std::vector<Entry> table;
+    Key mask { 0 };
+};
+
+#endif // EVAL_CACHE_ENABLE
+
 }
 
 #endif // #ifndef EVALUATE_H_INCLUDED
@@ -20,10 +20,12 @@
 #include <random>
 
 #include "bitboard.h"
+#include "evaluate.h"
 #include "movegen.h"
 #include "misc.h"
 #include "option.h"
 #include "position.h"
+#include "tune.h"
 
 const char *loseReasonNoWayStr = "Player%d no way to go. Player%d win!";
 const char *loseReasonTimeOverStr = "Time over. Player%d win!";
@@ -371,6 +373,56 @@ void mill_table_init()
     } else {
         memcpy(Position::millTableBB, millTableBB, sizeof(Position::millTableBB));
     }
+
+    // Collect each mill line once as a three-square bitboard. Unused slots
+    // stay empty, which never adds anything to Position::pieces_in_mills().
+    int n = 0;
+
+    memset(Position::millLinesBB, 0, sizeof(Position::millLinesBB));
+
+    for (Square s = SQ_BEGIN; s < SQ_END; ++s) {
+        for (int l = 0; l < LD_NB; l++) {
+            const Bitboard mt = Position::millTableBB[s][l];
+
+            if (mt == 0 || mt == ~0U) {
+                continue;
+            }
+
+            const Bitboard line = mt | square_bb(s);
+
+            if (std::find(Position::millLinesBB, Position::millLinesBB + n, line) == Position::millLinesBB + n) {
+                assert(n < Position::MILL_LINE_NB);
+                Position::millLinesBB[n++] = line;
+            }
+        }
+    }
+
+    // Squares of each line and lines through each square, used by the
+    // incremental pattern evaluation
+    for (int l = 0; l < n; l++) {
+        Bitboard b = Position::millLinesBB[l];
+
+        for (int i = 0; i < 3; i++) {
+            Position::lineSquares[l][i] = pop_lsb(&b);
+        }
+    }
+
+    for (Square s = SQ_0; s < SQUARE_NB; ++s) {
+        int k = 0;
+
+        for (int l = 0; l < n; l++) {
+            if (Position::millLinesBB[l] & s) {
+                assert(k < LD_NB);
+                Position::squareLines[s][k++] = l;
+            }
+        }
+
+        while (k < LD_NB) {
+            Position::squareLines[s][k++] = -1;
+        }
+    }
+
+    Eval::init_pattern();
 }
 
 void move_priority_list_shuffle()
@@ -474,32 +526,12 @@ Depth get_search_depth(const Position *pos)
                 return (Depth)level;
             }
 
-            const Depth placingDepthTable9[25] = {
-                 +1,  1,  +1,  1,    /* 0 ~ 3 */
-                 +3,  3,  +3, 15,    /* 4 ~ 7 */
-                 +5,  3,  +5,  0,    /* 8 ~ 11 */
-                 +0,  0,  +0,  0,    /* 12 ~ 15 */
-                 +0,  0,  +0,  0,    /* 16 ~ 19 */
-                 +0,  0,  +0,  0,    /* 20 ~ 23 */
-                 +0                  /* 24 */
-            };
-
-            const Depth placingDepthTable12[25] = {
-                 +1,  2,  +2,  4,    /* 0 ~ 3 */
-                 +4, 12, +12, 18,    /* 4 ~ 7 */
-                +12,  0,  +0,  0,    /* 8 ~ 11 */
-                 +0,  0,  +0,  0,    /* 12 ~ 15 */
-                 +0,  0,  +0,  0,    /* 16 ~ 19 */
-                 +0,  0,  +0,  0,    /* 20 ~ 23 */
-                 +0                  /* 24 */
-            };
-
             const int index = rule.piecesCount * 2 - pos->count<IN_HAND>(WHITE) - pos->count<IN_HAND>(BLACK);
 
             if (rule.hasDiagonalLines) {
-                d = placingDepthTable12[index];
+                d = Tune::PlacingDepth12[index];
             } else {
-                d = placingDepthTable9[index];
+                d = Tune::PlacingDepth9[index];
             }
 
 #if 0
@@ -532,35 +564,6 @@ Depth get_search_depth(const Position *pos)
     Depth reduce = 0;
 #endif
 
-    const Depth placingDepthTable_12[25] = {
-         +1,  2,  +2,  4,     /* 0 ~ 3 */
-         +4, 12, +12, 18,     /* 4 ~ 7 */
-        +12, 16, +16, 16,     /* 8 ~ 11 */
-        +16, 16, +16, 17,     /* 12 ~ 15 */
-        +17, 16, +16, 15,     /* 16 ~ 19 */
-        +15, 14, +14, 14,     /* 20 ~ 23 */
-        +14                   /* 24 */
-    };
-
-    const Depth placingDepthTable_12_special[25] = {
-         +1,  2,  +2,  4,     /* 0 ~ 3 */
-         +4, 12, +12, 12,     /* 4 ~ 7 */
-        +12, 13, +13, 13,     /* 8 ~ 11 */
-        +13, 13, +13, 13,     /* 12 ~ 15 */
-        +13, 13, +13, 13,     /* 16 ~ 19 */
-        +13, 13, +13, 13,     /* 20 ~ 23 */
-        +13                   /* 24 */
-    };
-
-    const Depth placingDepthTable_9[20] = {
-         +1, 7,  +7,  10,     /* 0 ~ 3 */
-        +10, 12, +12, 14,     /* 4 ~ 7 */
-        +14, 14, +14, 14,     /* 8 ~ 11 */
-        +14, 14, +14, 14,     /* 12 ~ 15 */
-        +14, 14, +14,         /* 16 ~ 18 */
-        +14                   /* 19 */
-    };
-
     const Depth movingDepthTable[24] = {
          1,  1,  1,  1,     /* 0 ~ 3 */
          1,  1, 11, 11,     /* 4 ~ 7 */
@@ -591,13 +594,13 @@ Depth get_search_depth(const Position *pos)
 
         if (rule.piecesCount == 9) {
             assert(0 <= index && index <= 19);
-            d = placingDepthTable_9[index];
+            d = Tune::DevPlacingDepth9[index];
         } else {
             assert(0 <= index && index <= rule.piecesCount * 2);
             if (!rule.hasBannedLocations && !rule.hasDiagonalLines) {
-                d = placingDepthTable_12_special[index];
+                d = Tune::DevPlacingDepth12Special[index];
             } else {
-                d = placingDepthTable_12[index];
+                d = Tune::DevPlacingDepth12[index];
             }
         }
     }
@@ -16,55 +16,59 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "bitboard.h"
 #include "movegen.h"
 #include "position.h"
 #include "mills.h"
 
-/// generate<MOVE> generates all moves.
+namespace
+{
+
+/// generate_moves() generates all moves. It works on bitboards only and does
+/// not select pieces, so the position is left untouched.
 /// Returns a pointer to the end of the move moves.
-template<>
-ExtMove *generate<MOVE>(Position &pos, ExtMove *moveList)
+template<class R>
+ExtMove *generate_moves(Position &pos, ExtMove *moveList)
 {
     Square from = SQ_0, to = SQ_0;
     ExtMove *cur = moveList;
 
+    const Color us = pos.side_to_move();
+    const Bitboard ours = pos.pieces(us);
+    const Bitboard empty = ~pos.pieces() & BoardBB;
+
+    // piece count < 3 or 4 and allow fly, if is empty point, that's ok
+    const bool mayFly = R::rule.mayFly && pos.piece_on_board_count(us) <= R::rule.flyPieceCount;
+
     // move piece that location weak first
     for (auto i = EFFECTIVE_SQUARE_NB - 1; i >= 0; i--) {
         from = MoveList<LEGAL>::movePriorityList[i];
 
-        if (!pos.select_piece(from)) {
+        if (!(ours & from)) {
             continue;
         }
 
-        if (rule.mayFly && pos.piece_on_board_count(pos.side_to_move()) <= rule.flyPieceCount) {
-            // piece count < 3 or 4 and allow fly, if is empty point, that's ok, do not need in move list
-            for (to = SQ_BEGIN; to < SQ_END; ++to) {
-                if (!pos.get_board()[to]) {
-                    *cur++ = make_move(from, to);
-                }
-            }
-        } else {
-            for (auto direction = MD_BEGIN; direction < MD_NB; ++direction) {
-                to = static_cast<Square>(MoveList<LEGAL>::adjacentSquares[from][direction]);
-                if (to && !pos.get_board()[to]) {
-                    *cur++ = make_move(from, to);
-                }
-            }
+        Bitboard b = mayFly ? empty : empty & MoveList<LEGAL>::adjacentSquaresBB[from];
+
+        while (b) {
+            to = pop_lsb(&b);
+            *cur++ = make_move(from, to);
         }
     }
 
     return cur;
 }
 
-/// generate<PLACE> generates all places.
+/// generate_places() generates all places.
 /// Returns a pointer to the end of the move list.
-template<>
-ExtMove *generate<PLACE>(Position &pos, ExtMove *moveList)
+ExtMove *generate_places(Position &pos, ExtMove *moveList)
 {
     ExtMove *cur = moveList;
 
+    const Bitboard empty = ~pos.pieces() & BoardBB;
+
     for (auto s : MoveList<LEGAL>::movePriorityList) {
-        if (!pos.get_board()[s]) {
+        if (empty & s) {
             *cur++ = (Move)s;
         }
     }
@@ -72,49 +76,60 @@ ExtMove *generate<PLACE>(Position &pos, ExtMove *moveList)
     return cur;
 }
 
-/// generate<REMOVE> generates all removes.
+/// generate_removes() generates all removes.
 /// Returns a pointer to the end of the move moves.
-template<>
-ExtMove *generate<REMOVE>(Position &pos, ExtMove *moveList)
+template<class R>
+ExtMove *generate_removes(Position &pos, ExtMove *moveList)
 {
     Square s;
 
     const Color us = pos.side_to_move();
     const Color them = ~us;
+    const Bitboard theirs = pos.pieces(them);
 
     ExtMove *cur = moveList;
 
-    if (pos.is_all_in_mills(them)) {
-#ifndef MADWEASEL_MUEHLE_RULE
-        for (auto i = EFFECTIVE_SQUARE_NB - 1; i >= 0; i--) {
-            s = MoveList<LEGAL>::movePriorityList[i];
-            if (pos.get_board()[s] & make_piece(them)) {
-                *cur++ = (Move)-s;
-            }
-        }
-#endif
+    // Pieces in mills may only be removed if all of them are in mills
+    Bitboard removable = theirs & ~pos.pieces_in_mills(them);
+
+    if (!removable) {
+#ifdef MADWEASEL_MUEHLE_RULE
         return cur;
+#else
+        removable = theirs;
+#endif
+    } else if (R::rule.mayRemoveFromMillsAlways) {
+        removable = theirs;
     }
 
-    // not is all in mills
     for (auto i = EFFECTIVE_SQUARE_NB - 1; i >= 0; i--) {
         s = MoveList<LEGAL>::movePriorityList[i];
-        if (pos.get_board()[s] & make_piece(them)) {
-            if (rule.mayRemoveFromMillsAlways ||
-                !pos.potential_mills_count(s, NOBODY)) {
-                *cur++ = (Move)-s;
-            }
+        if (removable & s) {
+            *cur++ = (Move)-s;
         }
     }
 
     return cur;
 }
 
-/// generate<LEGAL> generates all the legal moves in the given position
+} // namespace
 
-template<>
-ExtMove *generate<LEGAL>(Position &pos, ExtMove *moveList)
+
+/// generate<Type, R> generates moves of the given type with the rule variant R.
+/// generate<LEGAL> generates all the legal moves in the given position.
+/// Returns a pointer to the end of the move list.
+
+template<GenType Type, class R>
+ExtMove *generate(Position &pos, ExtMove *moveList)
 {
+    if constexpr (Type == PLACE) {
+        return generate_places(pos, moveList);
+    } else if constexpr (Type == MOVE) {
+        return generate_moves<R>(pos, moveList);
+    } else if constexpr (Type == REMOVE) {
+        return generate_removes<R>(pos, moveList);
+    }
+
     ExtMove *cur = moveList;
 
     switch (pos.get_action()) {
@@ -122,17 +137,17 @@ ExtMove *generate<LEGAL>(Position &pos, ExtMove *moveList)
     case Action::place:
         if (pos.get_phase() == Phase::placing ||
             pos.get_phase() == Phase::ready) {
-            return generate<PLACE>(pos, moveList);
+            return generate_places(pos, moveList);
         }
 
         if (pos.get_phase() == Phase::moving) {
-            return generate<MOVE>(pos, moveList);
+            return generate_moves<R>(pos, moveList);
         }
 
         break;
 
     case Action::remove:
-        return generate<REMOVE>(pos, moveList);
+        return generate_removes<R>(pos, moveList);
 
     default:
 #ifdef FLUTTER_UI
@@ -145,6 +160,16 @@ ExtMove *generate<LEGAL>(Position &pos, ExtMove *moveList)
     return cur;
 }
 
+#define INSTANTIATE_GENERATE(R) \
+    template ExtMove *generate<PLACE, R>(Position &pos, ExtMove *moveList); \
+    template ExtMove *generate<MOVE, R>(Position &pos, ExtMove *moveList); \
+    template ExtMove *generate<REMOVE, R>(Position &pos, ExtMove *moveList); \
+    template ExtMove *generate<LEGAL, R>(Position &pos, ExtMove *moveList);
+
+FOR_EACH_RULE_VARIANT(INSTANTIATE_GENERATE)
+
+#undef INSTANTIATE_GENERATE
+
 
 template<>
 void MoveList<LEGAL>::create()
@@ -22,6 +22,7 @@
 #include <algorithm>
 #include <array>
 
+#include "rule.h"
 #include "types.h"
 
 class Position;
@@ -59,7 +60,7 @@ inline bool operator<(const ExtMove &f, const ExtMove &s) noexcept
     return f.value < s.value;
 }
 
-template<GenType>
+template<GenType, class R = CustomRule>
 ExtMove *generate(Position &pos, ExtMove *moveList);
 
 /// The MoveList struct is a simple wrapper around generate(). It sometimes comes
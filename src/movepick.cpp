@@ -16,7 +16,24 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <climits>
+
 #include "movepick.h"
+#include "tune.h"
+
+namespace
+{
+
+enum Stages
+{
+    TT_STAGE, CLOSE_INIT, CLOSE_MILL, BLOCK_INIT, BLOCK_MILL, QUIET_INIT, QUIET, REMOVE_INIT, REMOVE_STAGE, END_STAGE
+};
+
+// Moves which do not belong to the current stage are marked with this value
+constexpr int UNRATED = INT_MIN;
+
+} // namespace
 
 // partial_insertion_sort() sorts moves in descending order up to and including
 // a given limit. The order of moves smaller than the limit is left unspecified.
@@ -35,20 +52,24 @@ void partial_insertion_sort(ExtMove *begin, const ExtMove *end, int limit)
 /// Constructors of the MovePicker class.
 
 /// MovePicker constructor for the main search
-MovePicker::MovePicker(Position &p) noexcept
-    : pos(p)
+MovePicker::MovePicker(Position &p, Move ttm) noexcept
+    : pos(p), ttMove(ttm)
 {
 }
 
-/// MovePicker::score() assigns a numerical value to each move in a list, used
-/// for sorting.
-template<GenType Type>
-void MovePicker::score()
+/// MovePicker::score() assigns a numerical value to the remaining moves for the
+/// given stage. Moves which do not belong to the stage are marked as UNRATED and
+/// are scored again by a later stage. Returns the number of rated moves.
+template<class R>
+int MovePicker::score(int st)
 {
-    cur = moves;
+    int ratedCount = 0;
+
     Square from = SQ_0, to = SQ_0;
     Move m = MOVE_NONE;
 
+    const Color us = pos.side_to_move();
+
     int ourMillsCount = 0;
     int theirMillsCount = 0;
     int ourPieceCount = 0;
@@ -56,104 +77,234 @@ void MovePicker::score()
     int bannedCount = 0;
     int emptyCount = 0;
 
-    while (cur++->move != MOVE_NONE) {
-        m = cur->move;
+    for (ExtMove *p = cur; p < endMoves; ++p) {
+        m = p->move;
 
         to = to_sq(m);
         from = from_sq(m);
 
-        // if stat before moving, moving phrase maybe from @-0-@ to 0-@-@, but no mill, so need |from| to judge
-        ourMillsCount = pos.potential_mills_count(to, pos.side_to_move(), from);
+        p->value = UNRATED;
+
+#ifdef SORT_MOVE_WITHOUT_HUMAN_KNOWLEDGES
+        if (st == QUIET_INIT || st == REMOVE_INIT) {
+            p->value = 0;
+        }
+
+        continue;
+#endif // SORT_MOVE_WITHOUT_HUMAN_KNOWLEDGES
 
-#ifndef SORT_MOVE_WITHOUT_HUMAN_KNOWLEDGES
-        // TODO: rule.mayRemoveMultiple adapt other rules
-        if (type_of(m) != MOVETYPE_REMOVE) {
+        // If has Diagonal Lines, black 2nd move place star point is as important as close mill (TODO)
+        const int starRating = (R::rule.hasDiagonalLines &&
+                                pos.count<ON_BOARD>(BLACK) < 2 &&    // patch: only when black 2nd move
+                                Position::is_star_square(static_cast<Square>(m))) ?
+            Tune::RatingStarSquare : 0;
+
+        switch (st) {
+        case CLOSE_INIT:
             // all phrase, check if place sq can close mill
+            // if stat before moving, moving phrase maybe from @-0-@ to 0-@-@, but no mill, so need |from| to judge
+            ourMillsCount = pos.potential_mills_count(to, us, from);
+
             if (ourMillsCount > 0) {
-                cur->value += RATING_ONE_MILL * ourMillsCount;
-            } else if (pos.get_phase() == Phase::placing) {
-                // placing phrase, check if place sq can block their close mill
-                theirMillsCount = pos.potential_mills_count(to, ~pos.side_to_move());
-                cur->value += RATING_BLOCK_ONE_MILL * theirMillsCount;
+                p->value = Tune::RatingOneMill * ourMillsCount + starRating;
+            }
+            break;
+
+        case BLOCK_INIT:
+            // check if place sq can block their close mill
+            theirMillsCount = pos.potential_mills_count(to, ~us);
+
+            if (!theirMillsCount) {
+                break;
             }
-#if 1
-            else if (pos.get_phase() == Phase::moving) {
-                // moving phrase, check if place sq can block their close mill
-                theirMillsCount = pos.potential_mills_count(to, ~pos.side_to_move());
 
-                if (theirMillsCount) {
-                    ourPieceCount = theirPiecesCount = bannedCount = emptyCount = 0;
+            if (pos.get_phase() == Phase::placing) {
+                p->value = Tune::RatingBlockOneMill * theirMillsCount + starRating;
+            } else if (pos.get_phase() == Phase::moving) {
+                ourPieceCount = theirPiecesCount = bannedCount = emptyCount = 0;
 
-                    pos.surrounded_pieces_count(to, ourPieceCount, theirPiecesCount, bannedCount, emptyCount);
+                pos.surrounded_pieces_count(to, ourPieceCount, theirPiecesCount, bannedCount, emptyCount);
 
-                    if (to % 2 == 0 && theirPiecesCount == 3) {
-                        cur->value += RATING_BLOCK_ONE_MILL * theirMillsCount;
-                    } else if (to % 2 == 1 && theirPiecesCount == 2 && rule.hasDiagonalLines) {
-                        cur->value += RATING_BLOCK_ONE_MILL * theirMillsCount;
-                    }
+                if ((to % 2 == 0 && theirPiecesCount == 3) ||
+                    (to % 2 == 1 && theirPiecesCount == 2 && R::rule.hasDiagonalLines)) {
+                    p->value = Tune::RatingBlockOneMill * theirMillsCount + starRating;
                 }
             }
-#endif
+            break;
 
-            //cur->value += bannedCount;  // placing phrase, place nearby ban point
+        case QUIET_INIT:
+            //p->value += bannedCount;  // placing phrase, place nearby ban point
+            p->value = starRating;
+            break;
+
+        case REMOVE_INIT:
+            // TODO: rule.mayRemoveMultiple adapt other rules
+            p->value = 0;
+            ourMillsCount = pos.potential_mills_count(to, us, from);
 
-            // If has Diagonal Lines, black 2nd move place star point is as important as close mill (TODO)
-            if (rule.hasDiagonalLines &&
-                pos.count<ON_BOARD>(BLACK) < 2 &&    // patch: only when black 2nd move
-                Position::is_star_square(static_cast<Square>(m))) {
-                cur->value += RATING_STAR_SQUARE;
-            }
-        } else { // Remove
             ourPieceCount = theirPiecesCount = bannedCount = emptyCount = 0;
 
             pos.surrounded_pieces_count(to, ourPieceCount, theirPiecesCount, bannedCount, emptyCount);
 
             if (ourMillsCount > 0) {
                 // remove point is in our mill
-                //cur->value += RATING_REMOVE_ONE_MILL * ourMillsCount;
+                //p->value += RATING_REMOVE_ONE_MILL * ourMillsCount;
 
                 if (theirPiecesCount == 0) {
                     // if remove point nearby has no their stone, preferred.
-                    cur->value += 1;
+                    p->value += 1;
                     if (ourPieceCount > 0) {
                         // if remove point nearby our stone, preferred
-                        cur->value += ourPieceCount;
+                        p->value += ourPieceCount;
                     }
                 }
             }
 
             // remove point is in their mill
-            theirMillsCount = pos.potential_mills_count(to, ~pos.side_to_move());
+            theirMillsCount = pos.potential_mills_count(to, ~us);
             if (theirMillsCount) {
                 if (theirPiecesCount >= 2) {
                     // if nearby their piece, prefer do not remove
-                    cur->value -= theirPiecesCount;
+                    p->value -= theirPiecesCount;
 
                     if (ourPieceCount == 0) {
                         // if nearby has no our piece, more prefer do not remove
-                        cur->value -= 1;
+                        p->value -= 1;
                     }
                 }
             }
 
             // prefer remove piece that mobility is strong
-            cur->value += emptyCount;
+            p->value += emptyCount;
+            break;
+
+        default:
+            assert(false);
+            break;
+        }
+
+        if (p->value != UNRATED) {
+            ratedCount++;
+        }
+    }
+
+    return ratedCount;
+}
+
+
+/// MovePicker::select() returns the first remaining move with the highest value,
+/// skipping the UNRATED ones, or MOVE_NONE if there is none. The move is rotated
+/// to the front so the others keep their generation order, which carries the
+/// shuffled move priority list as a tie-break.
+Move MovePicker::select()
+{
+    ExtMove *best = nullptr;
+
+    for (ExtMove *p = cur; p < endMoves; ++p) {
+        if (p->value == UNRATED) {
+            continue;
+        }
+
+        if (best == nullptr || *best < *p) {
+            best = p;
         }
-#endif // !SORT_MOVE_WITHOUT_HUMAN_KNOWLEDGES
     }
+
+    if (best == nullptr) {
+        return MOVE_NONE;
+    }
+
+    std::rotate(cur, best, best + 1);
+
+    return cur++->move;
 }
 
 
 /// MovePicker::next_move() is the most important method of the MovePicker class. It
 /// returns a new pseudo legal move every time it is called until there are no more
-/// moves left, picking the move with the highest score from a list of generated moves.
+/// moves left. All the moves are generated by the first call, so move_count() and
+/// the moves[] array are valid afterwards, but they are scored stage by stage.
+template<class R>
 Move MovePicker::next_move()
 {
-    endMoves = generate<LEGAL>(pos, moves);
-    moveCount = int(endMoves - moves);
+    Move m;
+
+top:
+    switch (stage) {
+    case TT_STAGE:
+        cur = moves;
+        endMoves = generate<LEGAL, R>(pos, moves);
+        moveCount = int(endMoves - moves);
+
+        stage = pos.get_action() == Action::remove ? REMOVE_INIT : CLOSE_INIT;
+
+        if (ttMove != MOVE_NONE) {
+            ExtMove *tt = std::find_if(moves, endMoves,
+                                       [this](const ExtMove &em) { return em.move == ttMove; });
+
+            if (tt != endMoves) {
+                std::rotate(moves, tt, tt + 1);
+                return cur++->move;
+            }
+        }
+
+        goto top;
+
+    case CLOSE_INIT:
+    case BLOCK_INIT:
+        // Skip the stage at once if none of the moves belongs to it
+        stage += score<R>(stage) ? 1 : 2;
+        goto top;
 
-    score<LEGAL>();
-    partial_insertion_sort(moves, endMoves, INT_MIN);
+    case QUIET_INIT:
+        // Without diagonal lines no quiet move gets a bonus, so the
+        // generation order is kept as is
+        if (R::rule.hasDiagonalLines) {
+            score<R>(stage);
+            partial_insertion_sort(cur, endMoves, INT_MIN);
+        }
+
+        ++stage;
+        goto top;
+
+    case REMOVE_INIT:
+        score<R>(stage);
+        partial_insertion_sort(cur, endMoves, INT_MIN);
+        ++stage;
+        goto top;
+
+    case CLOSE_MILL:
+    case BLOCK_MILL:
+        if ((m = select()) != MOVE_NONE) {
+            return m;
+        }
+
+        ++stage;
+        goto top;
+
+    case QUIET:
+    case REMOVE_STAGE:
+        if (cur < endMoves) {
+            return cur++->move;
+        }
 
-    return *moves;
+        stage = END_STAGE;
+        break;
+
+    case END_STAGE:
+        break;
+
+    default:
+        assert(false);
+        break;
+    }
+
+    return MOVE_NONE;
 }
+
+#define INSTANTIATE_NEXT_MOVE(R) \
+    template Move MovePicker::next_move<R>();
+
+FOR_EACH_RULE_VARIANT(INSTANTIATE_NEXT_MOVE)
+
+#undef INSTANTIATE_NEXT_MOVE
@@ -39,16 +39,24 @@ void partial_insertion_sort(ExtMove *begin, const ExtMove *end, int limit);
 /// when MOVE_NONE is returned. In order to improve the efficiency of the alpha
 /// beta algorithm, MovePicker attempts to return the moves which are most likely
 /// to get a cut-off first.
+///
+/// Moves are returned in stages: the TT move, the moves which close a mill, the
+/// moves which block a mill of the opponent and then the remaining ones. Each
+/// stage is scored only when it is reached, so a cut-off skips the later ones.
 class MovePicker
 {
 public:
     MovePicker(const MovePicker &) = delete;
     MovePicker &operator=(const MovePicker &) = delete;
-    explicit MovePicker(Position &p) noexcept;
+    explicit MovePicker(Position &p, Move ttm = MOVE_NONE) noexcept;
 
-    Move next_move();
+    template<class R = CustomRule> Move next_move();
 
-    template<GenType> void score();
+private:
+    template<class R> int score(int stage);
+    Move select();
+
+public:
 
     ExtMove *begin() noexcept
     {
@@ -67,6 +75,7 @@ public:
     ExtMove moves[MAX_MOVES] { {MOVE_NONE, 0} };
 
     int moveCount { 0 };
+    int stage { 0 };
 
     int move_count() const noexcept
     {
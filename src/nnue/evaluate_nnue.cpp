@@ -0,0 +1,292 @@
+﻿/*
+  This file is part of Sanmill.
+  Copyright (C) 2019-2021 The Sanmill developers (see AUTHORS file)
+
+  Sanmill is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Sanmill is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Code for calculating the NNUE evaluation function
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#if defined(USE_AVX2)
+#include <immintrin.h>
+#elif defined(USE_SSSE3)
+#include <tmmintrin.h>
+#elif defined(USE_SSE2)
+#include <emmintrin.h>
+#elif defined(USE_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "../misc.h"
+#include "../position.h"
+#include "../uci.h"
+
+#include "evaluate_nnue.h"
+
+#ifdef NNUE_ENABLE
+
+namespace Eval {
+
+bool useNNUE = false;
+
+namespace NNUE {
+
+namespace {
+
+// Network parameters
+alignas(64) int16_t ftBiases[TransformedDimensions];
+alignas(64) int16_t ftWeights[InputDimensions * TransformedDimensions];
+alignas(64) int32_t hiddenBiases[HiddenDimensions];
+alignas(64) int8_t hiddenWeights[HiddenDimensions * TransformedDimensions];
+int32_t outputBias;
+alignas(64) int8_t outputWeights[HiddenDimensions];
+
+bool loaded = false;
+std::string loadedEvalFile;
+
+// Read integers in little-endian byte order, whatever the byte order of the host
+template<typename IntType>
+bool read_little_endian(std::istream &stream, IntType *out, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        uint8_t u[sizeof(IntType)];
+        std::make_unsigned_t<IntType> v = 0;
+
+        stream.read(reinterpret_cast<char *>(u), sizeof(IntType));
+
+        for (size_t b = 0; b < sizeof(IntType); b++) {
+            v = static_cast<std::make_unsigned_t<IntType>>(v | (std::make_unsigned_t<IntType>(u[b]) << (8 * b)));
+        }
+
+        out[i] = static_cast<IntType>(v);
+    }
+
+    return !stream.fail();
+}
+
+// Add or subtract the weights of a feature to or from the accumulator
+template<bool Add>
+void update(Accumulator &acc, int feature)
+{
+    const int16_t *w = &ftWeights[feature * TransformedDimensions];
+
+#if defined(USE_AVX2)
+    for (int i = 0; i < TransformedDimensions; i += 16) {
+        __m256i *a = reinterpret_cast<__m256i *>(&acc.values[i]);
+        const __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i *>(&w[i]));
+        _mm256_storeu_si256(a, Add ? _mm256_add_epi16(_mm256_loadu_si256(a), v)
+                                   : _mm256_sub_epi16(_mm256_loadu_si256(a), v));
+    }
+#elif defined(USE_SSE2)
+    for (int i = 0; i < TransformedDimensions; i += 8) {
+        __m128i *a = reinterpret_cast<__m128i *>(&acc.values[i]);
+        const __m128i v = _mm_load_si128(reinterpret_cast<const __m128i *>(&w[i]));
+        _mm_storeu_si128(a, Add ? _mm_add_epi16(_mm_loadu_si128(a), v)
+                                : _mm_sub_epi16(_mm_loadu_si128(a), v));
+    }
+#elif defined(USE_NEON)
+    for (int i = 0; i < TransformedDimensions; i += 8) {
+        const int16x8_t v = vld1q_s16(&w[i]);
+        const int16x8_t a = vld1q_s16(&acc.values[i]);
+        vst1q_s16(&acc.values[i], Add ? vaddq_s16(a, v) : vsubq_s16(a, v));
+    }
+#else
+    for (int i = 0; i < TransformedDimensions; i++) {
+        acc.values[i] = static_cast<int16_t>(Add ? acc.values[i] + w[i] : acc.values[i] - w[i]);
+    }
+#endif
+}
+
+// Dot product of the clipped activations (all in [0, 127]) with a row of
+// int8 weights. Both have TransformedDimensions entries.
+int32_t dot(const uint8_t *input, const int8_t *row)
+{
+#if defined(USE_AVX2)
+    static_assert(TransformedDimensions == 32, "one AVX2 register per row");
+    const __m256i prod = _mm256_maddubs_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(input)),
+                                              _mm256_load_si256(reinterpret_cast<const __m256i *>(row)));
+    const __m256i sum = _mm256_madd_epi16(prod, _mm256_set1_epi16(1));
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+    return _mm_cvtsi128_si32(s);
+#elif defined(USE_SSSE3)
+    __m128i sum = _mm_setzero_si128();
+    for (int i = 0; i < TransformedDimensions; i += 16) {
+        const __m128i prod = _mm_maddubs_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&input[i])),
+                                               _mm_load_si128(reinterpret_cast<const __m128i *>(&row[i])));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(prod, _mm_set1_epi16(1)));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+#elif defined(USE_NEON)
+    // The activations fit in int8, so a signed multiply is exact
+    int32x4_t sum = vdupq_n_s32(0);
+    for (int i = 0; i < TransformedDimensions; i += 16) {
+        const int8x16_t in = vreinterpretq_s8_u8(vld1q_u8(&input[i]));
+        const int8x16_t w = vld1q_s8(&row[i]);
+        sum = vpadalq_s16(sum, vmull_s8(vget_low_s8(in), vget_low_s8(w)));
+        sum = vpadalq_s16(sum, vmull_s8(vget_high_s8(in), vget_high_s8(w)));
+    }
+    return vgetq_lane_s32(sum, 0) + vgetq_lane_s32(sum, 1) + vgetq_lane_s32(sum, 2) + vgetq_lane_s32(sum, 3);
+#else
+    int32_t sum = 0;
+    for (int i = 0; i < TransformedDimensions; i++) {
+        sum += input[i] * row[i];
+    }
+    return sum;
+#endif
+}
+
+} // namespace
+
+
+/// NNUE::load_eval_file() reads the network parameters from a file. The file
+/// holds a header (version and layer sizes) followed by the parameters of
+/// each layer, all in little-endian byte order. Returns false if the file
+/// cannot be read or does not match the architecture.
+
+bool load_eval_file(const std::string &evalFile)
+{
+    std::ifstream stream(evalFile, std::ios::binary);
+    uint32_t header[4];
+
+    if (!read_little_endian(stream, header, 4) ||
+        header[0] != Version ||
+        header[1] != uint32_t(InputDimensions) ||
+        header[2] != uint32_t(TransformedDimensions) ||
+        header[3] != uint32_t(HiddenDimensions)) {
+        return false;
+    }
+
+    if (!read_little_endian(stream, ftBiases, TransformedDimensions) ||
+        !read_little_endian(stream, ftWeights, InputDimensions * TransformedDimensions) ||
+        !read_little_endian(stream, hiddenBiases, HiddenDimensions) ||
+        !read_little_endian(stream, hiddenWeights, HiddenDimensions * TransformedDimensions) ||
+        !read_little_endian(stream, &outputBias, 1) ||
+        !read_little_endian(stream, outputWeights, HiddenDimensions)) {
+        return false;
+    }
+
+    return stream.peek() == std::ifstream::traits_type::eof();
+}
+
+
+/// NNUE::init() loads the network selected by the "EvalFile" option if the
+/// "UseNNUE" option is set, and enables the NNUE evaluation if it succeeds.
+/// Otherwise the classical evaluation is used.
+
+void init()
+{
+    useNNUE = false;
+
+    if (!(bool)Options["UseNNUE"]) {
+        return;
+    }
+
+    const std::string evalFile = std::string(Options["EvalFile"]);
+
+    if (!loaded || evalFile != loadedEvalFile) {
+        loaded = load_eval_file(evalFile);
+        loadedEvalFile = loaded ? evalFile : "";
+    }
+
+    if (!loaded) {
+        sync_cout << "info string ERROR: Network evaluation parameters compatible with the engine must be available." << sync_endl;
+        sync_cout << "info string ERROR: The network file " << evalFile << " was not loaded successfully." << sync_endl;
+        sync_cout << "info string ERROR: Using the classical evaluation." << sync_endl;
+        return;
+    }
+
+    useNNUE = true;
+
+    sync_cout << "info string NNUE evaluation using " << evalFile << " enabled" << sync_endl;
+}
+
+
+/// NNUE::refresh_accumulator() computes the accumulator of a position from
+/// scratch. The search calls it for the root position, all the positions
+/// below are updated incrementally.
+
+void refresh_accumulator(const Position &pos, Accumulator &acc)
+{
+    std::memcpy(acc.values, ftBiases, sizeof(acc.values));
+
+    for (Square s = SQ_BEGIN; s < SQ_END; ++s) {
+        const Color c = pos.color_on(s);
+
+        if (c == WHITE || c == BLACK) {
+            update<true>(acc, square_feature(c, s));
+        }
+    }
+
+    for (Color c : { WHITE, BLACK }) {
+        for (int k = 0; k < std::min(pos.piece_in_hand_count(c), MaxPiecesInHand); k++) {
+            update<true>(acc, hand_feature(c, k));
+        }
+    }
+
+    if (phase_feature(pos.get_phase()) >= 0) {
+        update<true>(acc, phase_feature(pos.get_phase()));
+    }
+}
+
+void add_feature(Accumulator &acc, int feature)
+{
+    update<true>(acc, feature);
+}
+
+void remove_feature(Accumulator &acc, int feature)
+{
+    update<false>(acc, feature);
+}
+
+
+/// NNUE::evaluate() propagates the accumulator of the position through the
+/// hidden and output layers. Returns the value from WHITE's point of view,
+/// never as large as a mate value.
+
+Value evaluate(const Position &pos)
+{
+    alignas(32) uint8_t transformed[TransformedDimensions];
+    alignas(32) uint8_t hidden[HiddenDimensions];
+
+    for (int i = 0; i < TransformedDimensions; i++) {
+        transformed[i] = static_cast<uint8_t>(std::clamp<int>(pos.accumulator.values[i], 0, 127));
+    }
+
+    int32_t output = outputBias;
+
+    for (int j = 0; j < HiddenDimensions; j++) {
+        const int32_t sum = hiddenBiases[j] + dot(transformed, &hiddenWeights[j * TransformedDimensions]);
+        hidden[j] = static_cast<uint8_t>(std::clamp(sum >> WeightScaleBits, 0, 127));
+        output += hidden[j] * outputWeights[j];
+    }
+
+    const int v = (output >> WeightScaleBits) / OutputScale;
+
+    return static_cast<Value>(std::clamp<int>(v, -VALUE_MATE_IN_MAX_PLY + 1, VALUE_MATE_IN_MAX_PLY - 1));
+}
+
+} // namespace NNUE
+
+} // namespace Eval
+
+#endif // NNUE_ENABLE
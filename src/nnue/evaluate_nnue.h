@@ -0,0 +1,54 @@
+﻿/*
+  This file is part of Sanmill.
+  Copyright (C) 2019-2021 The Sanmill developers (see AUTHORS file)
+
+  Sanmill is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Sanmill is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Interface of the NNUE evaluation
+
+#ifndef NNUE_EVALUATE_NNUE_H_INCLUDED
+#define NNUE_EVALUATE_NNUE_H_INCLUDED
+
+#include <string>
+
+#include "nnue_architecture.h"
+
+#ifdef NNUE_ENABLE
+
+class Position;
+
+namespace Eval {
+
+// Set when the NNUE evaluation is requested and a network is loaded
+extern bool useNNUE;
+
+namespace NNUE {
+
+bool load_eval_file(const std::string &evalFile);
+void init();
+
+void refresh_accumulator(const Position &pos, Accumulator &acc);
+void add_feature(Accumulator &acc, int feature);
+void remove_feature(Accumulator &acc, int feature);
+
+Value evaluate(const Position &pos);
+
+} // namespace NNUE
+
+} // namespace Eval
+
+#endif // NNUE_ENABLE
+
+#endif // #ifndef NNUE_EVALUATE_NNUE_H_INCLUDED
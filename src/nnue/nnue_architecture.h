@@ -0,0 +1,80 @@
+﻿/*
+  This file is part of Sanmill.
+  Copyright (C) 2019-2021 The Sanmill developers (see AUTHORS file)
+
+  Sanmill is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Sanmill is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Definition of the network architecture and of its input features
+
+#ifndef NNUE_ARCHITECTURE_H_INCLUDED
+#define NNUE_ARCHITECTURE_H_INCLUDED
+
+#include <cstdint>
+
+#include "../types.h"
+
+namespace Eval::NNUE {
+
+// Input features: the occupancy of each (square, colour) pair, the pieces in
+// hand of each colour as a thermometer code (feature k is active while more
+// than k pieces are in hand) and the phase of the game. All of them change
+// one at a time, so the first layer is kept up to date incrementally.
+constexpr int SquareFeatures = 2 * EFFECTIVE_SQUARE_NB;
+constexpr int MaxPiecesInHand = 12;
+constexpr int HandFeatures = 2 * MaxPiecesInHand;
+constexpr int PhaseFeatures = 2;
+constexpr int InputDimensions = SquareFeatures + HandFeatures + PhaseFeatures;
+
+// Layer sizes: the accumulator (the output of the first layer), one hidden
+// layer and a single output
+constexpr int TransformedDimensions = 32;
+constexpr int HiddenDimensions = 32;
+
+// Quantization: activations are clipped to [0, 127], weights of the hidden
+// and output layers are int8 scaled by 2^WeightScaleBits, and OutputScale
+// network units make one Value unit.
+constexpr int WeightScaleBits = 6;
+constexpr int OutputScale = 16;
+
+// Version of the network file format
+constexpr uint32_t Version = 0x5A4E0001;
+
+inline int square_feature(Color c, Square s)
+{
+    return (c - WHITE) * EFFECTIVE_SQUARE_NB + (s - SQ_BEGIN);
+}
+
+inline int hand_feature(Color c, int k)
+{
+    return SquareFeatures + (c - WHITE) * MaxPiecesInHand + k;
+}
+
+// Returns -1 for the phases without a feature
+inline int phase_feature(Phase p)
+{
+    return p == Phase::placing ? SquareFeatures + HandFeatures :
+           p == Phase::moving ? SquareFeatures + HandFeatures + 1 : -1;
+}
+
+// The output of the first layer for the current position, from WHITE's
+// point of view. It is stored in the Position and copied along with it.
+struct Accumulator
+{
+    int16_t values[TransformedDimensions];
+};
+
+} // namespace Eval::NNUE
+
+#endif // #ifndef NNUE_ARCHITECTURE_H_INCLUDED
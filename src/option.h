@@ -133,6 +133,16 @@ public:
         return perfectAiEnabled;
     }
 
+    void setPerfectDatabaseProbeEnabled(bool enabled) noexcept
+    {
+        perfectDatabaseProbeEnabled = enabled;
+    }
+
+    bool getPerfectDatabaseProbeEnabled() const noexcept
+    {
+        return perfectDatabaseProbeEnabled;
+    }
+
     void setIDSEnabled(bool enabled) noexcept
     {
         IDSEnabled = enabled;
@@ -268,6 +278,18 @@ public:
         return considerMobility;
     }
 
+    // ConsiderPattern
+
+    void setConsiderPattern(bool enabled) noexcept
+    {
+        considerPattern = enabled;
+    }
+
+    bool getConsiderPattern() const noexcept
+    {
+        return considerPattern;
+    }
+
     // Developer Mode
 
     void setDeveloperMode(bool enabled) noexcept
@@ -297,11 +319,13 @@ private:
 #endif
     int algorithm { 2 };
     bool perfectAiEnabled { false };
+    bool perfectDatabaseProbeEnabled { false };
     bool IDSEnabled { false };
     bool depthExtension {true};
     bool openingBook { false };
     bool drawOnHumanExperience { true };
     bool considerMobility { true };
+    bool considerPattern { false };
     bool developerMode { false };
 };
 
@@ -8,6 +8,14 @@
 
 #include "bufferedFile.h"
 
+#ifndef _WIN32
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 //-----------------------------------------------------------------------------
 // bufferedFile()
 // Creates a cyclic array. The passed file is used as temporary data buffer for the cyclic array.
@@ -22,6 +30,8 @@ BufferedFile::BufferedFile(unsigned int numberOfThreads, unsigned int bufferSize
     numThreads = numberOfThreads;
     readBuffer = new unsigned char[numThreads * bufferSize];
     writeBuffer = new unsigned char[numThreads * bufferSize];
+    flushBuffer = new unsigned char[numThreads * bufferSize];
+    flushPending = new bool[numThreads];
     curWritingPointer = new long long[numThreads];
     curReadingPointer = new long long[numThreads];
     bytesInReadBuffer = new unsigned int[numThreads];
@@ -32,19 +42,38 @@ BufferedFile::BufferedFile(unsigned int numberOfThreads, unsigned int bufferSize
         curWritingPointer[curThread] = 0;
         bytesInReadBuffer[curThread] = 0;
         bytesInWriteBuffer[curThread] = 0;
+        flushPending[curThread] = false;
     }
 
+    numJobsPending = 0;
+    stopIoThread = false;
+    writeFailed = false;
+    fileSize = 0;
+
+#ifdef _WIN32
     InitializeCriticalSection(&csIO);
 
     // Open Database-File (FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH | FILE_FLAG_RANDOM_ACCESS)
     hFile = CreateFileA(fileName, 
                         GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
 
-    // opened file successfully
+    // opened file successfully ? writeBytes() and readBytes() fail otherwise
     if (hFile == INVALID_HANDLE_VALUE) {
         hFile = nullptr;
-        return;
+        cout << endl
+            << "Could not open " << fileName << "!";
+    }
+#else
+    fd = open(fileName, O_RDWR | O_CREAT, 0644);
+
+    if (fd == -1) {
+        cout << endl
+            << "Could not open " << fileName << ": " << strerror(errno);
     }
+#endif
+
+    // start writing in the background
+    ioThread = thread(&BufferedFile::ioThreadProc, this);
 
     // update file size
     getFileSize();
@@ -58,19 +87,50 @@ BufferedFile::~BufferedFile()
 {
     // flush buffers
     flushBuffers();
-    DeleteCriticalSection(&csIO);
+
+    // stop I/O thread
+    if (ioThread.joinable()) {
+        {
+            lock_guard<mutex> lock(csJobs);
+            stopIoThread = true;
+        }
+        condJobAdded.notify_one();
+        ioThread.join();
+    }
 
     // delete arrays
     delete[] readBuffer;
     delete[] writeBuffer;
+    delete[] flushBuffer;
+    delete[] flushPending;
     delete[] curReadingPointer;
     delete[] curWritingPointer;
     delete[] bytesInReadBuffer;
     delete[] bytesInWriteBuffer;
 
     // close file
+#ifdef _WIN32
+    DeleteCriticalSection(&csIO);
+
     if (hFile != nullptr)
         CloseHandle(hFile);
+#else
+    if (fd != -1)
+        close(fd);
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// isOpen()
+// 
+//-----------------------------------------------------------------------------
+bool BufferedFile::isOpen()
+{
+#ifdef _WIN32
+    return hFile != nullptr;
+#else
+    return fd != -1;
+#endif
 }
 
 //-----------------------------------------------------------------------------
@@ -79,50 +139,130 @@ BufferedFile::~BufferedFile()
 //-----------------------------------------------------------------------------
 long long BufferedFile::getFileSize()
 {
+#ifdef _WIN32
     LARGE_INTEGER liFileSize;
-    GetFileSizeEx(hFile, &liFileSize);
-    fileSize = liFileSize.QuadPart;
+    if (GetFileSizeEx(hFile, &liFileSize))
+        fileSize = liFileSize.QuadPart;
+#else
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) == 0)
+        fileSize = fileStat.st_size;
+#endif
 
     return fileSize;
 }
 
 //-----------------------------------------------------------------------------
 // flushBuffers()
-// 
+// Returns false if any data could not be written to the file.
 //-----------------------------------------------------------------------------
 bool BufferedFile::flushBuffers()
 {
     for (unsigned int threadNo = 0; threadNo < numThreads; threadNo++) {
-        writeDataToFile(hFile, 
-                        curWritingPointer[threadNo] - bytesInWriteBuffer[threadNo], 
-                        bytesInWriteBuffer[threadNo], 
-                        &writeBuffer[threadNo * bufferSize + 0]);
-        bytesInWriteBuffer[threadNo] = 0;
+        if (bytesInWriteBuffer[threadNo]) {
+            queueWriteBuffer(threadNo);
+        }
     }
 
-    return true;
+    // the data shall be in the file when returning
+    waitForPendingWrites();
+
+    return !writeFailed;
+}
+
+//-----------------------------------------------------------------------------
+// queueWriteBuffer()
+// Hands the write buffer of a thread over to the I/O thread, so that the
+// thread can go on filling its write buffer while the data is written.
+//-----------------------------------------------------------------------------
+void BufferedFile::queueWriteBuffer(unsigned int threadNo)
+{
+    WriteJob job;
+
+    job.threadNo = threadNo;
+    job.offset = curWritingPointer[threadNo] - bytesInWriteBuffer[threadNo];
+    job.sizeInBytes = bytesInWriteBuffer[threadNo];
+
+    unique_lock<mutex> lock(csJobs);
+
+    // each thread has only one flush buffer, so wait if its last one is still being written
+    condJobDone.wait(lock, [&] { return !flushPending[threadNo]; });
+
+    memcpy(&flushBuffer[threadNo * bufferSize], &writeBuffer[threadNo * bufferSize], job.sizeInBytes);
+    bytesInWriteBuffer[threadNo] = 0;
+    flushPending[threadNo] = true;
+    numJobsPending++;
+    writeJobs.push_back(job);
+
+    lock.unlock();
+    condJobAdded.notify_one();
+}
+
+//-----------------------------------------------------------------------------
+// waitForPendingWrites()
+// 
+//-----------------------------------------------------------------------------
+void BufferedFile::waitForPendingWrites()
+{
+    unique_lock<mutex> lock(csJobs);
+    condJobDone.wait(lock, [&] { return numJobsPending == 0; });
+}
+
+//-----------------------------------------------------------------------------
+// ioThreadProc()
+// Writes the queued flush buffers to the file.
+//-----------------------------------------------------------------------------
+void BufferedFile::ioThreadProc()
+{
+    WriteJob job;
+
+    while (true) {
+        {
+            unique_lock<mutex> lock(csJobs);
+            condJobAdded.wait(lock, [&] { return stopIoThread || !writeJobs.empty(); });
+            if (writeJobs.empty())
+                return;
+            job = writeJobs.front();
+            writeJobs.pop_front();
+        }
+
+        if (!writeDataToFile(job.offset, job.sizeInBytes, &flushBuffer[job.threadNo * bufferSize])) {
+            writeFailed = true;
+        }
+
+        {
+            lock_guard<mutex> lock(csJobs);
+            flushPending[job.threadNo] = false;
+            numJobsPending--;
+        }
+
+        condJobDone.notify_all();
+    }
 }
 
 //-----------------------------------------------------------------------------
 // writeDataToFile()
 // Writes 'sizeInBytes'-bytes to the position 'offset' to the file.
+// Returns false if that failed.
 //-----------------------------------------------------------------------------
-void BufferedFile::writeDataToFile(HANDLE fd, long long offset, unsigned int sizeInBytes, void *pData)
+bool BufferedFile::writeDataToFile(long long offset, unsigned int sizeInBytes, void *pData)
 {
+    unsigned int restingBytes = sizeInBytes;
+
+#ifdef _WIN32
     DWORD dwBytesWritten;
     LARGE_INTEGER liDistanceToMove;
-    unsigned int restingBytes = sizeInBytes;
 
     liDistanceToMove.QuadPart = offset;
 
     EnterCriticalSection(&csIO);
 
-    while (!SetFilePointerEx(fd, liDistanceToMove, nullptr, FILE_BEGIN))
+    while (!SetFilePointerEx(hFile, liDistanceToMove, nullptr, FILE_BEGIN))
         cout << endl
         << "SetFilePointerEx  failed!";
 
     while (restingBytes > 0) {
-        if (WriteFile(fd, pData, sizeInBytes, &dwBytesWritten, nullptr) == TRUE) {
+        if (WriteFile(hFile, pData, restingBytes, &dwBytesWritten, nullptr) == TRUE) {
             restingBytes -= dwBytesWritten;
             pData = (void *)(((unsigned char *)pData) + dwBytesWritten);
             if (restingBytes > 0)
@@ -135,28 +275,54 @@ void BufferedFile::writeDataToFile(HANDLE fd, long long offset, unsigned int siz
     }
 
     LeaveCriticalSection(&csIO);
+#else
+    ssize_t bytesWritten;
+
+    while (restingBytes > 0) {
+        bytesWritten = pwrite(fd, pData, restingBytes, offset);
+        if (bytesWritten > 0) {
+            restingBytes -= (unsigned int)bytesWritten;
+            offset += bytesWritten;
+            pData = (void *)(((unsigned char *)pData) + bytesWritten);
+        } else if (bytesWritten == -1 && errno == EINTR) {
+            continue;
+        } else {
+            cout << endl
+                << "pwrite failed: " << (bytesWritten == -1 ? strerror(errno) : "nothing written");
+            return false;
+        }
+    }
+#endif
+
+    return true;
 }
 
 //-----------------------------------------------------------------------------
 // readDataFromFile()
 // Reads 'sizeInBytes'-bytes from the position 'offset' of the file.
+// Returns false if that failed.
 //-----------------------------------------------------------------------------
-void BufferedFile::readDataFromFile(HANDLE fd, long long offset, unsigned int sizeInBytes, void *pData)
+bool BufferedFile::readDataFromFile(long long offset, unsigned int sizeInBytes, void *pData)
 {
+    unsigned int restingBytes = sizeInBytes;
+
+    // the data may still be in a flush buffer
+    waitForPendingWrites();
+
+#ifdef _WIN32
     DWORD dwBytesRead;
     LARGE_INTEGER liDistanceToMove;
-    unsigned int restingBytes = sizeInBytes;
 
     liDistanceToMove.QuadPart = offset;
 
     EnterCriticalSection(&csIO);
 
-    while (!SetFilePointerEx(fd, liDistanceToMove, nullptr, FILE_BEGIN))
+    while (!SetFilePointerEx(hFile, liDistanceToMove, nullptr, FILE_BEGIN))
         cout << endl
         << "SetFilePointerEx failed!";
 
     while (restingBytes > 0) {
-        if (ReadFile(fd, pData, sizeInBytes, &dwBytesRead, nullptr) == TRUE) {
+        if (ReadFile(hFile, pData, restingBytes, &dwBytesRead, nullptr) == TRUE) {
             restingBytes -= dwBytesRead;
             pData = (void *)(((unsigned char *)pData) + dwBytesRead);
             if (restingBytes > 0)
@@ -169,6 +335,26 @@ void BufferedFile::readDataFromFile(HANDLE fd, long long offset, unsigned int si
     }
 
     LeaveCriticalSection(&csIO);
+#else
+    ssize_t bytesRead;
+
+    while (restingBytes > 0) {
+        bytesRead = pread(fd, pData, restingBytes, offset);
+        if (bytesRead > 0) {
+            restingBytes -= (unsigned int)bytesRead;
+            offset += bytesRead;
+            pData = (void *)(((unsigned char *)pData) + bytesRead);
+        } else if (bytesRead == -1 && errno == EINTR) {
+            continue;
+        } else {
+            cout << endl
+                << "pread failed: " << (bytesRead == -1 ? strerror(errno) : "end of file");
+            return false;
+        }
+    }
+#endif
+
+    return true;
 }
 
 //-----------------------------------------------------------------------------
@@ -196,19 +382,22 @@ bool BufferedFile::writeBytes(unsigned int threadNo,
     if (pData == nullptr)
         return false;
 
+    if (!isOpen())
+        return false;
+
     // locals
 
     // if buffer full or not sequential write operation write buffer to file
     if (bytesInWriteBuffer[threadNo] && 
         (positionInFile != curWritingPointer[threadNo] || bytesInWriteBuffer[threadNo] + numBytes >= bufferSize)) {
 
-        writeDataToFile(hFile, 
-                        curWritingPointer[threadNo] - bytesInWriteBuffer[threadNo], 
-                        bytesInWriteBuffer[threadNo], 
-                        &writeBuffer[threadNo * bufferSize + 0]);
-        bytesInWriteBuffer[threadNo] = 0;
+        queueWriteBuffer(threadNo);
     }
 
+    // an earlier buffer could not be written
+    if (writeFailed)
+        return false;
+
     // copy data into buffer
     memcpy(&writeBuffer[threadNo * bufferSize + bytesInWriteBuffer[threadNo]], pData, numBytes);
     bytesInWriteBuffer[threadNo] += numBytes;
@@ -243,14 +432,20 @@ bool BufferedFile::readBytes(unsigned int threadNo,
     if (pData == nullptr)
         return false;
 
+    if (!isOpen())
+        return false;
+
     // read from file into buffer if not enough data in buffer or if it is not an sequential reading operation?
     if (positionInFile != curReadingPointer[threadNo] || bytesInReadBuffer[threadNo] < numBytes) {
         bytesInReadBuffer[threadNo] = 
             ((positionInFile + bufferSize <= fileSize) ? bufferSize : (unsigned int)(fileSize - positionInFile));
         if (bytesInReadBuffer[threadNo] < numBytes)
             return false;
-        readDataFromFile(hFile, positionInFile, bytesInReadBuffer[threadNo], 
-                         &readBuffer[threadNo * bufferSize + bufferSize - bytesInReadBuffer[threadNo]]);
+        if (!readDataFromFile(positionInFile, bytesInReadBuffer[threadNo], 
+                              &readBuffer[threadNo * bufferSize + bufferSize - bytesInReadBuffer[threadNo]])) {
+            bytesInReadBuffer[threadNo] = 0;
+            return false;
+        }
     }
 
     memcpy(pData, &readBuffer[threadNo * bufferSize + bufferSize - bytesInReadBuffer[threadNo]], numBytes);
@@ -9,31 +9,67 @@
 #ifndef BUFFERED_FILE_H
 #define BUFFERED_FILE_H
 
+#ifdef _WIN32
 #include <windows.h>
+#endif
+#include <cstring>
 #include <iostream>
 #include <string>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 using namespace std;
 
 class BufferedFile
 {
 private:
+    // a full write buffer of a thread, waiting to be written by the I/O thread
+    struct WriteJob
+    {
+        unsigned int threadNo;
+        long long offset;
+        unsigned int sizeInBytes;
+    };
+
     // Variables
+#ifdef _WIN32
     HANDLE hFile;					  // Handle of the file
+    CRITICAL_SECTION csIO;			  // file pointer and data transfer are separate calls
+#else
+    int fd;							  // file descriptor. pread() and pwrite() don't share a file offset, so no lock is needed
+#endif
     unsigned int numThreads;		  // number of threads
     unsigned char *readBuffer;		  // Array of size [numThreads*blockSize] containing the data of the block, where reading is taking place
     unsigned char *writeBuffer;		  //	 '' - access by [threadNo*bufferSize+position]
+    unsigned char *flushBuffer;		  //	 '' - copy of a full write buffer, which is being written by the I/O thread
+    bool *flushPending;				  // array of size [numThreads]. true while flushBuffer of the thread is in use
     long long *curReadingPointer;	  // array of size [numThreads] with pointers to the byte which is currently read
     long long *curWritingPointer;	  //			''
     unsigned int *bytesInReadBuffer;  //
     unsigned int *bytesInWriteBuffer; //
     unsigned int bufferSize;		  // size in bytes of a buffer
     long long fileSize;				  // size in bytes
-    CRITICAL_SECTION csIO;
+
+    // background writing
+    thread ioThread;				  // writes the flush buffers while the other threads go on computing
+    deque<WriteJob> writeJobs;		  // flush buffers waiting to be written
+    mutex csJobs;					  // protects writeJobs and flushPending
+    condition_variable condJobAdded;  // signals the I/O thread
+    condition_variable condJobDone;	  // signals threads waiting for their flush buffer
+    unsigned int numJobsPending;	  // jobs queued or being written
+    bool stopIoThread;				  //
+    atomic<bool> writeFailed;		  // true once the I/O thread could not write a flush buffer. reported by writeBytes() and flushBuffers()
 
     // Functions
-    void writeDataToFile(HANDLE hFile, long long offset, unsigned int sizeInBytes, void *pData);
-    void readDataFromFile(HANDLE hFile, long long offset, unsigned int sizeInBytes, void *pData);
+    bool isOpen();
+    bool writeDataToFile(long long offset, unsigned int sizeInBytes, void *pData);
+    bool readDataFromFile(long long offset, unsigned int sizeInBytes, void *pData);
+    void queueWriteBuffer(unsigned int threadNo);
+    void waitForPendingWrites();
+    void ioThreadProc();
 
 public:
     // Constructor / destructor
@@ -0,0 +1,381 @@
+/*********************************************************************
+    compressedArray.cpp
+    Copyright (C) 2021 The Sanmill developers (see AUTHORS file)
+    Licensed under the GPLv3 License.
+    https://github.com/madweasel/Muehle
+\*********************************************************************/
+
+#include "compressedArray.h"
+
+#include <atomic>
+
+namespace
+{
+// Direct-mapped cache of decompressed blocks. Each thread has its own, so no lock is needed.
+struct BlockCacheEntry
+{
+    unsigned long long arrayId; // id of the CompressedArray, 0 if the entry is empty
+    unsigned int blockNumber;	//
+    unsigned char data[CA_BLOCK_SIZE];
+};
+
+thread_local BlockCacheEntry blockCache[CA_CACHE_SIZE];
+
+atomic<unsigned long long> nextArrayId(1);
+}
+
+//-----------------------------------------------------------------------------
+// CompressedArray()
+// CompressedArray class constructor
+//-----------------------------------------------------------------------------
+CompressedArray::CompressedArray()
+{
+    image = nullptr;
+    imageSize = 0;
+    sizeInBytes = 0;
+    numBlocks = 0;
+    elementSize = 1;
+    blockOffset = nullptr;
+    blocks = nullptr;
+    id = nextArrayId++;
+}
+
+//-----------------------------------------------------------------------------
+// ~CompressedArray()
+// CompressedArray class destructor
+//-----------------------------------------------------------------------------
+CompressedArray::~CompressedArray()
+{
+}
+
+//-----------------------------------------------------------------------------
+// compressBlock()
+// Returns the compressed size, which is at most numBytes + ceil(numBytes / 128).
+// A run is only coded from 3 bytes on, so it saves at least the token of the
+// literals in front of it. Only full literal tokens and the last one remain.
+//-----------------------------------------------------------------------------
+unsigned int CompressedArray::compressBlock(const unsigned char *pData, unsigned int numBytes, unsigned char *pCompressed)
+{
+    unsigned int curByte = 0;
+    unsigned int compressedSize = 0;
+    unsigned int runLength;
+    unsigned int numLiterals;
+
+    while (curByte < numBytes) {
+
+        // count equal bytes
+        for (runLength = 1; curByte + runLength < numBytes && runLength < CA_MAX_RUN_LENGTH && pData[curByte + runLength] == pData[curByte]; runLength++)
+            ;
+
+        if (runLength >= 3) {
+            pCompressed[compressedSize++] = (unsigned char)(runLength + 126);
+            pCompressed[compressedSize++] = pData[curByte];
+            curByte += runLength;
+        } else {
+            // literals up to the next run of 3 bytes
+            for (numLiterals = 1; curByte + numLiterals < numBytes && numLiterals < 128; numLiterals++) {
+                if (curByte + numLiterals + 2 < numBytes && pData[curByte + numLiterals] == pData[curByte + numLiterals + 1] && pData[curByte + numLiterals] == pData[curByte + numLiterals + 2])
+                    break;
+            }
+            pCompressed[compressedSize++] = (unsigned char)(numLiterals - 1);
+            memcpy(&pCompressed[compressedSize], &pData[curByte], numLiterals);
+            compressedSize += numLiterals;
+            curByte += numLiterals;
+        }
+    }
+
+    return compressedSize;
+}
+
+//-----------------------------------------------------------------------------
+// decompressBlock()
+//
+//-----------------------------------------------------------------------------
+void CompressedArray::decompressBlock(const unsigned char *pCompressed, unsigned int compressedSize, unsigned char *pData, unsigned int numBytes)
+{
+    const unsigned char *pEnd = pCompressed + compressedSize;
+    unsigned char *pDataEnd = pData + numBytes;
+    unsigned int length;
+
+    while (pCompressed < pEnd && pData < pDataEnd) {
+        if (*pCompressed < 128) {
+            length = min((unsigned int)*pCompressed + 1, (unsigned int)(pDataEnd - pData));
+            memcpy(pData, pCompressed + 1, length);
+            pCompressed += *pCompressed + 2;
+        } else {
+            length = min((unsigned int)*pCompressed - 126, (unsigned int)(pDataEnd - pData));
+            memset(pData, pCompressed[1], length);
+            pCompressed += 2;
+        }
+        pData += length;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// splitBytePlanes()
+// Stores the first byte of all elements, then the second byte of all elements, ...
+//-----------------------------------------------------------------------------
+void CompressedArray::splitBytePlanes(const unsigned char *pData, unsigned int numBytes, unsigned int elementSize, unsigned char *pPlanes)
+{
+    unsigned int numElements = numBytes / elementSize;
+    unsigned int curElement;
+    unsigned int curByte;
+
+    for (curElement = 0; curElement < numElements; curElement++) {
+        for (curByte = 0; curByte < elementSize; curByte++) {
+            pPlanes[curByte * numElements + curElement] = pData[curElement * elementSize + curByte];
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// joinBytePlanes()
+// Reverses splitBytePlanes().
+//-----------------------------------------------------------------------------
+void CompressedArray::joinBytePlanes(const unsigned char *pPlanes, unsigned int numBytes, unsigned int elementSize, unsigned char *pData)
+{
+    unsigned int numElements = numBytes / elementSize;
+    unsigned int curElement;
+    unsigned int curByte;
+
+    for (curElement = 0; curElement < numElements; curElement++) {
+        for (curByte = 0; curByte < elementSize; curByte++) {
+            pData[curElement * elementSize + curByte] = pPlanes[curByte * numElements + curElement];
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// getTableSize()
+// Returns the size in bytes of the image in front of the first block.
+//-----------------------------------------------------------------------------
+long long CompressedArray::getTableSize(unsigned int numBlocks)
+{
+    return sizeof(long long) + 2 * sizeof(unsigned int) + ((long long)numBlocks + 1) * sizeof(unsigned int);
+}
+
+//-----------------------------------------------------------------------------
+// setImage()
+//
+//-----------------------------------------------------------------------------
+void CompressedArray::setImage(const unsigned char *pImage, long long size)
+{
+    image = pImage;
+    imageSize = size;
+    memcpy(&sizeInBytes, image, sizeof(long long));
+    memcpy(&numBlocks, image + sizeof(long long), sizeof(unsigned int));
+    memcpy(&elementSize, image + sizeof(long long) + sizeof(unsigned int), sizeof(unsigned int));
+    blockOffset = (const unsigned int *)(image + sizeof(long long) + 2 * sizeof(unsigned int));
+    blocks = image + getTableSize(numBlocks);
+}
+
+//-----------------------------------------------------------------------------
+// compress()
+// Builds the compressed image of the passed data. numBytes must be a multiple
+// of bytesPerElement, and bytesPerElement a divisor of CA_BLOCK_SIZE.
+//-----------------------------------------------------------------------------
+void CompressedArray::compress(const unsigned char *pData, long long numBytes, unsigned int bytesPerElement)
+{
+    unsigned int blockCount = (unsigned int)((numBytes + CA_BLOCK_SIZE - 1) / CA_BLOCK_SIZE);
+    long long tableSize = getTableSize(blockCount);
+    unsigned char planes[CA_BLOCK_SIZE];
+    unsigned char compressedBlock[CA_MAX_COMPRESSED_BLOCK_SIZE];
+    const unsigned char *pBlock;
+    unsigned int offset = 0;
+    unsigned int compressedSize;
+    unsigned int curBlock;
+    unsigned int numBytesInBlock;
+
+    ownImage.assign((size_t)tableSize, 0);
+    memcpy(&ownImage[0], &numBytes, sizeof(long long));
+    memcpy(&ownImage[sizeof(long long)], &blockCount, sizeof(unsigned int));
+    memcpy(&ownImage[sizeof(long long) + sizeof(unsigned int)], &bytesPerElement, sizeof(unsigned int));
+
+    for (curBlock = 0; curBlock <= blockCount; curBlock++) {
+        memcpy(&ownImage[sizeof(long long) + (2 + curBlock) * sizeof(unsigned int)], &offset, sizeof(unsigned int));
+
+        if (curBlock == blockCount)
+            break;
+
+        pBlock = pData + (long long)curBlock * CA_BLOCK_SIZE;
+        numBytesInBlock = (unsigned int)min((long long)CA_BLOCK_SIZE, numBytes - (long long)curBlock * CA_BLOCK_SIZE);
+
+        if (bytesPerElement > 1) {
+            splitBytePlanes(pBlock, numBytesInBlock, bytesPerElement, planes);
+            pBlock = planes;
+        }
+
+        compressedSize = compressBlock(pBlock, numBytesInBlock, compressedBlock);
+        ownImage.insert(ownImage.end(), compressedBlock, compressedBlock + compressedSize);
+        offset += compressedSize;
+    }
+
+    setImage(&ownImage[0], (long long)ownImage.size());
+}
+
+//-----------------------------------------------------------------------------
+// attach()
+// Uses an image built by compress() elsewhere, e.g. mapped from a file.
+// The image must be aligned to 4 bytes and stay unchanged as long as it is used.
+// size may include padding behind the image.
+//-----------------------------------------------------------------------------
+bool CompressedArray::attach(const unsigned char *pImage, long long size)
+{
+    long long uncompressedSize;
+    unsigned int blockCount;
+    unsigned int bytesPerElement;
+    long long tableSize;
+    unsigned int lastOffset;
+
+    // check consistency of the table
+    if (size < getTableSize(0))
+        return false;
+
+    memcpy(&uncompressedSize, pImage, sizeof(long long));
+    memcpy(&blockCount, pImage + sizeof(long long), sizeof(unsigned int));
+    memcpy(&bytesPerElement, pImage + sizeof(long long) + sizeof(unsigned int), sizeof(unsigned int));
+    tableSize = getTableSize(blockCount);
+
+    if (size < tableSize || (long long)blockCount != (uncompressedSize + CA_BLOCK_SIZE - 1) / CA_BLOCK_SIZE)
+        return false;
+
+    if (bytesPerElement == 0 || CA_BLOCK_SIZE % bytesPerElement != 0 || uncompressedSize % bytesPerElement != 0)
+        return false;
+
+    memcpy(&lastOffset, pImage + tableSize - sizeof(unsigned int), sizeof(unsigned int));
+
+    if (tableSize + lastOffset > size)
+        return false;
+
+    ownImage.clear();
+    setImage(pImage, tableSize + lastOffset);
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// getBlock()
+// Returns the decompressed block from the cache of the calling thread.
+//-----------------------------------------------------------------------------
+const unsigned char *CompressedArray::getBlock(unsigned int blockNumber)
+{
+    BlockCacheEntry &entry = blockCache[(id * 31 + blockNumber) % CA_CACHE_SIZE];
+    unsigned char planes[CA_BLOCK_SIZE];
+    unsigned int numBytesInBlock;
+
+    if (entry.arrayId != id || entry.blockNumber != blockNumber) {
+        numBytesInBlock = (unsigned int)min((long long)CA_BLOCK_SIZE, sizeInBytes - (long long)blockNumber * CA_BLOCK_SIZE);
+
+        if (elementSize > 1) {
+            decompressBlock(blocks + blockOffset[blockNumber], blockOffset[blockNumber + 1] - blockOffset[blockNumber], planes, numBytesInBlock);
+            joinBytePlanes(planes, numBytesInBlock, elementSize, entry.data);
+        } else {
+            decompressBlock(blocks + blockOffset[blockNumber], blockOffset[blockNumber + 1] - blockOffset[blockNumber], entry.data, numBytesInBlock);
+        }
+
+        entry.arrayId = id;
+        entry.blockNumber = blockNumber;
+    }
+
+    return entry.data;
+}
+
+//-----------------------------------------------------------------------------
+// getByte()
+//
+//-----------------------------------------------------------------------------
+unsigned char CompressedArray::getByte(long long position)
+{
+    return getBlock((unsigned int)(position / CA_BLOCK_SIZE))[position % CA_BLOCK_SIZE];
+}
+
+//-----------------------------------------------------------------------------
+// getBytes()
+//
+//-----------------------------------------------------------------------------
+void CompressedArray::getBytes(long long position, unsigned int numBytes, unsigned char *pBytes)
+{
+    unsigned int numBytesInBlock;
+
+    while (numBytes > 0) {
+        numBytesInBlock = (unsigned int)min((long long)numBytes, CA_BLOCK_SIZE - position % CA_BLOCK_SIZE);
+        memcpy(pBytes, getBlock((unsigned int)(position / CA_BLOCK_SIZE)) + position % CA_BLOCK_SIZE, numBytesInBlock);
+        position += numBytesInBlock;
+        pBytes += numBytesInBlock;
+        numBytes -= numBytesInBlock;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// getImage()
+//
+//-----------------------------------------------------------------------------
+const unsigned char *CompressedArray::getImage()
+{
+    return image;
+}
+
+//-----------------------------------------------------------------------------
+// getImageSize()
+//
+//-----------------------------------------------------------------------------
+long long CompressedArray::getImageSize()
+{
+    return imageSize;
+}
+
+//-----------------------------------------------------------------------------
+// getSizeInBytes()
+//
+//-----------------------------------------------------------------------------
+long long CompressedArray::getSizeInBytes()
+{
+    return sizeInBytes;
+}
+
+//-----------------------------------------------------------------------------
+// test()
+// Compresses patterns which are hard for the coding and checks that they are
+// restored and stay within CA_MAX_COMPRESSED_BLOCK_SIZE per block.
+//-----------------------------------------------------------------------------
+bool CompressedArray::test()
+{
+    // locals
+    const unsigned int numBytes = 4 * CA_BLOCK_SIZE + 12;
+    const unsigned int numPatterns = 6;
+    vector<unsigned char> data(numBytes);
+    vector<unsigned char> restored(numBytes);
+    unsigned int curPattern;
+    unsigned int curByte;
+    unsigned int bytesPerElement;
+
+    for (curPattern = 0; curPattern < numPatterns; curPattern++) {
+        for (curByte = 0; curByte < numBytes; curByte++) {
+            switch (curPattern) {
+            case 0: data[curByte] = (curByte % 2) ? 0x22 : 0x11; break;		// alternating
+            case 1: data[curByte] = (curByte % 3) ? 0x22 : 0x11; break;		// x,y,y
+            case 2: data[curByte] = (curByte % 4) < 2 ? 0x22 : 0x11; break;	// x,x,y,y
+            case 3: data[curByte] = (unsigned char)(curByte * 7 + curByte / 256); break; // literals only
+            case 4: data[curByte] = 0x33; break;								// one run
+            case 5: data[curByte] = (unsigned char)((curByte / 3) % 2); break;	// runs of 3
+            }
+        }
+
+        for (bytesPerElement = 1; bytesPerElement <= 4; bytesPerElement *= 2) {
+            CompressedArray compressed;
+            compressed.compress(&data[0], numBytes, bytesPerElement);
+
+            for (curByte = 0; curByte < compressed.numBlocks; curByte++) {
+                if (compressed.blockOffset[curByte + 1] - compressed.blockOffset[curByte] > CA_MAX_COMPRESSED_BLOCK_SIZE)
+                    return false;
+            }
+
+            compressed.getBytes(0, numBytes, &restored[0]);
+
+            if (restored != data)
+                return false;
+        }
+    }
+
+    return true;
+}
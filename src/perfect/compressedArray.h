@@ -0,0 +1,78 @@
+/*********************************************************************\
+    compressedArray.h
+    Copyright (C) 2021 The Sanmill developers (see AUTHORS file)
+    Licensed under the GPLv3 License.
+    https://github.com/madweasel/Muehle
+\*********************************************************************/
+
+#ifndef COMPRESSED_ARRAY_H
+#define COMPRESSED_ARRAY_H
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+#define CA_BLOCK_SIZE 256	  // uncompressed size in bytes of a block, which is decompressed as a whole
+#define CA_CACHE_SIZE 64	  // number of decompressed blocks kept per thread
+#define CA_MAX_RUN_LENGTH 129 // longest run of equal bytes stored by one token
+#define CA_MAX_COMPRESSED_BLOCK_SIZE (CA_BLOCK_SIZE + (CA_BLOCK_SIZE + 127) / 128) // worst case of compressBlock()
+
+// Byte array which is compressed block by block, so that any byte can be read
+// without decompressing the whole array. A block is coded as a sequence of
+// tokens. A token t < 128 is followed by t + 1 literal bytes, a token t >= 128
+// by one byte, which is repeated t - 126 times. Short knot values are mostly
+// drawn or invalid, so most blocks shrink to a few tokens.
+// Arrays of multi-byte elements, like the ply infos, are split into byte planes
+// within each block before coding, so that equal elements form runs.
+//
+// The compressed form is a single position-independent image:
+//     long long	 sizeInBytes				uncompressed size
+//     unsigned int  numBlocks
+//     unsigned int  elementSize				size in bytes of an element, CA_BLOCK_SIZE is a multiple of it
+//     unsigned int  blockOffset[numBlocks + 1]  offset of each block behind the table
+//     unsigned char blocks[]
+// It can be written to a file as it is and read from a mapped view.
+//
+// Reading is thread-safe. Each thread keeps its own cache of decompressed blocks.
+class CompressedArray
+{
+private:
+    // Variables
+    vector<unsigned char> ownImage;		 // image built by compress(), empty if the image was attached
+    const unsigned char *image;			 // the compressed image
+    long long imageSize;				 // size in bytes of the image
+    long long sizeInBytes;				 // uncompressed size in bytes
+    unsigned int numBlocks;				 // number of blocks
+    unsigned int elementSize;			 // size in bytes of an element
+    const unsigned int *blockOffset;	 // array of size [numBlocks + 1] inside the image
+    const unsigned char *blocks;		 // first block inside the image
+    unsigned long long id;				 // unique number identifying this array in the block caches
+
+    // Functions
+    static unsigned int compressBlock(const unsigned char *pData, unsigned int numBytes, unsigned char *pCompressed);
+    static void decompressBlock(const unsigned char *pCompressed, unsigned int compressedSize, unsigned char *pData, unsigned int numBytes);
+    static void splitBytePlanes(const unsigned char *pData, unsigned int numBytes, unsigned int elementSize, unsigned char *pPlanes);
+    static void joinBytePlanes(const unsigned char *pPlanes, unsigned int numBytes, unsigned int elementSize, unsigned char *pData);
+    static long long getTableSize(unsigned int numBlocks);
+    const unsigned char *getBlock(unsigned int blockNumber);
+    void setImage(const unsigned char *pImage, long long size);
+
+public:
+    // Constructor / destructor
+    CompressedArray();
+    ~CompressedArray();
+
+    // Functions
+    void compress(const unsigned char *pData, long long numBytes, unsigned int bytesPerElement);
+    bool attach(const unsigned char *pImage, long long size);
+    unsigned char getByte(long long position);
+    void getBytes(long long position, unsigned int numBytes, unsigned char *pBytes);
+    const unsigned char *getImage();
+    long long getImageSize();
+    long long getSizeInBytes();
+    static bool test();
+};
+
+#endif
@@ -8,6 +8,18 @@
 
 #include "cyclicArray.h"
 
+#ifndef _WIN32
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CYCLIC_ARRAY_WINDOW_SIZE (1 << 20) // size in bytes of a mapped window, a multiple of the page size
+#endif
+
+#ifdef _WIN32
+
 //-----------------------------------------------------------------------------
 // CyclicArray()
 // Creates a cyclic array. The passed file is used as temporary data buffer for the cyclic array.
@@ -224,7 +236,7 @@ bool CyclicArray::takeBytes(unsigned int numBytes, unsigned char *pData)
 // Load the passed file into the cyclic array.
 //       The passed filename must be different than the passed filename to the constructor cyclicarray().
 //-----------------------------------------------------------------------------
-bool CyclicArray::loadFile(const char *fileName, LONGLONG &numBytesLoaded)
+bool CyclicArray::loadFile(const char *fileName, long long &numBytesLoaded)
 {
     // locals
     HANDLE hLoadFile;
@@ -358,3 +370,277 @@ bool CyclicArray::saveFile(const char *fileName)
     CloseHandle(hSaveFile);
     return true;
 }
+
+#else
+
+//-----------------------------------------------------------------------------
+// CyclicArray()
+// Creates a cyclic array. The passed file is used as temporary data buffer for the cyclic array.
+//-----------------------------------------------------------------------------
+CyclicArray::CyclicArray(unsigned int blockSizeInBytes, unsigned int numberOfBlocks, const char *fileName)
+{
+    // Init ring
+    blockSize = blockSizeInBytes;
+    numBlocks = numberOfBlocks;
+    capacity = ((long long)blockSize) * ((long long)numBlocks);
+    windowSize = CYCLIC_ARRAY_WINDOW_SIZE;
+    totalBytesWritten = 0;
+    totalBytesRead = 0;
+    readingWindow.view = nullptr;
+    writingWindow.view = nullptr;
+
+    fd = open(fileName, O_RDWR | O_CREAT, 0644);
+
+    // opened file succesfully
+    if (fd == -1) {
+        return;
+    }
+
+    // the file is sparse, so disk space is only used where states are written
+    if (ftruncate(fd, capacity) == -1) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// ~CyclicArray()
+// CyclicArray class destructor
+//-----------------------------------------------------------------------------
+CyclicArray::~CyclicArray()
+{
+    unmapWindow(readingWindow, true);
+    unmapWindow(writingWindow, false);
+
+    // close file
+    if (fd != -1)
+        close(fd);
+}
+
+//-----------------------------------------------------------------------------
+// mapWindow()
+// Returns a pointer to the byte at 'position' of the ring, after moving the
+// window there if necessary. Returns nullptr on failure.
+//-----------------------------------------------------------------------------
+unsigned char *CyclicArray::mapWindow(Window &window, long long position, bool reading)
+{
+    void *view;
+
+    if (window.view != nullptr && position >= window.offset && position < window.offset + (long long)window.size) {
+        return window.view + (position - window.offset);
+    }
+
+    unmapWindow(window, reading);
+
+    if (fd == -1) {
+        return nullptr;
+    }
+
+    window.offset = position - position % windowSize;
+    window.size = (size_t)min((long long)windowSize, capacity - window.offset);
+    view = mmap(nullptr, window.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, window.offset);
+
+    if (view == MAP_FAILED) {
+        return nullptr;
+    }
+
+    window.view = (unsigned char *)view;
+    madvise(window.view, window.size, MADV_SEQUENTIAL);
+
+    return window.view + (position - window.offset);
+}
+
+//-----------------------------------------------------------------------------
+// unmapWindow()
+// 
+//-----------------------------------------------------------------------------
+void CyclicArray::unmapWindow(Window &window, bool reading)
+{
+    if (window.view == nullptr)
+        return;
+
+    // data which has been read is not needed anymore
+    if (reading)
+        madvise(window.view, window.size, MADV_DONTNEED);
+
+    munmap(window.view, window.size);
+    window.view = nullptr;
+}
+
+//-----------------------------------------------------------------------------
+// addBytes()
+// Add the passed data to the cyclic array. Returns false if the ring is full.
+//-----------------------------------------------------------------------------
+bool CyclicArray::addBytes(unsigned int numBytes, unsigned char *pData)
+{
+    // locals
+    long long bytesWritten = totalBytesWritten.load(memory_order_relaxed);
+    long long position;
+    unsigned char *pWindow;
+    unsigned int numBytesInWindow;
+
+    // would unread data be overwritten?
+    if (bytesWritten + numBytes - totalBytesRead.load(memory_order_acquire) > capacity)
+        return false;
+
+    while (numBytes > 0) {
+        position = bytesWritten % capacity;
+        pWindow = mapWindow(writingWindow, position, false);
+        if (pWindow == nullptr)
+            return false;
+
+        numBytesInWindow = (unsigned int)min((long long)numBytes, writingWindow.offset + (long long)writingWindow.size - position);
+        memcpy(pWindow, pData, numBytesInWindow);
+        bytesWritten += numBytesInWindow;
+        pData += numBytesInWindow;
+        numBytes -= numBytesInWindow;
+    }
+
+    totalBytesWritten.store(bytesWritten, memory_order_release);
+
+    // everything ok
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// bytesAvailable()
+// 
+//-----------------------------------------------------------------------------
+bool CyclicArray::bytesAvailable()
+{
+    return totalBytesWritten.load(memory_order_acquire) != totalBytesRead.load(memory_order_relaxed);
+}
+
+//-----------------------------------------------------------------------------
+// takeBytes()
+// Load data from the cyclic array. Returns false if there are less than 'numBytes' bytes.
+//-----------------------------------------------------------------------------
+bool CyclicArray::takeBytes(unsigned int numBytes, unsigned char *pData)
+{
+    // locals
+    long long bytesRead = totalBytesRead.load(memory_order_relaxed);
+    long long position;
+    unsigned char *pWindow;
+    unsigned int numBytesInWindow;
+
+    // were the bytes already written?
+    if (totalBytesWritten.load(memory_order_acquire) - bytesRead < numBytes)
+        return false;
+
+    while (numBytes > 0) {
+        position = bytesRead % capacity;
+        pWindow = mapWindow(readingWindow, position, true);
+        if (pWindow == nullptr)
+            return false;
+
+        numBytesInWindow = (unsigned int)min((long long)numBytes, readingWindow.offset + (long long)readingWindow.size - position);
+        memcpy(pData, pWindow, numBytesInWindow);
+        bytesRead += numBytesInWindow;
+        pData += numBytesInWindow;
+        numBytes -= numBytesInWindow;
+    }
+
+    totalBytesRead.store(bytesRead, memory_order_release);
+
+    // everything ok
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// loadFile()
+// Load the passed file into the cyclic array.
+//       The passed filename must be different than the passed filename to the constructor cyclicarray().
+//-----------------------------------------------------------------------------
+bool CyclicArray::loadFile(const char *fileName, long long &numBytesLoaded)
+{
+    // locals
+    int loadFd;
+    struct stat fileStat;
+    unsigned char *dataInFile;
+    ssize_t numBytesRead;
+    bool ok = true;
+    numBytesLoaded = 0;
+
+    // cyclic array file must be open
+    if (fd == -1)
+        return false;
+
+    loadFd = open(fileName, O_RDONLY);
+
+    // opened file succesfully
+    if (loadFd == -1) {
+        return false;
+    }
+
+    // does data of file fit into cyclic array ?
+    if (fstat(loadFd, &fileStat) == -1 || capacity < fileStat.st_size) {
+        close(loadFd);
+        return false;
+    }
+
+    // reset
+    unmapWindow(readingWindow, true);
+    unmapWindow(writingWindow, false);
+    totalBytesWritten = 0;
+    totalBytesRead = 0;
+
+    dataInFile = new unsigned char[blockSize];
+
+    while ((numBytesRead = read(loadFd, dataInFile, blockSize)) > 0) {
+        if (!addBytes((unsigned int)numBytesRead, dataInFile)) {
+            ok = false;
+            break;
+        }
+        numBytesLoaded += numBytesRead;
+    }
+
+    delete[] dataInFile;
+    close(loadFd);
+    return ok && numBytesRead == 0;
+}
+
+//-----------------------------------------------------------------------------
+// saveFile()
+// Writes the whole current content of the cyclic array to the passed file.
+//       The passed filename must be different than the passed filename to the constructor cyclicarray().
+//-----------------------------------------------------------------------------
+bool CyclicArray::saveFile(const char *fileName)
+{
+    // locals
+    int saveFd;
+    unsigned char *dataInFile;
+    long long bytesRead = totalBytesRead;
+    long long bytesWritten = totalBytesWritten;
+    long long position;
+    unsigned int bytesToWrite;
+    bool ok = true;
+
+    // cyclic array file must be open
+    if (fd == -1) {
+        return false;
+    }
+
+    saveFd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    // opened file succesfully
+    if (saveFd == -1) {
+        return false;
+    }
+
+    dataInFile = new unsigned char[blockSize];
+
+    // the mapped windows and the file share the page cache, so the file can be read directly
+    while (ok && bytesRead < bytesWritten) {
+        position = bytesRead % capacity;
+        bytesToWrite = (unsigned int)min(min((long long)blockSize, bytesWritten - bytesRead), capacity - position);
+        ok = pread(fd, dataInFile, bytesToWrite, position) == (ssize_t)bytesToWrite
+            && write(saveFd, dataInFile, bytesToWrite) == (ssize_t)bytesToWrite;
+        bytesRead += bytesToWrite;
+    }
+
+    delete[] dataInFile;
+    close(saveFd);
+    return ok;
+}
+
+#endif
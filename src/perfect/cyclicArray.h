@@ -9,9 +9,13 @@
 #ifndef CYLCIC_ARRAY_H
 #define CYLCIC_ARRAY_H
 
+#ifdef _WIN32
 #include <windows.h>
+#endif
+#include <cstring>
 #include <iostream>
 #include <string>
+#include <atomic>
 
 using namespace std;
 
@@ -19,20 +23,45 @@ class CyclicArray
 {
 private:
     // Variables
+#ifdef _WIN32
     HANDLE hFile;					  // Handle of the file
     unsigned char *readingBlock;	  // Array of size [blockSize] containing the data of the block, where reading is taking place
     unsigned char *writingBlock;	  //			''
     unsigned char *curReadingPointer; // pointer to the byte which is currently read
     unsigned char *curWritingPointer; //			''
-    unsigned int blockSize;			  // size in bytes of a block
     unsigned int curReadingBlock;	  // index of the block, where reading is taking place
     unsigned int curWritingBlock;	  // index of the block, where writing is taking place
-    unsigned int numBlocks;			  // amount of blocks
     bool readWriteInSameRound;		  // true if curReadingBlock > curWritingBlock, false otherwise
+#else
+    // The ring file is accessed through two mapped windows, one where reading
+    // and one where writing takes place. Only these two windows are resident,
+    // whatever the size of the ring.
+    struct Window
+    {
+        unsigned char *view;		  // mapped pages or nullptr
+        long long offset;			  // offset in the file of the first mapped byte, a multiple of windowSize
+        size_t size;				  // number of mapped bytes
+    };
+
+    int fd;							  // file descriptor of the ring file
+    long long capacity;				  // size in bytes of the ring
+    size_t windowSize;				  // size in bytes of a mapped window
+    atomic<long long> totalBytesWritten; // number of bytes ever added. the writer alone changes it
+    atomic<long long> totalBytesRead;	 // number of bytes ever taken. the reader alone changes it
+    Window readingWindow;			  //
+    Window writingWindow;			  //
+#endif
+    unsigned int blockSize;			  // size in bytes of a block
+    unsigned int numBlocks;			  // amount of blocks
 
     // Functions
+#ifdef _WIN32
     void writeDataToFile(HANDLE hFile, long long offset, unsigned int sizeInBytes, void *pData);
     void readDataFromFile(HANDLE hFile, long long offset, unsigned int sizeInBytes, void *pData);
+#else
+    unsigned char *mapWindow(Window &window, long long position, bool reading);
+    void unmapWindow(Window &window, bool reading);
+#endif
 
 public:
     // Constructor / destructor
@@ -42,7 +71,7 @@ public:
     // Functions
     bool addBytes(unsigned int numBytes, unsigned char *pData);
     bool takeBytes(unsigned int numBytes, unsigned char *pData);
-    bool loadFile(const char *fileName, LONGLONG &numBytesLoaded);
+    bool loadFile(const char *fileName, long long &numBytesLoaded);
     bool saveFile(const char *fileName);
     bool bytesAvailable();
 };
@@ -0,0 +1,229 @@
+/*********************************************************************
+    mappedFile.cpp
+    Copyright (C) 2021 The Sanmill developers (see AUTHORS file)
+    Licensed under the GPLv3 License.
+    https://github.com/madweasel/Muehle
+\*********************************************************************/
+
+#include "mappedFile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// MappedFile()
+// MappedFile class constructor
+//-----------------------------------------------------------------------------
+MappedFile::MappedFile()
+{
+#ifdef _WIN32
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    granularity = systemInfo.dwAllocationGranularity;
+    hFile = nullptr;
+    hMapping = nullptr;
+    mappingSize = 0;
+#else
+    granularity = sysconf(_SC_PAGESIZE);
+    fd = -1;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// ~MappedFile()
+// MappedFile class destructor
+//-----------------------------------------------------------------------------
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+//-----------------------------------------------------------------------------
+// open()
+// Opens the file for reading. Nothing is mapped yet.
+//-----------------------------------------------------------------------------
+bool MappedFile::open(const char *fileName)
+{
+    close();
+
+#ifdef _WIN32
+    // the database class keeps its own handle with write access open
+    hFile = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        hFile = nullptr;
+        return false;
+    }
+#else
+    fd = ::open(fileName, O_RDONLY);
+
+    if (fd == -1) {
+        return false;
+    }
+#endif
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// close()
+// Unmaps all views and closes the file.
+//-----------------------------------------------------------------------------
+void MappedFile::close()
+{
+    for (auto &view : views) {
+#ifdef _WIN32
+        UnmapViewOfFile(view.first);
+#else
+        munmap(view.first, view.second);
+#endif
+    }
+
+    views.clear();
+
+#ifdef _WIN32
+    if (hMapping != nullptr) {
+        CloseHandle(hMapping);
+        hMapping = nullptr;
+        mappingSize = 0;
+    }
+
+    if (hFile != nullptr) {
+        CloseHandle(hFile);
+        hFile = nullptr;
+    }
+#else
+    if (fd != -1) {
+        ::close(fd);
+        fd = -1;
+    }
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// isOpen()
+//
+//-----------------------------------------------------------------------------
+bool MappedFile::isOpen()
+{
+#ifdef _WIN32
+    return hFile != nullptr;
+#else
+    return fd != -1;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// getFileSize()
+//
+//-----------------------------------------------------------------------------
+long long MappedFile::getFileSize()
+{
+#ifdef _WIN32
+    LARGE_INTEGER liFileSize;
+
+    if (!GetFileSizeEx(hFile, &liFileSize)) {
+        return 0;
+    }
+
+    return liFileSize.QuadPart;
+#else
+    struct stat fileStat;
+
+    if (fstat(fd, &fileStat) == -1) {
+        return 0;
+    }
+
+    return fileStat.st_size;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// map()
+// Maps numBytes of the file beginning at offset and returns a pointer to the
+// byte at offset, or nullptr if the region could not be mapped.
+//-----------------------------------------------------------------------------
+const unsigned char *MappedFile::map(long long offset, long long numBytes, Advice advice)
+{
+    // views start at a multiple of the granularity
+    long long viewOffset = offset - offset % granularity;
+    size_t viewSize = (size_t)(offset + numBytes - viewOffset);
+    void *view;
+
+    // touching a page beyond the end of the file would fault
+    if (!isOpen() || numBytes <= 0 || offset + numBytes > getFileSize()) {
+        return nullptr;
+    }
+
+#ifdef _WIN32
+    // a mapping object cannot grow with the file, so create a larger one when needed. views of the old one stay valid.
+    if (offset + numBytes > mappingSize) {
+        if (hMapping != nullptr) {
+            CloseHandle(hMapping);
+        }
+
+        mappingSize = getFileSize();
+        hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+        if (hMapping == nullptr) {
+            mappingSize = 0;
+            return nullptr;
+        }
+    }
+
+    view = MapViewOfFile(hMapping, FILE_MAP_READ, (DWORD)(viewOffset >> 32), (DWORD)(viewOffset & 0xFFFFFFFF), viewSize);
+
+    if (view == nullptr) {
+        return nullptr;
+    }
+#else
+    view = mmap(nullptr, viewSize, PROT_READ, MAP_SHARED, fd, viewOffset);
+
+    if (view == MAP_FAILED) {
+        return nullptr;
+    }
+#endif
+
+    views.push_back(make_pair(view, viewSize));
+
+    advise((unsigned char *)view, viewSize, advice);
+
+    return (unsigned char *)view + (offset - viewOffset);
+}
+
+//-----------------------------------------------------------------------------
+// advise()
+// Tells the operating system how a mapped region is going to be accessed.
+//-----------------------------------------------------------------------------
+void MappedFile::advise(const unsigned char *pBytes, long long numBytes, Advice advice)
+{
+    // advice applies to whole pages
+    unsigned char *pageBegin = (unsigned char *)pBytes - ((size_t)pBytes % granularity);
+    size_t size = (size_t)(pBytes + numBytes - pageBegin);
+
+#ifdef _WIN32
+    // unlocking pages, which are not locked, removes them from the working set
+    if (advice == adviceDontNeed) {
+        VirtualUnlock(pageBegin, size);
+    }
+#if _WIN32_WINNT >= 0x0602
+    // Windows reads ahead only on demand, so there is nothing to do for random access
+    if (advice == adviceWillNeed) {
+        WIN32_MEMORY_RANGE_ENTRY range;
+        range.VirtualAddress = pageBegin;
+        range.NumberOfBytes = size;
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+#endif
+#else
+    switch (advice) {
+    case adviceRandom:	 madvise(pageBegin, size, MADV_RANDOM);	  break;
+    case adviceWillNeed: madvise(pageBegin, size, MADV_WILLNEED); break;
+    case adviceDontNeed: madvise(pageBegin, size, MADV_DONTNEED); break;
+    }
+#endif
+}
@@ -0,0 +1,61 @@
+/*********************************************************************\
+    mappedFile.h
+    Copyright (C) 2021 The Sanmill developers (see AUTHORS file)
+    Licensed under the GPLv3 License.
+    https://github.com/madweasel/Muehle
+\*********************************************************************/
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <vector>
+
+using namespace std;
+
+// Read-only memory mapping of regions of a database file. Each region is
+// mapped once and stays valid until close(). The regions must already be
+// written completely, since the file may still grow behind them.
+// The class is not thread-safe. The caller serializes map() and close().
+class MappedFile
+{
+public:
+    // Access pattern of a mapped region
+    enum Advice
+    {
+        adviceRandom,	// single bytes are probed all over the region, so don't read ahead
+        adviceWillNeed,	// the region is needed soon, so start reading it in now
+        adviceDontNeed	// the region is not needed for a while, so release its pages. they are read in again on access
+    };
+
+private:
+    // Variables
+#ifdef _WIN32
+    HANDLE hFile;					  // handle of the file, opened for reading only
+    HANDLE hMapping;				  // file mapping object covering the first mappingSize bytes of the file
+    long long mappingSize;			  // size in bytes of the file when hMapping was created
+#else
+    int fd;							  // file descriptor, opened for reading only
+#endif
+    long long granularity;			  // offsets of views must be a multiple of this
+    vector<pair<void *, size_t>> views; // all views mapped so far, unmapped by close()
+
+    // Functions
+    long long getFileSize();
+
+public:
+    // Constructor / destructor
+    MappedFile();
+    ~MappedFile();
+
+    // Functions
+    bool open(const char *fileName);
+    void close();
+    bool isOpen();
+    const unsigned char *map(long long offset, long long numBytes, Advice advice);
+    void advise(const unsigned char *pBytes, long long numBytes, Advice advice);
+};
+
+#endif
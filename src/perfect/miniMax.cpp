@@ -118,6 +118,11 @@ void *MiniMax::getBestChoice(unsigned int tilLevel, unsigned int *choice, unsign
     // prepare the situation
     prepareBestChoiceCalculation();
 
+    // the tree below the root is looked up in the current layer and its successors
+    if (layerInDatabase) {
+        prefetchLayer(alphaBetaVars.layerNumber);
+    }
+
     // First make a tree until the desired level
     letTheTreeGrow(&root, &tva, depthOfFullTree, FPKV_MIN_VALUE, FPKV_MAX_VALUE);
 
@@ -184,6 +189,9 @@ void MiniMax::calculateDatabase(unsigned int maxDepthOfTree, bool onlyPrepLayer)
             // save header
             saveHeader(&skvfHeader, layerStats);
             saveHeader(&plyInfoHeader, plyInfos);
+
+            // the layer is completed and in file, so its checkpoint is not needed any more
+            deleteCheckpoint(curCalculatedLayer);
         }
 
         // don't save layer and header when only preparing layers or when
@@ -199,6 +207,9 @@ void MiniMax::calculateDatabase(unsigned int maxDepthOfTree, bool onlyPrepLayer)
             plyInfoHeader.plyInfoCompleted = true;
             saveHeader(&skvfHeader, layerStats);
             saveHeader(&plyInfoHeader, plyInfos);
+
+            // all further read operations use the compressed files
+            compressDatabase();
         }
 
         // free memory
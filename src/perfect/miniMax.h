@@ -19,10 +19,13 @@
 #include <time.h>
 #include <vector>
 #include <algorithm>
+#include <atomic>
 #include "cyclicArray.h"
 #include "strLib.h"
 #include "threadManager.h"
 #include "bufferedFile.h"
+#include "mappedFile.h"
+#include "compressedArray.h"
 
 #pragma warning(disable: 4100)
 #pragma warning(disable: 4238)
@@ -66,11 +69,18 @@ database:				The database contains the arrays with the short knot values and the
 
 #define SKV_FILE_HEADER_CODE 0xF4F5 // constant to identify the header
 #define PLYINFO_HEADER_CODE 0xF3F2	//     ''
+#define SKV_COMPRESSED_HEADER_CODE 0xF6F7	  //     ''
+#define PLYINFO_COMPRESSED_HEADER_CODE 0xF1F0 //     ''
+#define CHECKPOINT_HEADER_CODE 0xC5C4		  //     ''
+#define CHECKPOINT_CHECKSUM_BASIS 0xCBF29CE484222325ull // initial value of the FNV-1a checksum of a checkpoint
 
 #define OUTPUT_EVERY_N_STATES 10000000	 // print progress every n-th processed knot
 #define BLOCK_SIZE_IN_CYCLIC_ARRAY 10000 // BLOCK_SIZE_IN_CYCLIC_ARRAY*sizeof(stateAdressStruct) = block size in bytes for the cyclic arrays
 #define MAX_NUM_PREDECESSORS 10000		 // maximum number of predecessors. important for array sizes
+#define RETRO_ANALYSIS_BATCH_SIZE 64	 // number of states taken at once from 'statesToProcess', whose predecessors are sorted before being processed
+#define RETRO_ANALYSIS_PREFETCH_DISTANCE 16 // number of sorted predecessors ahead of the processed one, whose values are prefetched
 #define FILE_BUFFER_SIZE 1000000		 // size in bytes
+#define CHECKPOINT_INTERVAL 1800		 // default number of seconds between two checkpoints of the retro analysis
 
 #define PL_TO_MOVE_CHANGED 1   // player to move changed			- second index of the 2D-array skvPerspectiveMatrix[][]
 #define PL_TO_MOVE_UNCHANGED 0 // player to move is still the same - second index of the 2D-array skvPerspectiveMatrix[][]
@@ -146,6 +156,20 @@ public:
         unsigned int headerAndStatsSize; // size in bytes of this struct plus the stats
     };
 
+    struct CompressedFileHeader // header of the files with the compressed short knot values and ply infos, followed by long long imageOffset[numLayers + 1]
+    {
+        unsigned int headerCode; // = SKV_COMPRESSED_HEADER_CODE or PLYINFO_COMPRESSED_HEADER_CODE
+        unsigned int numLayers;	 // number of layers
+    };
+
+    struct CheckpointFileHeader // header of a checkpoint of the retro analysis, followed by the layer numbers and the arrays of the calculated layers
+    {
+        unsigned int headerCode;	 // = CHECKPOINT_HEADER_CODE
+        unsigned int numLayers;		 // number of layers being calculated
+        unsigned int nextPly;		 // ply number of the first states not processed yet
+        unsigned long long checksum; // checksum of the fields above and of everything behind this header
+    };
+
     struct PlyInfoFileHeader
     {
         bool plyInfoCompleted;				// true if ply information has been calculated for all game states
@@ -162,8 +186,7 @@ public:
         unsigned int sizeInBytes;		  // size of this struct plus the array plyInfo[]
         StateNumberVarType knotsInLayer;  // number of knots of the corresponding layer
         PlyInfoVarType *plyInfo;		  // array of size [knotsInLayer] containing the ply info for each knot in this layer
-        // compressorClass::compressedArrayClass *	plyInfoCompressed;		// compressed array containing the ply info for each knot in this layer
-        void *plyInfoCompressed; // dummy pointer for padding
+        CompressedArray *plyInfoCompressed; // compressed array containing the ply info for each knot in this layer, nullptr if there is no compressed file. only valid in memory
     };
 
     struct LayerStats
@@ -181,8 +204,7 @@ public:
         StateNumberVarType numInvalidStates;		  // number of invalid states in this layer
         unsigned int sizeInBytes;					  // (knotsInLayer + 3) / 4
         TwoBit *shortKnotValueByte;					  // array of size [sizeInBytes] containing the short knot values
-        //compressorClass::compressedArrayClass *	skvCompressed;			// compressed array containing the short knot values
-        void *skvCompressed; // dummy pointer for padding
+        CompressedArray *skvCompressed;				  // compressed array containing the short knot values, nullptr if there is no compressed file. only valid in memory
     };
 
     struct StateAdress
@@ -241,6 +263,8 @@ public:
         list<ArrayInfoChange> arrayInfosToBeUpdated;	//
         list<ArrayInfo> listArrays;						// [itemIndex]
         vector<list<ArrayInfo>::iterator> vectorArrays; // [layerNumber*ArrayInfo::numArrayTypes + type]
+        long long numEvictions = 0;						// number of arrays released to stay within the memory budget
+        long long numBytesEvicted = 0;					// sum of their sizes in bytes
 
         void addArray(unsigned int layerNumber, unsigned int type, long long size, long long compressedSize);
         void removeArray(unsigned int layerNumber, unsigned int type, long long size, long long compressedSize);
@@ -284,7 +308,13 @@ public:
     bool openDatabase(const char *directory, unsigned int maximumNumberOfBranches);
     void calculateDatabase(unsigned int maxDepthOfTree, bool onlyPrepareLayer);
     bool isCurrentStateInDatabase(unsigned int threadNo);
+    bool isDatabaseCompleted();
+    bool probeDatabase(unsigned int layerNumber, unsigned int stateNumber, TwoBit &knotValue, PlyInfoVarType &plyInfo);
+    void prefetchLayer(unsigned int layerNumber);
     void closeDatabase();
+    bool compressDatabase();
+    void setMemoryBudget(long long budgetInBytes);
+    void setCheckpointInterval(unsigned int seconds);
     void unloadAllLayers();
     void unloadAllPlyInfos();
     void pauseDatabaseCalculation();
@@ -614,16 +644,18 @@ private:
 
     struct RetroAnalysisQueueState
     {
-        StateNumberVarType stateNumber;		 // state stored in the retro analysis queue. the queue is a buffer containing states to be passed to 'RetroAnalysisThreadVars::statesToProcess'
-        PlyInfoVarType numPliesTillCurState; // ply number for the stored state
+        StateNumberVarType stateNumber; // predecessor of a state taken from 'RetroAnalysisThreadVars::statesToProcess'
+        unsigned char layerId;			// layer of the predecessor within 'layersToCalculate'
+        bool isWon;						// true if the taken state is lost from the perspective of the predecessor, which is therefore won
     };
 
     struct RetroAnalysisThreadVars // thread specific variables for each thread in the retro analysis
     {
         vector<CyclicArray *> statesToProcess;				// vector-queue containing the states, whose short knot value are known for sure. they have to be processed. if processed the state will be removed from list. indexing: [threadNo][plyNumber]
-        vector<vector<RetroAnalysisQueueState>> stateQueue; // Queue containing states, whose 'count value' shall be increased by one. Before writing 'count value' to 'count array' the writing positions are sorted for faster processing.
-        long long numStatesToProcess;						// Number of states in 'statesToProcess' which have to be processed
+        vector<RetroAnalysisQueueState> stateQueue;			// Predecessors of the states taken at once from 'statesToProcess'. Before processing them they are sorted, so that the count arrays and knot values are accessed in ascending order.
+        long long numStatesToProcess;						// Number of states in 'statesToProcess' which have to be processed. changed with InterlockedIncrement64() and InterlockedDecrement64()
         unsigned int threadNo;
+        CRITICAL_SECTION csStatesToProcess;					// for taking states from 'statesToProcess', which threads without any states left do as well, and for resizing it
     };
 
     struct retroAnalysisGlobalVars // constant during calculation
@@ -635,6 +667,9 @@ private:
         long long numKnotsToCalc;				 // number of knots of all layers to be calculated
         vector<RetroAnalysisThreadVars> thread;
         unsigned int statsValueCounter[SKV_NUM_VALUES];
+        PlyInfoVarType firstPly;				 // ply number at which the iteration starts. not zero when resuming from a checkpoint
+        PlyInfoVarType checkpointPly;			 // a checkpoint is written after processing this ply number. set by thread 0
+        ULONGLONG lastCheckpointTime;			 // tick count when the last checkpoint has been written
         MiniMax *pMiniMax;
     };
 
@@ -735,6 +770,11 @@ private:
     HANDLE hFilePlyInfo = nullptr;			  // handle of the file for the ply info
     SkvFileHeader skvfHeader;				  // short knot value file header
     PlyInfoFileHeader plyInfoHeader;		  // header of the ply info file
+    MappedFile skvFileMapping;				  // read-only mapping of the short knot value file, used to probe completed layers
+    MappedFile plyInfoFileMapping;			  //  ''                   ply info file
+    atomic<const unsigned char *> *skvMappedLayer = nullptr;	 // [layerNumber] short knot values of a completed layer in skvFileMapping, nullptr if not mapped yet, &mappingFailed if it could not be mapped
+    atomic<const unsigned char *> *plyInfoMappedLayer = nullptr; // [layerNumber] ply infos of a completed layer in plyInfoFileMapping, same values as skvMappedLayer
+    static const unsigned char mappingFailed;				 // its address marks a layer, which could not be mapped, so that it is not tried again
     string fileDirectory;					  // path of the folder where the database files are located
     ostream *osPrint = nullptr;				  // stream for output. default is cout
     list<unsigned int> lastCalculatedLayer;	  //
@@ -761,8 +801,21 @@ private:
     PlyInfo *plyInfos = nullptr;			 // array of size [] containing ply information
 
     // variables concerning the compression of the database
-    // compressorClass		*	compressor						= nullptr;
-    // unsigned int			compressionAlgorithmnId			= 0;			// 0 or one of the COMPRESSOR_ALG_... constants
+    MappedFile skvCompressedFileMapping;	 // read-only mapping of the file with the compressed short knot values
+    MappedFile plyInfoCompressedFileMapping; //  ''                               ply infos
+
+    // variables concerning the memory budget of the database
+    long long memoryBudget = 0;								 // maximum size in bytes of the completed arrays kept in memory. 0 means unlimited
+    long long memoryResident = 0;							 // size in bytes of the completed arrays in memory
+    list<unsigned int> residentArrays;						 // completed arrays in memory, most recently used first. [layerNumber*ArrayInfo::numArrayTypes + type]
+    vector<list<unsigned int>::iterator> residentArrayItr;	 // [layerNumber*ArrayInfo::numArrayTypes + type] position in residentArrays or residentArrays.end()
+    vector<long long> residentArraySize;					 // [layerNumber*ArrayInfo::numArrayTypes + type] size in bytes counted in memoryResident
+    vector<bool> arrayIsPinned;								 // [layerNumber*ArrayInfo::numArrayTypes + type] arrays reachable from the current layer, which are never evicted
+    atomic<bool> *arrayIsResident = nullptr;				 // [layerNumber*ArrayInfo::numArrayTypes + type] true while in residentArrays. read without csDatabase by the probing threads
+    atomic<bool> *arrayWasUsed = nullptr;					 // [layerNumber*ArrayInfo::numArrayTypes + type] set by each read, cleared when enforceMemoryBudget() passes the array by
+
+    // variables concerning the checkpoints of the retro analysis
+    unsigned int checkpointInterval = CHECKPOINT_INTERVAL; // number of seconds between two checkpoints. 0 means no checkpoints
 
     // database I/O operations per second
     long long numReadSkvOperations = 0;	 // number of read operations done since start of the program
@@ -794,10 +847,20 @@ private:
     void readKnotValueFromDatabase(unsigned int layerNumber, unsigned int stateNumber, TwoBit &knotValue);
     void readPlyInfoFromDatabase(unsigned int layerNumber, unsigned int stateNumber, PlyInfoVarType &value);
     void saveKnotValueInDatabase(unsigned int layerNumber, unsigned int stateNumber, TwoBit knotValue);
+    bool decideKnotValueInDatabase(unsigned int layerNumber, unsigned int stateNumber, TwoBit knotValue);
     void savePlyInfoInDatabase(unsigned int layerNumber, unsigned int stateNumber, PlyInfoVarType value);
     void loadBytesFromFile(HANDLE hFile, long long offset, unsigned int numBytes, void *pBytes);
     void saveBytesToFile(HANDLE hFile, long long offset, unsigned int numBytes, void *pBytes);
     void saveLayerToFile(unsigned int layerNumber);
+    const unsigned char *mapSkvLayer(unsigned int layerNumber);
+    const unsigned char *mapPlyInfoLayer(unsigned int layerNumber);
+    bool saveCompressedFile(const char *fileName, bool plyInfo);
+    void openCompressedFile(const char *fileName, bool plyInfo);
+    void closeCompressedFiles();
+    void touchArray(unsigned int layerNumber, unsigned int type);
+    void noteArrayUsed(unsigned int layerNumber, unsigned int type);
+    void evictArray(unsigned int arrayNumber);
+    void enforceMemoryBudget();
     inline void measureIops(long long &numOperations, LARGE_INTEGER &interval, LARGE_INTEGER &curTimeBefore, char text[]);
 
     // Testing functions
@@ -849,8 +912,25 @@ private:
                                 StateAdress *pState);
     static bool retroAnalysisQueueStateComp(const RetroAnalysisQueueState &a, const RetroAnalysisQueueState &b)
     {
-        return a.stateNumber < b.stateNumber;
-    };
+        if (a.layerId != b.layerId)
+            return a.layerId < b.layerId;
+        if (a.stateNumber != b.stateNumber)
+            return a.stateNumber < b.stateNumber;
+        return a.isWon > b.isWon;
+    };
+    void prefetchRetroAnalysisState(retroAnalysisGlobalVars &retroVars, RetroAnalysisQueueState &queueState);
+    string getCheckpointFileName(unsigned int layerNumber);
+    bool saveCheckpoint(retroAnalysisGlobalVars &retroVars, PlyInfoVarType nextPly);
+    bool loadCheckpoint(retroAnalysisGlobalVars &retroVars, bool &checkpointLoaded);
+    bool restoreStatesToProcess(retroAnalysisGlobalVars &retroVars);
+    void allocateCheckpointArrays(unsigned int layerNumber);
+    void deleteCheckpoint(unsigned int layerNumber);
+    static unsigned long long calcChecksum(const void *pBytes, long long numBytes, unsigned long long checksum);
+    static unsigned long long calcHeaderChecksum(const CheckpointFileHeader &header);
+    static bool writeCheckpointBytes(HANDLE hFile, const void *pBytes, long long numBytes, unsigned long long &checksum);
+    static bool readCheckpointBytes(HANDLE hFile, void *pBytes, long long numBytes, unsigned long long &checksum);
+    unsigned int takeStatesToProcess(retroAnalysisGlobalVars &retroVars, unsigned int threadNo, unsigned int plyNumber, StateAdress *pStates, unsigned int maxNumStates);
+    static bool changeCountValue(CountArrayVarType *pCountValue, int numChange, CountArrayVarType &countValue);
     static DWORD initRetroAnalysisThreadProc(void *pParameter, unsigned int index);
     static DWORD addNumSuccedorsThreadProc(void *pParameter, unsigned int index);
     static DWORD performRetroAnalysisThreadProc(void *pParameter);
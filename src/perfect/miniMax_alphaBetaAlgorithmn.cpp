@@ -142,7 +142,7 @@ bool MiniMax::initAlphaBeta(AlphaBetaGlobalVars &alphaBetaVars)
     switch (threadManager.executeParallelLoop(initAlphaBetaThreadProc, 
                                               tva.getPointerToArray(), 
                                               tva.getSizeOfArray(), 
-                                              TM_SCHEDULE_STATIC, 
+                                              TM_SCHEDULE_DYNAMIC, 
                                               0, 
                                               layerStats[alphaBetaVars.layerNumber].knotsInLayer - 1, 
                                               1)) {
@@ -165,7 +165,11 @@ bool MiniMax::initAlphaBeta(AlphaBetaGlobalVars &alphaBetaVars)
         SAFE_DELETE(invalidArray);
         return falseOrStop();
     }
-    invalidArray->flushBuffers();
+    if (!invalidArray->flushBuffers()) {
+        PRINT(0, this, "ERROR: Could not write the initialized states to file: " << ssInvArrayFilePath.str());
+        SAFE_DELETE(invalidArray);
+        return falseOrStop();
+    }
     SAFE_DELETE(invalidArray);
 
     // when init file was created new then save it now
@@ -276,11 +280,11 @@ bool MiniMax::runAlphaBeta(AlphaBetaGlobalVars &alphaBetaVars)
     // so far no multi-threadin implemented
     threadManager.setNumThreads(1);
 
-    // process each state in the current layer
+    // process each state in the current layer. the size of the tree below a state varies a lot, so let idle threads steal states.
     switch (threadManager.executeParallelLoop(runAlphaBetaThreadProc, 
                                               tva.getPointerToArray(), 
                                               tva.getSizeOfArray(), 
-                                              TM_SCHEDULE_STATIC, 
+                                              TM_SCHEDULE_DYNAMIC, 
                                               0, 
                                               layerStats[alphaBetaVars.layerNumber].knotsInLayer - 1, 1)) {
     case TM_RETURN_VALUE_OK:
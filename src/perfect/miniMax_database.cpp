@@ -11,15 +11,29 @@
 #pragma warning(disable: 4127)
 #pragma warning(disable: 4706)
 
+const unsigned char MiniMax::mappingFailed = 0;
+
 //-----------------------------------------------------------------------------
 // ~MiniMax()
 // MiniMax class destructor
 //-----------------------------------------------------------------------------
 void MiniMax::closeDatabase()
 {
+    // release the compressed layers before the layer stats and ply infos
+    closeCompressedFiles();
+    residentArrays.clear();
+    residentArrayItr.clear();
+    residentArraySize.clear();
+    arrayIsPinned.clear();
+    SAFE_DELETE_ARRAY(arrayIsResident);
+    SAFE_DELETE_ARRAY(arrayWasUsed);
+    memoryResident = 0;
+
     // close database
     if (hFileShortKnotValues != nullptr) {
         unloadAllLayers();
+        skvFileMapping.close();
+        SAFE_DELETE_ARRAY(skvMappedLayer);
         SAFE_DELETE_ARRAY(layerStats);
         CloseHandle(hFileShortKnotValues);
         hFileShortKnotValues = nullptr;
@@ -28,6 +42,8 @@ void MiniMax::closeDatabase()
     // close ply information file
     if (hFilePlyInfo != nullptr) {
         unloadAllPlyInfos();
+        plyInfoFileMapping.close();
+        SAFE_DELETE_ARRAY(plyInfoMappedLayer);
         SAFE_DELETE_ARRAY(plyInfos);
         CloseHandle(hFilePlyInfo);
         hFilePlyInfo = nullptr;
@@ -165,6 +181,49 @@ bool MiniMax::isCurrentStateInDatabase(unsigned int threadNo)
     }
 }
 
+//-----------------------------------------------------------------------------
+// isDatabaseCompleted()
+// True if the short knot values of all layers are calculated and in the file.
+//-----------------------------------------------------------------------------
+bool MiniMax::isDatabaseCompleted()
+{
+    return hFileShortKnotValues != nullptr && skvfHeader.completed;
+}
+
+//-----------------------------------------------------------------------------
+// probeDatabase()
+// Reads the knot value of a state, if the short knot values of its layer are
+// completed and in memory. Returns false otherwise, so that a search probing
+// many states does not load whole layers. The ply info is only read for won
+// and lost states and is PLYINFO_VALUE_UNCALCULATED if it is not completed
+// or not in memory.
+//-----------------------------------------------------------------------------
+bool MiniMax::probeDatabase(unsigned int layerNumber, unsigned int stateNumber, TwoBit &knotValue, PlyInfoVarType &plyInfo)
+{
+    unsigned int arrayNumber = layerNumber * ArrayInfo::numArrayTypes;
+
+    // valid state of a completed layer ?
+    if (hFileShortKnotValues == nullptr || layerNumber >= skvfHeader.numLayers || stateNumber >= layerStats[layerNumber].knotsInLayer)
+        return false;
+    if (!skvfHeader.completed && !layerStats[layerNumber].layerIsCompletedAndInFile)
+        return false;
+
+    // are the short knot values in memory ?
+    if (arrayIsResident == nullptr || !arrayIsResident[arrayNumber + ArrayInfo::arrayType_layerStats].load(memory_order_acquire))
+        return false;
+
+    readKnotValueFromDatabase(layerNumber, stateNumber, knotValue);
+
+    plyInfo = PLYINFO_VALUE_UNCALCULATED;
+    if (knotValue != SKV_VALUE_GAME_WON && knotValue != SKV_VALUE_GAME_LOST)
+        return true;
+    if (hFilePlyInfo != nullptr && (plyInfoHeader.plyInfoCompleted || plyInfos[layerNumber].plyInfoIsCompletedAndInFile) && arrayIsResident[arrayNumber + ArrayInfo::arrayType_plyInfos].load(memory_order_acquire)) {
+        readPlyInfoFromDatabase(layerNumber, stateNumber, plyInfo);
+    }
+
+    return true;
+}
+
 //-----------------------------------------------------------------------------
 // saveHeader()
 // 
@@ -201,9 +260,227 @@ bool MiniMax::openDatabase(const char *directory, unsigned int maximumNumberOfBr
     }
     openSkvFile(directory, maximumNumberOfBranches);
     openPlyInfoFile(directory);
+
+    // probe the compressed files instead, if the database has been compressed
+    stringstream ssSkvFile, ssPlyInfoFile;
+    ssSkvFile << directory << (strlen(directory) ? "\\" : "") << "shortKnotValueCompressed.dat";
+    ssPlyInfoFile << directory << (strlen(directory) ? "\\" : "") << "plyInfoCompressed.dat";
+
+    if (hFileShortKnotValues != nullptr && skvfHeader.completed && !skvCompressedFileMapping.isOpen())
+        openCompressedFile(ssSkvFile.str().c_str(), false);
+    if (hFilePlyInfo != nullptr && plyInfoHeader.plyInfoCompleted && !plyInfoCompressedFileMapping.isOpen())
+        openCompressedFile(ssPlyInfoFile.str().c_str(), true);
+
+    // no array is in memory yet
+    if (hFileShortKnotValues != nullptr && residentArrayItr.size() != ArrayInfo::numArrayTypes * skvfHeader.numLayers) {
+        residentArrays.clear();
+        residentArrayItr.assign(ArrayInfo::numArrayTypes * skvfHeader.numLayers, residentArrays.end());
+        residentArraySize.assign(ArrayInfo::numArrayTypes * skvfHeader.numLayers, 0);
+        arrayIsPinned.assign(ArrayInfo::numArrayTypes * skvfHeader.numLayers, false);
+        SAFE_DELETE_ARRAY(arrayIsResident);
+        SAFE_DELETE_ARRAY(arrayWasUsed);
+        arrayIsResident = new atomic<bool>[residentArrayItr.size()];
+        arrayWasUsed = new atomic<bool>[residentArrayItr.size()];
+        for (size_t i = 0; i < residentArrayItr.size(); i++) {
+            arrayIsResident[i].store(false, memory_order_relaxed);
+            arrayWasUsed[i].store(false, memory_order_relaxed);
+        }
+        memoryResident = 0;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// compressDatabase()
+// Writes the short knot values and ply infos of a completely calculated
+// database into the files shortKnotValueCompressed.dat and plyInfoCompressed.dat,
+// which are then used for all read operations.
+//-----------------------------------------------------------------------------
+bool MiniMax::compressDatabase()
+{
+    // locals
+    stringstream ssSkvFile, ssPlyInfoFile;
+
+    if (hFileShortKnotValues == nullptr || !skvfHeader.completed) {
+        PRINT(0, this, "ERROR: Only a completely calculated database can be compressed!");
+        return falseOrStop();
+    }
+
+    ssSkvFile << fileDirectory << (fileDirectory.size() ? "\\" : "") << "shortKnotValueCompressed.dat";
+    ssPlyInfoFile << fileDirectory << (fileDirectory.size() ? "\\" : "") << "plyInfoCompressed.dat";
+
+    // the files can't be overwritten as long as they are mapped
+    closeCompressedFiles();
+
+    PRINT(1, this, endl << "*** Compress short knot values ***");
+    if (!saveCompressedFile(ssSkvFile.str().c_str(), false))
+        return falseOrStop();
+    openCompressedFile(ssSkvFile.str().c_str(), false);
+
+    if (hFilePlyInfo != nullptr && plyInfoHeader.plyInfoCompleted) {
+        PRINT(1, this, endl << "*** Compress ply infos ***");
+        if (!saveCompressedFile(ssPlyInfoFile.str().c_str(), true))
+            return falseOrStop();
+        openCompressedFile(ssPlyInfoFile.str().c_str(), true);
+    }
+
     return true;
 }
 
+//-----------------------------------------------------------------------------
+// saveCompressedFile()
+// Compresses all layers of the short knot value or ply info file, which must be
+// completed, and writes them into a new file.
+//-----------------------------------------------------------------------------
+bool MiniMax::saveCompressedFile(const char *fileName, bool plyInfo)
+{
+    // locals
+    HANDLE hFile;
+    CompressedFileHeader header;
+    CompressedArray compressedLayer;
+    vector<long long> imageOffset;
+    vector<unsigned char> uncompressedLayer;
+    const unsigned char *pLayer;
+    long long sizeInBytes;
+    long long totalSize = 0;
+    long long totalCompressedSize = 0;
+    unsigned int i;
+
+    hFile = CreateFileA(fileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (hFile == INVALID_HANDLE_VALUE) {
+        PRINT(0, this, "ERROR: Could not create file " << fileName << "!");
+        return false;
+    }
+
+    header.headerCode = plyInfo ? PLYINFO_COMPRESSED_HEADER_CODE : SKV_COMPRESSED_HEADER_CODE;
+    header.numLayers = plyInfo ? plyInfoHeader.numLayers : skvfHeader.numLayers;
+    imageOffset.resize(header.numLayers + 1);
+    imageOffset[0] = sizeof(CompressedFileHeader) + (header.numLayers + 1) * sizeof(long long);
+
+    for (i = 0; i < header.numLayers; i++) {
+        sizeInBytes = plyInfo ? plyInfos[i].sizeInBytes : layerStats[i].sizeInBytes;
+        imageOffset[i + 1] = imageOffset[i];
+
+        if (sizeInBytes == 0)
+            continue;
+
+        // take the layer from the mapped file, or load it if it could not be mapped
+        pLayer = plyInfo ? mapPlyInfoLayer(i) : mapSkvLayer(i);
+        if (pLayer == nullptr) {
+            uncompressedLayer.resize(sizeInBytes);
+            if (plyInfo) {
+                loadBytesFromFile(hFilePlyInfo, plyInfoHeader.headerAndPlyInfosSize + plyInfos[i].layerOffset, (unsigned int)sizeInBytes, &uncompressedLayer[0]);
+            } else {
+                loadBytesFromFile(hFileShortKnotValues, skvfHeader.headerAndStatsSize + layerStats[i].layerOffset, (unsigned int)sizeInBytes, &uncompressedLayer[0]);
+            }
+            pLayer = &uncompressedLayer[0];
+        }
+
+        compressedLayer.compress(pLayer, sizeInBytes, plyInfo ? sizeof(PlyInfoVarType) : 1);
+        saveBytesToFile(hFile, imageOffset[i], (unsigned int)compressedLayer.getImageSize(), (void *)compressedLayer.getImage());
+
+        // the block offsets of each image must be aligned
+        imageOffset[i + 1] = imageOffset[i] + (compressedLayer.getImageSize() + 7) / 8 * 8;
+        totalSize += sizeInBytes;
+        totalCompressedSize += compressedLayer.getImageSize();
+        PRINT(2, this, " layer " << i << ": " << sizeInBytes << " -> " << compressedLayer.getImageSize() << " bytes (" << 100.0 * compressedLayer.getImageSize() / sizeInBytes << "%)");
+    }
+
+    saveBytesToFile(hFile, 0, sizeof(CompressedFileHeader), &header);
+    saveBytesToFile(hFile, sizeof(CompressedFileHeader), (header.numLayers + 1) * sizeof(long long), &imageOffset[0]);
+    CloseHandle(hFile);
+
+    PRINT(1, this, " total: " << totalSize << " -> " << totalCompressedSize << " bytes (" << (totalSize ? 100.0 * totalCompressedSize / totalSize : 100.0) << "%)");
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// openCompressedFile()
+// Attaches the compressed layers of the file to the layer stats or ply infos.
+// Layers without a valid compressed image are read from the uncompressed file.
+//-----------------------------------------------------------------------------
+void MiniMax::openCompressedFile(const char *fileName, bool plyInfo)
+{
+    // locals
+    MappedFile &mapping = plyInfo ? plyInfoCompressedFileMapping : skvCompressedFileMapping;
+    unsigned int numLayers = plyInfo ? plyInfoHeader.numLayers : skvfHeader.numLayers;
+    CompressedFileHeader header;
+    CompressedArray *compressedLayer;
+    const unsigned char *pTable;
+    const unsigned char *pImage;
+    const long long *imageOffset;
+    long long sizeInBytes;
+    unsigned int i;
+
+    // database has not been compressed?
+    if (!mapping.open(fileName))
+        return;
+
+    pTable = mapping.map(0, sizeof(CompressedFileHeader) + (numLayers + 1) * sizeof(long long), MappedFile::adviceWillNeed);
+
+    if (pTable != nullptr)
+        memcpy(&header, pTable, sizeof(CompressedFileHeader));
+
+    if (pTable == nullptr || header.headerCode != (plyInfo ? PLYINFO_COMPRESSED_HEADER_CODE : SKV_COMPRESSED_HEADER_CODE) || header.numLayers != numLayers) {
+        PRINT(0, this, "ERROR: File " << fileName << " does not belong to the database!");
+        mapping.close();
+        return;
+    }
+
+    imageOffset = (const long long *)(pTable + sizeof(CompressedFileHeader));
+
+    for (i = 0; i < numLayers; i++) {
+        sizeInBytes = plyInfo ? plyInfos[i].sizeInBytes : layerStats[i].sizeInBytes;
+
+        if (imageOffset[i + 1] == imageOffset[i])
+            continue;
+
+        pImage = mapping.map(imageOffset[i], imageOffset[i + 1] - imageOffset[i], MappedFile::adviceRandom);
+        compressedLayer = new CompressedArray();
+
+        if (pImage == nullptr || !compressedLayer->attach(pImage, imageOffset[i + 1] - imageOffset[i]) || compressedLayer->getSizeInBytes() != sizeInBytes) {
+            PRINT(0, this, "ERROR: Layer " << i << " in file " << fileName << " is damaged!");
+            SAFE_DELETE(compressedLayer);
+            continue;
+        }
+
+        if (plyInfo) {
+            plyInfos[i].plyInfoCompressed = compressedLayer;
+        } else {
+            layerStats[i].skvCompressed = compressedLayer;
+        }
+    }
+
+    PRINT(2, this, "Open compressed file: " << fileName << endl);
+}
+
+//-----------------------------------------------------------------------------
+// closeCompressedFiles()
+// 
+//-----------------------------------------------------------------------------
+void MiniMax::closeCompressedFiles()
+{
+    unsigned int i;
+
+    if (layerStats != nullptr) {
+        for (i = 0; i < skvfHeader.numLayers; i++) {
+            SAFE_DELETE(layerStats[i].skvCompressed);
+        }
+    }
+
+    if (plyInfos != nullptr) {
+        for (i = 0; i < plyInfoHeader.numLayers; i++) {
+            SAFE_DELETE(plyInfos[i].plyInfoCompressed);
+        }
+    }
+
+    skvCompressedFileMapping.close();
+    plyInfoCompressedFileMapping.close();
+}
+
 //-----------------------------------------------------------------------------
 // openSkvFile()
 // 
@@ -282,6 +559,13 @@ void MiniMax::openSkvFile(const char *directory, unsigned int maximumNumberOfBra
             layerStats[i].skvCompressed = nullptr;
         }
     }
+
+    // completed layers are probed through a read-only mapping of the file
+    skvMappedLayer = new atomic<const unsigned char *>[skvfHeader.numLayers];
+    for (i = 0; i < skvfHeader.numLayers; i++) {
+        skvMappedLayer[i].store(nullptr, memory_order_relaxed);
+    }
+    skvFileMapping.open(ssDatabaseFile.str().c_str());
 }
 
 //-----------------------------------------------------------------------------
@@ -354,6 +638,13 @@ void MiniMax::openPlyInfoFile(const char *directory)
             plyInfos[i].plyInfoCompressed = nullptr;
         }
     }
+
+    // completed layers are probed through a read-only mapping of the file
+    plyInfoMappedLayer = new atomic<const unsigned char *>[plyInfoHeader.numLayers];
+    for (i = 0; i < plyInfoHeader.numLayers; i++) {
+        plyInfoMappedLayer[i].store(nullptr, memory_order_relaxed);
+    }
+    plyInfoFileMapping.open(ssFile.str().c_str());
 }
 
 //-----------------------------------------------------------------------------
@@ -383,6 +674,281 @@ void MiniMax::saveLayerToFile(unsigned int layerNumber)
     myPis->plyInfoIsCompletedAndInFile = true;
 }
 
+//-----------------------------------------------------------------------------
+// mapSkvLayer()
+// Maps the short knot values of a layer, which must be completely in the file.
+// Returns nullptr if the layer could not be mapped. Only the first call of a
+// layer takes csDatabase, later calls just read the slot.
+//-----------------------------------------------------------------------------
+const unsigned char *MiniMax::mapSkvLayer(unsigned int layerNumber)
+{
+    LayerStats *myLss = &layerStats[layerNumber];
+    const unsigned char *mappedLayer = skvMappedLayer[layerNumber].load(memory_order_acquire);
+
+    if (mappedLayer == nullptr) {
+        EnterCriticalSection(&csDatabase);
+
+        mappedLayer = skvMappedLayer[layerNumber].load(memory_order_relaxed);
+        if (mappedLayer == nullptr) {
+            // the values of a position are spread over the whole layer, so don't read ahead
+            mappedLayer = skvFileMapping.map(skvfHeader.headerAndStatsSize + myLss->layerOffset, myLss->sizeInBytes, MappedFile::adviceRandom);
+            if (mappedLayer != nullptr) {
+                PRINT(3, this, "Mapped " << myLss->sizeInBytes << " bytes of knot values of layer " << layerNumber << ".");
+                touchArray(layerNumber, ArrayInfo::arrayType_layerStats);
+            } else {
+                PRINT(1, this, "WARNING: Could not map the knot values of layer " << layerNumber << ". They are read from the file instead.");
+                mappedLayer = &mappingFailed;
+            }
+            skvMappedLayer[layerNumber].store(mappedLayer, memory_order_release);
+        }
+
+        LeaveCriticalSection(&csDatabase);
+    }
+
+    return (mappedLayer == &mappingFailed) ? nullptr : mappedLayer;
+}
+
+//-----------------------------------------------------------------------------
+// mapPlyInfoLayer()
+// Maps the ply infos of a layer, which must be completely in the file.
+// Returns nullptr if the layer could not be mapped.
+//-----------------------------------------------------------------------------
+const unsigned char *MiniMax::mapPlyInfoLayer(unsigned int layerNumber)
+{
+    PlyInfo *myPis = &plyInfos[layerNumber];
+    const unsigned char *mappedLayer = plyInfoMappedLayer[layerNumber].load(memory_order_acquire);
+
+    if (mappedLayer == nullptr) {
+        EnterCriticalSection(&csDatabase);
+
+        mappedLayer = plyInfoMappedLayer[layerNumber].load(memory_order_relaxed);
+        if (mappedLayer == nullptr) {
+            mappedLayer = plyInfoFileMapping.map(plyInfoHeader.headerAndPlyInfosSize + myPis->layerOffset, myPis->sizeInBytes, MappedFile::adviceRandom);
+            if (mappedLayer != nullptr) {
+                PRINT(3, this, "Mapped " << myPis->sizeInBytes << " bytes of ply info of layer " << layerNumber << ".");
+                touchArray(layerNumber, ArrayInfo::arrayType_plyInfos);
+            } else {
+                PRINT(1, this, "WARNING: Could not map the ply info of layer " << layerNumber << ". It is read from the file instead.");
+                mappedLayer = &mappingFailed;
+            }
+            plyInfoMappedLayer[layerNumber].store(mappedLayer, memory_order_release);
+        }
+
+        LeaveCriticalSection(&csDatabase);
+    }
+
+    return (mappedLayer == &mappingFailed) ? nullptr : mappedLayer;
+}
+
+//-----------------------------------------------------------------------------
+// prefetchLayer()
+// Lets the operating system start reading the short knot values and ply infos
+// of a completed layer and of its successor layers, since they are going to be
+// probed soon.
+// These layers are pinned in memory until the next call.
+//-----------------------------------------------------------------------------
+void MiniMax::prefetchLayer(unsigned int layerNumber)
+{
+    LayerStats *myLss = &layerStats[layerNumber];
+    const unsigned char *mappedLayer;
+    unsigned int curLayer;
+    unsigned int i;
+
+    // pin the reachable layers first, so that touching them does not evict one another
+    EnterCriticalSection(&csDatabase);
+    arrayIsPinned.assign(arrayIsPinned.size(), false);
+    for (i = 0; i <= myLss->numSuccLayers && !arrayIsPinned.empty(); i++) {
+        curLayer = (i == myLss->numSuccLayers) ? layerNumber : myLss->succLayers[i];
+        arrayIsPinned[curLayer * ArrayInfo::numArrayTypes + ArrayInfo::arrayType_layerStats] = true;
+        arrayIsPinned[curLayer * ArrayInfo::numArrayTypes + ArrayInfo::arrayType_plyInfos] = true;
+    }
+    LeaveCriticalSection(&csDatabase);
+
+    for (i = 0; i <= myLss->numSuccLayers; i++) {
+        curLayer = (i == myLss->numSuccLayers) ? layerNumber : myLss->succLayers[i];
+
+        // the search needs the ply infos to tell how far away a won or lost state is
+        if (hFilePlyInfo != nullptr && (plyInfoHeader.plyInfoCompleted || plyInfos[curLayer].plyInfoIsCompletedAndInFile)) {
+            if (plyInfos[curLayer].plyInfoCompressed != nullptr) {
+                EnterCriticalSection(&csDatabase);
+                touchArray(curLayer, ArrayInfo::arrayType_plyInfos);
+                LeaveCriticalSection(&csDatabase);
+                plyInfoCompressedFileMapping.advise(plyInfos[curLayer].plyInfoCompressed->getImage(), plyInfos[curLayer].plyInfoCompressed->getImageSize(), MappedFile::adviceWillNeed);
+            } else if ((mappedLayer = mapPlyInfoLayer(curLayer)) != nullptr) {
+                EnterCriticalSection(&csDatabase);
+                touchArray(curLayer, ArrayInfo::arrayType_plyInfos);
+                LeaveCriticalSection(&csDatabase);
+                plyInfoFileMapping.advise(mappedLayer, plyInfos[curLayer].sizeInBytes, MappedFile::adviceWillNeed);
+            }
+        }
+
+        if (!skvfHeader.completed && !layerStats[curLayer].layerIsCompletedAndInFile) {
+            continue;
+        }
+
+        // compressed layers are much smaller, so read those instead
+        if (layerStats[curLayer].skvCompressed != nullptr) {
+            EnterCriticalSection(&csDatabase);
+            touchArray(curLayer, ArrayInfo::arrayType_layerStats);
+            LeaveCriticalSection(&csDatabase);
+            skvCompressedFileMapping.advise(layerStats[curLayer].skvCompressed->getImage(), layerStats[curLayer].skvCompressed->getImageSize(), MappedFile::adviceWillNeed);
+            continue;
+        }
+
+        mappedLayer = mapSkvLayer(curLayer);
+        if (mappedLayer != nullptr) {
+            EnterCriticalSection(&csDatabase);
+            touchArray(curLayer, ArrayInfo::arrayType_layerStats);
+            LeaveCriticalSection(&csDatabase);
+            skvFileMapping.advise(mappedLayer, layerStats[curLayer].sizeInBytes, MappedFile::adviceWillNeed);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// setMemoryBudget()
+// Limits the size of the completed layers and ply infos kept in memory. The
+// least recently used ones beyond the limit are released, except the pinned
+// ones. Layers being calculated are not counted. 0 means unlimited.
+//-----------------------------------------------------------------------------
+void MiniMax::setMemoryBudget(long long budgetInBytes)
+{
+    EnterCriticalSection(&csDatabase);
+    memoryBudget = budgetInBytes;
+    enforceMemoryBudget();
+    LeaveCriticalSection(&csDatabase);
+}
+
+//-----------------------------------------------------------------------------
+// touchArray()
+// Marks a completed array as most recently used. Must be called in csDatabase.
+//-----------------------------------------------------------------------------
+void MiniMax::touchArray(unsigned int layerNumber, unsigned int type)
+{
+    unsigned int arrayNumber = layerNumber * ArrayInfo::numArrayTypes + type;
+
+    if (arrayNumber >= residentArrayItr.size())
+        return;
+
+    if (residentArrayItr[arrayNumber] != residentArrays.end()) {
+        residentArrays.splice(residentArrays.begin(), residentArrays, residentArrayItr[arrayNumber]);
+        return;
+    }
+
+    // the array is read in again, so count its size
+    if (type == ArrayInfo::arrayType_plyInfos) {
+        residentArraySize[arrayNumber] = plyInfos[layerNumber].plyInfoCompressed ? plyInfos[layerNumber].plyInfoCompressed->getImageSize() : plyInfos[layerNumber].sizeInBytes;
+    } else {
+        residentArraySize[arrayNumber] = layerStats[layerNumber].skvCompressed ? layerStats[layerNumber].skvCompressed->getImageSize() : layerStats[layerNumber].sizeInBytes;
+    }
+
+    residentArrays.push_front(arrayNumber);
+    residentArrayItr[arrayNumber] = residentArrays.begin();
+    arrayIsResident[arrayNumber].store(true, memory_order_release);
+    memoryResident += residentArraySize[arrayNumber];
+
+    enforceMemoryBudget();
+}
+
+//-----------------------------------------------------------------------------
+// evictArray()
+// Releases the pages of a completed array. Since it stays mapped, threads still
+// reading it just fault the pages in again. Must be called in csDatabase.
+//-----------------------------------------------------------------------------
+void MiniMax::evictArray(unsigned int arrayNumber)
+{
+    unsigned int layerNumber = arrayNumber / ArrayInfo::numArrayTypes;
+    unsigned int type = arrayNumber % ArrayInfo::numArrayTypes;
+    const unsigned char *mappedLayer;
+
+    if (type == ArrayInfo::arrayType_plyInfos) {
+        if (plyInfos[layerNumber].plyInfoCompressed != nullptr) {
+            plyInfoCompressedFileMapping.advise(plyInfos[layerNumber].plyInfoCompressed->getImage(), plyInfos[layerNumber].plyInfoCompressed->getImageSize(), MappedFile::adviceDontNeed);
+        }
+        mappedLayer = plyInfoMappedLayer[layerNumber].load(memory_order_relaxed);
+        if (mappedLayer != nullptr && mappedLayer != &mappingFailed) {
+            plyInfoFileMapping.advise(mappedLayer, plyInfos[layerNumber].sizeInBytes, MappedFile::adviceDontNeed);
+        }
+    } else {
+        if (layerStats[layerNumber].skvCompressed != nullptr) {
+            skvCompressedFileMapping.advise(layerStats[layerNumber].skvCompressed->getImage(), layerStats[layerNumber].skvCompressed->getImageSize(), MappedFile::adviceDontNeed);
+        }
+        mappedLayer = skvMappedLayer[layerNumber].load(memory_order_relaxed);
+        if (mappedLayer != nullptr && mappedLayer != &mappingFailed) {
+            skvFileMapping.advise(mappedLayer, layerStats[layerNumber].sizeInBytes, MappedFile::adviceDontNeed);
+        }
+    }
+
+    residentArrayItr[arrayNumber] = residentArrays.end();
+    arrayIsResident[arrayNumber].store(false, memory_order_release);
+    memoryResident -= residentArraySize[arrayNumber];
+    arrayInfos.numEvictions++;
+    arrayInfos.numBytesEvicted += residentArraySize[arrayNumber];
+
+    PRINT(3, this, "Released " << residentArraySize[arrayNumber] << " bytes of " << (type == ArrayInfo::arrayType_plyInfos ? "ply info" : "knot values") << " of layer " << layerNumber << " to stay within the memory budget.");
+}
+
+//-----------------------------------------------------------------------------
+// noteArrayUsed()
+// Called by every read of a completed array. Reads don't take csDatabase, so
+// they only mark the array as used, which enforceMemoryBudget() takes into
+// account. An evicted array is counted again, since the read faults its pages in.
+//-----------------------------------------------------------------------------
+void MiniMax::noteArrayUsed(unsigned int layerNumber, unsigned int type)
+{
+    unsigned int arrayNumber = layerNumber * ArrayInfo::numArrayTypes + type;
+
+    if (arrayIsResident == nullptr)
+        return;
+
+    // don't write the flag again and again, since all threads share it
+    if (!arrayWasUsed[arrayNumber].load(memory_order_relaxed)) {
+        arrayWasUsed[arrayNumber].store(true, memory_order_relaxed);
+    }
+
+    if (!arrayIsResident[arrayNumber].load(memory_order_acquire)) {
+        EnterCriticalSection(&csDatabase);
+        touchArray(layerNumber, type);
+        LeaveCriticalSection(&csDatabase);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// enforceMemoryBudget()
+// Evicts the least recently used arrays, which are not pinned, until the
+// budget is met. An array read since the last pass gets a second chance at
+// the front of the list instead, but only during one sweep over the list,
+// since the probing threads may mark the arrays again meanwhile.
+// Must be called in csDatabase.
+//-----------------------------------------------------------------------------
+void MiniMax::enforceMemoryBudget()
+{
+    list<unsigned int>::iterator itr = residentArrays.end();
+    list<unsigned int>::iterator curItr;
+    size_t numSecondChances = residentArrays.size();
+    unsigned int arrayNumber;
+
+    if (memoryBudget == 0)
+        return;
+
+    while (memoryResident > memoryBudget && itr != residentArrays.begin()) {
+        curItr = prev(itr);
+        arrayNumber = *curItr;
+        if (arrayIsPinned[arrayNumber]) {
+            itr = curItr;
+            continue;
+        }
+        // the flag is cleared, so the array is evicted when it comes round again
+        if (numSecondChances > 0 && arrayWasUsed[arrayNumber].exchange(false, memory_order_relaxed)) {
+            numSecondChances--;
+            residentArrays.splice(residentArrays.begin(), residentArrays, curItr);
+            continue;
+        }
+        residentArrays.erase(curItr);
+        evictArray(arrayNumber);
+    }
+}
+
 //-----------------------------------------------------------------------------
 // measureIops()
 // 
@@ -464,11 +1030,20 @@ void MiniMax::readKnotValueFromDatabase(unsigned int layerNumber, unsigned int s
         return;
     }
 
-    //  if database is complete get whole byte from file
-    if (skvfHeader.completed || layerInDatabase || myLss->layerIsCompletedAndInFile) {
-        EnterCriticalSection(&csDatabase);
-        loadBytesFromFile(hFileShortKnotValues, skvfHeader.headerAndStatsSize + myLss->layerOffset + stateNumber / 4, 1, &databaseByte);
-        LeaveCriticalSection(&csDatabase);
+    //  if database is complete get whole byte from the compressed or the mapped file, or from the file itself if it could not be mapped
+    if (myLss->skvCompressed != nullptr) {
+        noteArrayUsed(layerNumber, ArrayInfo::arrayType_layerStats);
+        databaseByte = myLss->skvCompressed->getByte(stateNumber / 4);
+    } else if (skvfHeader.completed || layerInDatabase || myLss->layerIsCompletedAndInFile) {
+        const unsigned char *mappedLayer = mapSkvLayer(layerNumber);
+        if (mappedLayer != nullptr) {
+            noteArrayUsed(layerNumber, ArrayInfo::arrayType_layerStats);
+            databaseByte = mappedLayer[stateNumber / 4];
+        } else {
+            EnterCriticalSection(&csDatabase);
+            loadBytesFromFile(hFileShortKnotValues, skvfHeader.headerAndStatsSize + myLss->layerOffset + stateNumber / 4, 1, &databaseByte);
+            LeaveCriticalSection(&csDatabase);
+        }
     } else {
 
         // is layer already loaded
@@ -532,11 +1107,20 @@ void MiniMax::readPlyInfoFromDatabase(unsigned int layerNumber, unsigned int sta
         return;
     }
 
-    // if database is complete get whole byte from file
-    if (plyInfoHeader.plyInfoCompleted || layerInDatabase || myPis->plyInfoIsCompletedAndInFile) {
-        EnterCriticalSection(&csDatabase);
-        loadBytesFromFile(hFilePlyInfo, plyInfoHeader.headerAndPlyInfosSize + myPis->layerOffset + sizeof(PlyInfoVarType) * stateNumber, sizeof(PlyInfoVarType), &value);
-        LeaveCriticalSection(&csDatabase);
+    // if database is complete get value from the compressed or the mapped file, or from the file itself if it could not be mapped
+    if (myPis->plyInfoCompressed != nullptr) {
+        noteArrayUsed(layerNumber, ArrayInfo::arrayType_plyInfos);
+        myPis->plyInfoCompressed->getBytes(sizeof(PlyInfoVarType) * stateNumber, sizeof(PlyInfoVarType), (unsigned char *)&value);
+    } else if (plyInfoHeader.plyInfoCompleted || layerInDatabase || myPis->plyInfoIsCompletedAndInFile) {
+        const unsigned char *mappedLayer = mapPlyInfoLayer(layerNumber);
+        if (mappedLayer != nullptr) {
+            noteArrayUsed(layerNumber, ArrayInfo::arrayType_plyInfos);
+            memcpy(&value, mappedLayer + sizeof(PlyInfoVarType) * stateNumber, sizeof(PlyInfoVarType));
+        } else {
+            EnterCriticalSection(&csDatabase);
+            loadBytesFromFile(hFilePlyInfo, plyInfoHeader.headerAndPlyInfosSize + myPis->layerOffset + sizeof(PlyInfoVarType) * stateNumber, sizeof(PlyInfoVarType), &value);
+            LeaveCriticalSection(&csDatabase);
+        }
     } else {
         // is layer already in memory?
         if (!myPis->plyInfoIsLoaded) {
@@ -636,6 +1220,36 @@ void MiniMax::saveKnotValueInDatabase(unsigned int layerNumber, unsigned int sta
     measureIops(numWriteSkvOperations, writeSkvInterval, curTimeBefore, (char *)"Write knot value ");
 }
 
+//-----------------------------------------------------------------------------
+// decideKnotValueInDatabase()
+// Replaces a drawn knot value of a loaded layer atomically. Returns false if
+// the state is not drawn any more, since another thread has decided it first.
+//-----------------------------------------------------------------------------
+bool MiniMax::decideKnotValueInDatabase(unsigned int layerNumber, unsigned int stateNumber, TwoBit knotValue)
+{
+    LayerStats *myLss = &layerStats[layerNumber];
+
+    // the value has been read from the loaded layer before
+    if (layerNumber > skvfHeader.numLayers || stateNumber > myLss->knotsInLayer || !myLss->layerIsLoaded) {
+        PRINT(0, this, "ERROR: INVALID layerNumber OR stateNumber OR layer not loaded in decideKnotValueInDatabase()!");
+        return false;
+    }
+
+    long *pShortKnotValue = ((long *)myLss->shortKnotValueByte) + stateNumber / ((sizeof(long) * 8) / 2);
+    long numBitsToShift = 2 * (stateNumber % ((sizeof(long) * 8) / 2)); // little-endian byte-order
+    long mask = 0x00000003 << numBitsToShift;
+    long curShortKnotValueLong, newShortKnotValueLong;
+
+    do {
+        curShortKnotValueLong = *pShortKnotValue;
+        if (((curShortKnotValueLong & mask) >> numBitsToShift & 3) != SKV_VALUE_GAME_DRAWN)
+            return false;
+        newShortKnotValueLong = (curShortKnotValueLong & (~mask)) + (knotValue << numBitsToShift);
+    } while (InterlockedCompareExchange(pShortKnotValue, newShortKnotValueLong, curShortKnotValueLong) != curShortKnotValueLong);
+
+    return true;
+}
+
 //-----------------------------------------------------------------------------
 // savePlyInfoInDatabase()
 // 
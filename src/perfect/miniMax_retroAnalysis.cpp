@@ -25,6 +25,7 @@ bool MiniMax::calcKnotValuesByRetroAnalysis(vector<unsigned int> &layersToCalc)
     unsigned int curSubLayer = 0; // Counter variable
     unsigned int plyCounter = 0;  // Counter variable
     unsigned int threadNo;
+    bool checkpointLoaded = false;
     stringstream ssLayers;
     retroAnalysisGlobalVars retroVars;
 
@@ -34,10 +35,12 @@ bool MiniMax::calcKnotValuesByRetroAnalysis(vector<unsigned int> &layersToCalc)
         retroVars.thread[threadNo].statesToProcess.resize(PLYINFO_EXP_VALUE, nullptr);
         retroVars.thread[threadNo].numStatesToProcess = 0;
         retroVars.thread[threadNo].threadNo = threadNo;
+        InitializeCriticalSection(&retroVars.thread[threadNo].csStatesToProcess);
     }
     retroVars.countArrays.resize(layersToCalc.size(), nullptr);
     retroVars.layerInitialized.resize(skvfHeader.numLayers, false);
     retroVars.layersToCalculate = layersToCalc;
+    retroVars.firstPly = 0;
     retroVars.pMiniMax = this;
 
     for (retroVars.totalNumKnots = 0, retroVars.numKnotsToCalc = 0, curLayer = 0; curLayer < layersToCalc.size(); curLayer++) {
@@ -60,23 +63,31 @@ bool MiniMax::calcKnotValuesByRetroAnalysis(vector<unsigned int> &layersToCalc)
         ssLayers << " " << layersToCalc[curLayer];
     PRINT(0, this, "*** Calculate layers" << ssLayers.str() << " by retro analysis ***");
 
-    // initialization
-    PRINT(2, this, "  Bytes in memory: " << memoryUsed2 << endl);
-    if (!initRetroAnalysis(retroVars)) {
+    // resume from the last checkpoint, if the calculation of these layers has been interrupted
+    if (!onlyPrepareLayer && !loadCheckpoint(retroVars, checkpointLoaded)) {
         abortCalculation = true;
         goto freeMem;
     }
 
-    // prepare count arrays
-    PRINT(2, this, "  Bytes in memory: " << memoryUsed2 << endl);
-    if (!prepareCountArrays(retroVars)) {
-        abortCalculation = true;
-        goto freeMem;
-    }
+    if (!checkpointLoaded) {
+        // initialization
+        PRINT(2, this, "  Bytes in memory: " << memoryUsed2 << endl);
+        if (!initRetroAnalysis(retroVars)) {
+            abortCalculation = true;
+            goto freeMem;
+        }
 
-    // stop here if only preparing layer
-    if (onlyPrepareLayer)
-        goto freeMem;
+        // prepare count arrays
+        PRINT(2, this, "  Bytes in memory: " << memoryUsed2 << endl);
+        if (!prepareCountArrays(retroVars)) {
+            abortCalculation = true;
+            goto freeMem;
+        }
+
+        // stop here if only preparing layer
+        if (onlyPrepareLayer)
+            goto freeMem;
+    }
 
     // iteration
     PRINT(2, this, "  Bytes in memory: " << memoryUsed2 << endl);
@@ -98,6 +109,7 @@ freeMem:
         for (plyCounter = 0; plyCounter < retroVars.thread[threadNo].statesToProcess.size(); plyCounter++) {
             SAFE_DELETE(retroVars.thread[threadNo].statesToProcess[plyCounter]);
         }
+        DeleteCriticalSection(&retroVars.thread[threadNo].csStatesToProcess);
     }
 
     for (curLayer = 0; curLayer < layersToCalc.size(); curLayer++) {
@@ -165,7 +177,7 @@ bool MiniMax::initRetroAnalysis(retroAnalysisGlobalVars &retroVars)
         ThreadManager::ThreadVarsArray<InitRetroAnalysisVars> tva(threadManager.getNumThreads(), (InitRetroAnalysisVars &)InitRetroAnalysisVars(this, &retroVars, layerNumber, initArray, initAlreadyDone));
 
         // process each state in the current layer
-        switch (threadManager.executeParallelLoop(initRetroAnalysisThreadProc, tva.getPointerToArray(), tva.getSizeOfArray(), TM_SCHEDULE_STATIC, 0, layerStats[layerNumber].knotsInLayer - 1, 1)) {
+        switch (threadManager.executeParallelLoop(initRetroAnalysisThreadProc, tva.getPointerToArray(), tva.getSizeOfArray(), TM_SCHEDULE_DYNAMIC, 0, layerStats[layerNumber].knotsInLayer - 1, 1)) {
         case TM_RETURN_VALUE_OK:
             break;
         case TM_RETURN_VALUE_EXECUTION_CANCELLED:
@@ -181,7 +193,11 @@ bool MiniMax::initRetroAnalysis(retroAnalysisGlobalVars &retroVars)
         // reduce and delete thread specific data
         tva.reduce();
         initAlreadyDone = false;
-        initArray->flushBuffers();
+        if (!initArray->flushBuffers()) {
+            PRINT(0, this, "ERROR: Could not write the initialized states to file: " << ssInitArrayFilePath.str());
+            SAFE_DELETE(initArray);
+            return falseOrStop();
+        }
         SAFE_DELETE(initArray);
 
         if (numStatesProcessed < layerStats[layerNumber].knotsInLayer)
@@ -390,7 +406,7 @@ bool MiniMax::calcNumSuccedors(retroAnalysisGlobalVars &retroVars)
             ThreadManager::ThreadVarsArray<AddNumSuccedorsVars> tva(threadManager.getNumThreads(), (AddNumSuccedorsVars &)AddNumSuccedorsVars(this, &retroVars, layerNumber));
 
             // process each state in the current layer
-            switch (threadManager.executeParallelLoop(addNumSuccedorsThreadProc, tva.getPointerToArray(), tva.getSizeOfArray(), TM_SCHEDULE_STATIC, 0, layerStats[layerNumber].knotsInLayer - 1, 1)) {
+            switch (threadManager.executeParallelLoop(addNumSuccedorsThreadProc, tva.getPointerToArray(), tva.getSizeOfArray(), TM_SCHEDULE_DYNAMIC, 0, layerStats[layerNumber].knotsInLayer - 1, 1)) {
             case TM_RETURN_VALUE_OK:
                 break;
             case TM_RETURN_VALUE_EXECUTION_CANCELLED:
@@ -436,7 +452,7 @@ bool MiniMax::calcNumSuccedors(retroAnalysisGlobalVars &retroVars)
             ThreadManager::ThreadVarsArray<AddNumSuccedorsVars> tva(threadManager.getNumThreads(), (AddNumSuccedorsVars &)AddNumSuccedorsVars(this, &retroVars, succState.layerNumber));
 
             // process each state in the current layer
-            switch (threadManager.executeParallelLoop(addNumSuccedorsThreadProc, tva.getPointerToArray(), tva.getSizeOfArray(), TM_SCHEDULE_STATIC, 0, layerStats[succState.layerNumber].knotsInLayer - 1, 1)) {
+            switch (threadManager.executeParallelLoop(addNumSuccedorsThreadProc, tva.getPointerToArray(), tva.getSizeOfArray(), TM_SCHEDULE_DYNAMIC, 0, layerStats[succState.layerNumber].knotsInLayer - 1, 1)) {
             case TM_RETURN_VALUE_OK:
                 break;
             case TM_RETURN_VALUE_EXECUTION_CANCELLED:
@@ -527,22 +543,10 @@ DWORD MiniMax::addNumSuccedorsThreadProc(void *pParameter, unsigned int index)
         }
 
         // add this state as possible move
-        long *pCountValue = ((long *)ansVars->retroVars->countArrays[curLayerId]) + predState.stateNumber / (sizeof(long) / sizeof(CountArrayVarType));
-        long numBitsToShift = sizeof(CountArrayVarType) * 8 * (predState.stateNumber % (sizeof(long) / sizeof(CountArrayVarType))); // little-endian byte-order
-        long mask = 0x000000ff << numBitsToShift;
-        long curCountLong, newCountLong;
-
-        do {
-            curCountLong = *pCountValue;
-            countValue = (CountArrayVarType)((curCountLong & mask) >> numBitsToShift);
-            if (countValue == 255) {
-                PRINT(0, m, "ERROR: maximum value for Count[] reached!");
-                return TM_RETURN_VALUE_TERMINATE_ALL_THREADS;
-            } else {
-                countValue++;
-                newCountLong = (curCountLong & (~mask)) + (countValue << numBitsToShift);
-            }
-        } while (InterlockedCompareExchange(pCountValue, newCountLong, curCountLong) != curCountLong);
+        if (!changeCountValue(&ansVars->retroVars->countArrays[curLayerId][predState.stateNumber], 1, countValue)) {
+            PRINT(0, m, "ERROR: maximum value for Count[] reached!");
+            return TM_RETURN_VALUE_TERMINATE_ALL_THREADS;
+        }
     }
 
     // everything is fine
@@ -563,6 +567,8 @@ bool MiniMax::performRetroAnalysis(retroAnalysisGlobalVars &retroVars)
     PRINT(2, this, "  *** Begin Iteration ***");
     numStatesProcessed = 0;
     curCalculationActionId = MM_ACTION_PERFORM_RETRO_ANAL;
+    retroVars.checkpointPly = PLYINFO_VALUE_UNCALCULATED;
+    retroVars.lastCheckpointTime = GetTickCount64();
 
     // process each state in the current layer
     switch (threadManager.executeInParallel(performRetroAnalysisThreadProc, (void **)&retroVars, 0)) {
@@ -577,12 +583,14 @@ bool MiniMax::performRetroAnalysis(retroAnalysisGlobalVars &retroVars)
         return falseOrStop();
     }
 
-    // if there are still states to process, than something went wrong
+    // if there are still states to process, than something went wrong. states may have been taken by other threads than the one which added them.
+    long long totalNumStatesToProcess = 0;
     for (unsigned int curThreadNo = 0; curThreadNo < threadManager.getNumThreads(); curThreadNo++) {
-        if (retroVars.thread[curThreadNo].numStatesToProcess) {
-            PRINT(0, this, "ERROR: There are still states to process after performing retro analysis!");
-            return falseOrStop();
-        }
+        totalNumStatesToProcess += retroVars.thread[curThreadNo].numStatesToProcess;
+    }
+    if (totalNumStatesToProcess) {
+        PRINT(0, this, "ERROR: There are still states to process after performing retro analysis!");
+        return falseOrStop();
     }
 
     // copy drawn and invalid states to ply info
@@ -606,7 +614,11 @@ bool MiniMax::performRetroAnalysis(retroAnalysisGlobalVars &retroVars)
 
 //-----------------------------------------------------------------------------
 // performRetroAnalysisThreadProc()
-// 
+// The states are taken in batches from 'statesToProcess'. The predecessors of
+// a batch are sorted by layer and state number and their values are prefetched,
+// since random access to the huge arrays is the bottleneck.
+// Each thread adds the states it decides to its own 'statesToProcess'. Threads,
+// which run out of states, take states from the other threads.
 //-----------------------------------------------------------------------------
 DWORD MiniMax::performRetroAnalysisThreadProc(void *pParameter)
 {
@@ -615,11 +627,17 @@ DWORD MiniMax::performRetroAnalysisThreadProc(void *pParameter)
     MiniMax *m = retroVars->pMiniMax;
     unsigned int threadNo = m->threadManager.getThreadNumber();
     RetroAnalysisThreadVars *threadVars = &retroVars->thread[threadNo];
+    vector<RetroAnalysisQueueState> &stateQueue = threadVars->stateQueue;
 
     TwoBit predStateValue;
     unsigned int curLayerId;   // current processed layer within 'layersToCalculate'
     unsigned int amountOfPred; // total numbers of predecessors and current considered one
     unsigned int curPred;
+    unsigned int nextPred;		  // first predecessor in 'stateQueue' differing from the current one
+    unsigned int prefetchedPred;  // first predecessor in 'stateQueue' not prefetched yet
+    unsigned int numEqualPreds;	  // number of equal entries of the current predecessor in 'stateQueue'
+    unsigned int numStatesInBatch;
+    unsigned int curStateInBatch;
     unsigned int threadCounter;
     long long numStatesProcessed;
     long long totalNumStatesToProcess;
@@ -627,23 +645,34 @@ DWORD MiniMax::performRetroAnalysisThreadProc(void *pParameter)
     PlyInfoVarType numPliesTillCurState;
     PlyInfoVarType numPliesTillPredState;
     CountArrayVarType countValue;
+    RetroAnalysisQueueState queueState;
     StateAdress predState;
     StateAdress curState; // current state counter for while-loop
     TwoBit curStateValue; // current state value
+    StateAdress statesInBatch[RETRO_ANALYSIS_BATCH_SIZE];
     RetroAnalysisPredVars predVars[MAX_NUM_PREDECESSORS];
 
-    for (numStatesProcessed = 0, curNumPlies = 0; curNumPlies < threadVars->statesToProcess.size(); curNumPlies++) {
+    stateQueue.reserve(RETRO_ANALYSIS_BATCH_SIZE * 16);
 
-        // skip empty and uninitialized cyclic arrays
-        if (threadVars->statesToProcess[curNumPlies] != nullptr) {
-            if (threadNo == 0) {
-                PRINT(0, m, "    Current number of plies: " << (unsigned int)curNumPlies << "/" << threadVars->statesToProcess.size());
-                for (threadCounter = 0; threadCounter < m->threadManager.getNumThreads(); threadCounter++) {
-                    PRINT(0, m, "      States to process for thread " << threadCounter << ": " << retroVars->thread[threadCounter].numStatesToProcess);
-                }
+    for (numStatesProcessed = 0, curNumPlies = retroVars->firstPly; curNumPlies < threadVars->statesToProcess.size(); curNumPlies++) {
+
+        if (threadNo == 0 && threadVars->statesToProcess[curNumPlies] != nullptr) {
+            PRINT(0, m, "    Current number of plies: " << (unsigned int)curNumPlies << "/" << threadVars->statesToProcess.size());
+            for (threadCounter = 0; threadCounter < m->threadManager.getNumThreads(); threadCounter++) {
+                PRINT(0, m, "      States to process for thread " << threadCounter << ": " << retroVars->thread[threadCounter].numStatesToProcess);
             }
+        }
+
+        do {
+            // collect the predecessors of a batch of states
+            stateQueue.clear();
+
+            // threads without own states take states from the other threads
+            numStatesInBatch = m->takeStatesToProcess(*retroVars, threadNo, curNumPlies, statesInBatch, RETRO_ANALYSIS_BATCH_SIZE);
+
+            for (curStateInBatch = 0; curStateInBatch < numStatesInBatch; curStateInBatch++) {
+                curState = statesInBatch[curStateInBatch];
 
-            while (threadVars->statesToProcess[curNumPlies]->takeBytes(sizeof(StateAdress), (unsigned char *)&curState)) {
                 // execution canceled by user?
                 if (m->threadManager.wasExecutionCancelled()) {
                     PRINT(0, m, "\n****************************************\nSub-thread no. " << threadNo << ": Execution cancelled by user!\n****************************************\n");
@@ -661,7 +690,6 @@ DWORD MiniMax::performRetroAnalysisThreadProc(void *pParameter)
 
                 // console output
                 numStatesProcessed++;
-                threadVars->numStatesToProcess--;
                 if (numStatesProcessed % OUTPUT_EVERY_N_STATES == 0) {
                     m->numStatesProcessed += OUTPUT_EVERY_N_STATES;
                     for (totalNumStatesToProcess = 0, threadCounter = 0; threadCounter < m->threadManager.getNumThreads(); threadCounter++) {
@@ -679,89 +707,184 @@ DWORD MiniMax::performRetroAnalysisThreadProc(void *pParameter)
                 // get list with state numbers of predecessors
                 m->getPredecessors(threadNo, &amountOfPred, predVars);
 
-                // iteration
                 for (curPred = 0; curPred < amountOfPred; curPred++) {
-                    // current predecessor
-                    predState.layerNumber = predVars[curPred].predLayerNumbers;
-                    predState.stateNumber = predVars[curPred].predStateNumbers;
-
                     // don't calculate states from layers above yet
                     for (curLayerId = 0; curLayerId < retroVars->layersToCalculate.size(); curLayerId++) {
-                        if (retroVars->layersToCalculate[curLayerId] == predState.layerNumber)
+                        if (retroVars->layersToCalculate[curLayerId] == predVars[curPred].predLayerNumbers)
                             break;
                     }
                     if (curLayerId == retroVars->layersToCalculate.size())
                         continue;
 
-                    // get value of predecessor
-                    m->readKnotValueFromDatabase(predState.layerNumber, predState.stateNumber, predStateValue);
-
-                    // only drawn states are relevant here, since the other are already calculated
-                    if (predStateValue == SKV_VALUE_GAME_DRAWN) {
-                        // if current considered state is a lost game then all predecessors are a won game
-                        if (curStateValue == m->skvPerspectiveMatrix[SKV_VALUE_GAME_LOST][predVars[curPred].playerToMoveChanged ? PL_TO_MOVE_CHANGED : PL_TO_MOVE_UNCHANGED]) {
-                            m->saveKnotValueInDatabase(predState.layerNumber, predState.stateNumber, SKV_VALUE_GAME_WON);
-                            m->savePlyInfoInDatabase(predState.layerNumber, predState.stateNumber, numPliesTillCurState + 1); // (requirement: curNumPlies == numPliesTillCurState)
-                            if (numPliesTillCurState + 1 < curNumPlies) {
-                                PRINT(0, m, "ERROR: Current number of plies is bigger than numPliesTillCurState + 1!");
-                                return TM_RETURN_VALUE_TERMINATE_ALL_THREADS;
-                            }
-                            m->addStateToProcessQueue(*retroVars, *threadVars, numPliesTillCurState + 1, &predState);
-                            // if current state is a won game, then this state is not an option any more for all predecessors
-                        } else {
-                            // reduce count value by one
-                            long *pCountValue = ((long *)retroVars->countArrays[curLayerId]) + predState.stateNumber / (sizeof(long) / sizeof(CountArrayVarType));
-                            long numBitsToShift = sizeof(CountArrayVarType) * 8 * (predState.stateNumber % (sizeof(long) / sizeof(CountArrayVarType))); // little-endian byte-order
-                            long mask = 0x000000ff << numBitsToShift;
-                            long curCountLong, newCountLong;
-
-                            do {
-                                curCountLong = *pCountValue;
-                                countValue = (CountArrayVarType)((curCountLong & mask) >> numBitsToShift);
-                                if (countValue > 0) {
-                                    countValue--;
-                                    newCountLong = (curCountLong & (~mask)) + (countValue << numBitsToShift);
-                                } else {
-                                    PRINT(0, m, "ERROR: Count is already zero!");
-                                    return TM_RETURN_VALUE_TERMINATE_ALL_THREADS;
-                                }
-                            } while (InterlockedCompareExchange(pCountValue, newCountLong, curCountLong) != curCountLong);
-
-                            // ply info (requirement: curNumPlies == numPliesTillCurState)
-                            m->readPlyInfoFromDatabase(predState.layerNumber, predState.stateNumber, numPliesTillPredState);
-                            if (numPliesTillPredState == PLYINFO_VALUE_UNCALCULATED || numPliesTillCurState + 1 > numPliesTillPredState) {
-                                m->savePlyInfoInDatabase(predState.layerNumber, predState.stateNumber, numPliesTillCurState + 1);
-                            }
-
-                            // when all successor are won states then this is a lost state (this should only be the case for one thread)
-                            if (countValue == 0) {
-                                m->saveKnotValueInDatabase(predState.layerNumber, predState.stateNumber, SKV_VALUE_GAME_LOST);
-                                if (numPliesTillCurState + 1 < curNumPlies) {
-                                    PRINT(0, m, "ERROR: Current number of plies is bigger than numPliesTillCurState + 1!");
-                                    return TM_RETURN_VALUE_TERMINATE_ALL_THREADS;
-                                }
-                                m->addStateToProcessQueue(*retroVars, *threadVars, numPliesTillCurState + 1, &predState);
-                            }
-                        }
+                    // if current considered state is a lost game then all predecessors are a won game
+                    queueState.stateNumber = predVars[curPred].predStateNumbers;
+                    queueState.layerId = (unsigned char)curLayerId;
+                    queueState.isWon = (curStateValue == m->skvPerspectiveMatrix[SKV_VALUE_GAME_LOST][predVars[curPred].playerToMoveChanged ? PL_TO_MOVE_CHANGED : PL_TO_MOVE_UNCHANGED]);
+                    stateQueue.push_back(queueState);
+                }
+            }
+
+            // won entries come first among equal predecessors
+            sort(stateQueue.begin(), stateQueue.end(), retroAnalysisQueueStateComp);
+
+            // all states of the batch have the same ply number, so the predecessors can be processed in any order
+            for (curPred = 0, prefetchedPred = 0; curPred < stateQueue.size(); curPred = nextPred) {
+
+                // prefetch the values of the following predecessors
+                for (; prefetchedPred < stateQueue.size() && prefetchedPred < curPred + RETRO_ANALYSIS_PREFETCH_DISTANCE; prefetchedPred++) {
+                    m->prefetchRetroAnalysisState(*retroVars, stateQueue[prefetchedPred]);
+                }
+
+                // equal entries are processed at once
+                for (nextPred = curPred + 1; nextPred < stateQueue.size() && !retroAnalysisQueueStateComp(stateQueue[curPred], stateQueue[nextPred]); nextPred++)
+                    ;
+                numEqualPreds = nextPred - curPred;
+
+                // current predecessor
+                curLayerId = stateQueue[curPred].layerId;
+                predState.layerNumber = retroVars->layersToCalculate[curLayerId];
+                predState.stateNumber = stateQueue[curPred].stateNumber;
+
+                // get value of predecessor
+                m->readKnotValueFromDatabase(predState.layerNumber, predState.stateNumber, predStateValue);
+
+                // only drawn states are relevant here, since the other are already calculated
+                if (predStateValue != SKV_VALUE_GAME_DRAWN)
+                    continue;
+
+                if (stateQueue[curPred].isWon) {
+                    // another thread may have decided the state meanwhile
+                    if (!m->decideKnotValueInDatabase(predState.layerNumber, predState.stateNumber, SKV_VALUE_GAME_WON))
+                        continue;
+                    m->savePlyInfoInDatabase(predState.layerNumber, predState.stateNumber, curNumPlies + 1);
+                    m->addStateToProcessQueue(*retroVars, *threadVars, curNumPlies + 1, &predState);
+
+                    // if current state is a won game, then this state is not an option any more for all predecessors
+                } else {
+                    // reduce count value by the number of equal entries
+                    if (!changeCountValue(&retroVars->countArrays[curLayerId][predState.stateNumber], -(int)numEqualPreds, countValue)) {
+                        PRINT(0, m, "ERROR: Count is already zero!");
+                        return TM_RETURN_VALUE_TERMINATE_ALL_THREADS;
+                    }
+
+                    // ply info
+                    m->readPlyInfoFromDatabase(predState.layerNumber, predState.stateNumber, numPliesTillPredState);
+                    if (numPliesTillPredState == PLYINFO_VALUE_UNCALCULATED || curNumPlies + 1 > numPliesTillPredState) {
+                        m->savePlyInfoInDatabase(predState.layerNumber, predState.stateNumber, curNumPlies + 1);
+                    }
+
+                    // when all successor are won states then this is a lost state. only the thread, which decrements the count to zero, gets here.
+                    if (countValue == 0 && m->decideKnotValueInDatabase(predState.layerNumber, predState.stateNumber, SKV_VALUE_GAME_LOST)) {
+                        m->addStateToProcessQueue(*retroVars, *threadVars, curNumPlies + 1, &predState);
                     }
                 }
             }
+        } while (numStatesInBatch > 0);
+
+        // thread 0 decides whether a checkpoint is written after this ply
+        if (threadNo == 0 && m->checkpointInterval > 0 && GetTickCount64() - retroVars->lastCheckpointTime >= 1000ull * m->checkpointInterval) {
+            retroVars->checkpointPly = curNumPlies;
         }
 
         // there might be other threads still processing states with this ply number
         m->threadManager.waitForOtherThreads(threadNo);
+
+        // the other threads wait while the checkpoint is written
+        if (retroVars->checkpointPly == curNumPlies) {
+            if (threadNo == 0) {
+                m->saveCheckpoint(*retroVars, curNumPlies + 1);
+                retroVars->lastCheckpointTime = GetTickCount64();
+            }
+            m->threadManager.waitForOtherThreads(threadNo);
+        }
     }
 
     // every thing ok
     return TM_RETURN_VALUE_OK;
 }
 
+//-----------------------------------------------------------------------------
+// prefetchRetroAnalysisState()
+// Loads the cache lines holding the count, knot value and ply info of a
+// predecessor, which is going to be processed soon.
+//-----------------------------------------------------------------------------
+void MiniMax::prefetchRetroAnalysisState(retroAnalysisGlobalVars &retroVars, RetroAnalysisQueueState &queueState)
+{
+    unsigned int layerNumber = retroVars.layersToCalculate[queueState.layerId];
+
+    _mm_prefetch((const char *)&retroVars.countArrays[queueState.layerId][queueState.stateNumber], _MM_HINT_T0);
+
+    // the arrays of the calculated layers are loaded during initialization
+    if (layerStats[layerNumber].shortKnotValueByte != nullptr) {
+        _mm_prefetch((const char *)&layerStats[layerNumber].shortKnotValueByte[queueState.stateNumber / 4], _MM_HINT_T0);
+    }
+    if (plyInfos[layerNumber].plyInfo != nullptr) {
+        _mm_prefetch((const char *)&plyInfos[layerNumber].plyInfo[queueState.stateNumber], _MM_HINT_T0);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// takeStatesToProcess()
+// Takes up to maxNumStates states with the passed ply number, first from the
+// own queue and then from the queues of the other threads. Returns the number
+// of states taken, which is zero when all queues are empty.
+//-----------------------------------------------------------------------------
+unsigned int MiniMax::takeStatesToProcess(retroAnalysisGlobalVars &retroVars, unsigned int threadNo, unsigned int plyNumber, StateAdress *pStates, unsigned int maxNumStates)
+{
+    unsigned int numThreads = threadManager.getNumThreads();
+    unsigned int numStates = 0;
+    unsigned int curThread;
+
+    for (curThread = 0; curThread < numThreads && numStates == 0; curThread++) {
+        RetroAnalysisThreadVars &shard = retroVars.thread[(threadNo + curThread) % numThreads];
+
+        // the owner may resize the vector meanwhile
+        EnterCriticalSection(&shard.csStatesToProcess);
+        if (plyNumber < shard.statesToProcess.size() && shard.statesToProcess[plyNumber] != nullptr) {
+            while (numStates < maxNumStates && shard.statesToProcess[plyNumber]->takeBytes(sizeof(StateAdress), (unsigned char *)&pStates[numStates])) {
+                InterlockedDecrement64(&shard.numStatesToProcess);
+                numStates++;
+            }
+        }
+        LeaveCriticalSection(&shard.csStatesToProcess);
+    }
+
+    return numStates;
+}
+
+//-----------------------------------------------------------------------------
+// changeCountValue()
+// Adds numChange to a count value atomically. Only the byte of the count value
+// is written, so neighbouring count values are not affected. Returns false if
+// the count value would leave the range of CountArrayVarType.
+//-----------------------------------------------------------------------------
+bool MiniMax::changeCountValue(CountArrayVarType *pCountValue, int numChange, CountArrayVarType &countValue)
+{
+    CountArrayVarType curCountValue;
+    int newCountValue;
+
+    do {
+        curCountValue = *((volatile CountArrayVarType *)pCountValue);
+        newCountValue = (int)curCountValue + numChange;
+        if (newCountValue < 0 || newCountValue > 255) {
+            countValue = curCountValue;
+            return false;
+        }
+    } while ((CountArrayVarType)_InterlockedCompareExchange8((volatile char *)pCountValue, (char)newCountValue, (char)curCountValue) != curCountValue);
+
+    countValue = (CountArrayVarType)newCountValue;
+    return true;
+}
+
 //-----------------------------------------------------------------------------
 // addStateToProcessQueue()
 // 
 //-----------------------------------------------------------------------------
 bool MiniMax::addStateToProcessQueue(retroAnalysisGlobalVars &retroVars, RetroAnalysisThreadVars &threadVars, unsigned int plyNumber, StateAdress *pState)
 {
+    // other threads may take states from this queue meanwhile
+    EnterCriticalSection(&threadVars.csStatesToProcess);
+
     // resize vector if too small
     if (plyNumber >= threadVars.statesToProcess.size()) {
         threadVars.statesToProcess.resize(max(plyNumber + 1, 10 * threadVars.statesToProcess.size()), nullptr);
@@ -782,12 +905,360 @@ bool MiniMax::addStateToProcessQueue(retroAnalysisGlobalVars &retroVars, RetroAn
 
     // add state
     if (!threadVars.statesToProcess[plyNumber]->addBytes(sizeof(StateAdress), (unsigned char *)pState)) {
+        LeaveCriticalSection(&threadVars.csStatesToProcess);
         PRINT(0, this, "ERROR: Cyclic list to small! numStatesToProcess:" << threadVars.numStatesToProcess);
         return falseOrStop();
     }
 
     // everything was fine
-    threadVars.numStatesToProcess++;
+    InterlockedIncrement64(&threadVars.numStatesToProcess);
+    LeaveCriticalSection(&threadVars.csStatesToProcess);
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// setCheckpointInterval()
+// Sets the number of seconds between two checkpoints of the retro analysis.
+// 0 means that no checkpoints are written.
+//-----------------------------------------------------------------------------
+void MiniMax::setCheckpointInterval(unsigned int seconds)
+{
+    checkpointInterval = seconds;
+}
+
+//-----------------------------------------------------------------------------
+// getCheckpointFileName()
+// The checkpoint is named after the first of the layers being calculated.
+//-----------------------------------------------------------------------------
+string MiniMax::getCheckpointFileName(unsigned int layerNumber)
+{
+    stringstream ssCheckpointFilePath;
+    ssCheckpointFilePath << fileDirectory << (fileDirectory.size() ? "\\" : "") << "checkpoint\\checkpointLayer" << layerNumber << ".dat";
+    return ssCheckpointFilePath.str();
+}
+
+//-----------------------------------------------------------------------------
+// saveCheckpoint()
+// Writes the knot values, ply infos and count arrays of the layers being
+// calculated, while all threads wait between two plies. The states to process
+// are not written, since they can be restored from the knot values and ply
+// infos. The checkpoint is written to a temporary file first, so that the
+// previous one survives a crash during writing.
+//-----------------------------------------------------------------------------
+bool MiniMax::saveCheckpoint(retroAnalysisGlobalVars &retroVars, PlyInfoVarType nextPly)
+{
+    // locals
+    HANDLE hFile;
+    CheckpointFileHeader header;
+    DWORD dwWritten;
+    LARGE_INTEGER liDistanceToMove;
+    unsigned int curLayer;
+    unsigned int layerNumber;
+    bool writingFailed = false;
+    stringstream ssCheckpointPath;
+    string fileName = getCheckpointFileName(retroVars.layersToCalculate[0]);
+    string tempFileName = fileName + ".tmp";
+
+    PRINT(2, this, "    Save checkpoint before ply " << (unsigned int)nextPly << " to file: " << fileName);
+
+    ssCheckpointPath << fileDirectory << (fileDirectory.size() ? "\\" : "") << "checkpoint";
+    CreateDirectoryA(ssCheckpointPath.str().c_str(), nullptr);
+
+    if ((hFile = CreateFileA(tempFileName.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr)) == INVALID_HANDLE_VALUE) {
+        PRINT(0, this, "WARNING: Could not create checkpoint file " << tempFileName << "!");
+        return false;
+    }
+
+    // the header is written again when the checksum is known
+    header.headerCode = CHECKPOINT_HEADER_CODE;
+    header.numLayers = (unsigned int)retroVars.layersToCalculate.size();
+    header.nextPly = nextPly;
+    header.checksum = calcHeaderChecksum(header);
+    writingFailed |= !WriteFile(hFile, &header, sizeof(header), &dwWritten, nullptr) || dwWritten != sizeof(header);
+
+    for (curLayer = 0; curLayer < retroVars.layersToCalculate.size(); curLayer++) {
+        layerNumber = retroVars.layersToCalculate[curLayer];
+        writingFailed |= !writeCheckpointBytes(hFile, &layerNumber, sizeof(layerNumber), header.checksum);
+        writingFailed |= !writeCheckpointBytes(hFile, &layerStats[layerNumber].knotsInLayer, sizeof(StateNumberVarType), header.checksum);
+    }
+
+    for (curLayer = 0; curLayer < retroVars.layersToCalculate.size() && !writingFailed; curLayer++) {
+        layerNumber = retroVars.layersToCalculate[curLayer];
+        if (!layerStats[layerNumber].knotsInLayer)
+            continue;
+        allocateCheckpointArrays(layerNumber);
+        writingFailed |= !writeCheckpointBytes(hFile, layerStats[layerNumber].shortKnotValueByte, layerStats[layerNumber].sizeInBytes, header.checksum);
+        writingFailed |= !writeCheckpointBytes(hFile, plyInfos[layerNumber].plyInfo, (long long)layerStats[layerNumber].knotsInLayer * sizeof(PlyInfoVarType), header.checksum);
+        writingFailed |= !writeCheckpointBytes(hFile, retroVars.countArrays[curLayer], (long long)layerStats[layerNumber].knotsInLayer * sizeof(CountArrayVarType), header.checksum);
+    }
+
+    // write header with checksum
+    liDistanceToMove.QuadPart = 0;
+    writingFailed |= !SetFilePointerEx(hFile, liDistanceToMove, nullptr, FILE_BEGIN);
+    writingFailed |= !WriteFile(hFile, &header, sizeof(header), &dwWritten, nullptr) || dwWritten != sizeof(header);
+    writingFailed |= !FlushFileBuffers(hFile);
+    CloseHandle(hFile);
+
+    // replace the previous checkpoint
+    if (writingFailed || !MoveFileExA(tempFileName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        PRINT(0, this, "WARNING: Could not write checkpoint file " << fileName << "!");
+        DeleteFileA(tempFileName.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// loadCheckpoint()
+// Restores the state of the retro analysis from the checkpoint of the layers
+// being calculated. checkpointLoaded is false if there is no valid checkpoint,
+// in which case the calculation starts from the beginning. Returns false if
+// the checkpoint could not be read after it has been verified.
+//-----------------------------------------------------------------------------
+bool MiniMax::loadCheckpoint(retroAnalysisGlobalVars &retroVars, bool &checkpointLoaded)
+{
+    // locals
+    HANDLE hFile;
+    CheckpointFileHeader header;
+    DWORD dwRead;
+    LARGE_INTEGER liDistanceToMove;
+    unsigned int curLayer;
+    unsigned int layerNumber;
+    unsigned int numKnotsInCurLayer;
+    unsigned int fileLayerNumber;
+    StateNumberVarType fileKnotsInLayer;
+    unsigned long long checksum;
+    bool readingFailed = false;
+    string fileName = getCheckpointFileName(retroVars.layersToCalculate[0]);
+
+    checkpointLoaded = false;
+
+    // is there a checkpoint ?
+    if ((hFile = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr)) == INVALID_HANDLE_VALUE) {
+        return true;
+    }
+
+    // does it belong to these layers ?
+    readingFailed |= !ReadFile(hFile, &header, sizeof(header), &dwRead, nullptr) || dwRead != sizeof(header);
+    readingFailed |= header.headerCode != CHECKPOINT_HEADER_CODE || header.numLayers != retroVars.layersToCalculate.size();
+    checksum = calcHeaderChecksum(header);
+
+    for (curLayer = 0; curLayer < retroVars.layersToCalculate.size() && !readingFailed; curLayer++) {
+        layerNumber = retroVars.layersToCalculate[curLayer];
+        readingFailed |= !readCheckpointBytes(hFile, &fileLayerNumber, sizeof(fileLayerNumber), checksum);
+        readingFailed |= !readCheckpointBytes(hFile, &fileKnotsInLayer, sizeof(fileKnotsInLayer), checksum);
+        readingFailed |= fileLayerNumber != layerNumber || fileKnotsInLayer != layerStats[layerNumber].knotsInLayer;
+    }
+
+    // verify the checksum before anything is changed
+    for (curLayer = 0; curLayer < retroVars.layersToCalculate.size() && !readingFailed; curLayer++) {
+        layerNumber = retroVars.layersToCalculate[curLayer];
+        numKnotsInCurLayer = layerStats[layerNumber].knotsInLayer;
+        if (!numKnotsInCurLayer)
+            continue;
+        readingFailed |= !readCheckpointBytes(hFile, nullptr, layerStats[layerNumber].sizeInBytes, checksum);
+        readingFailed |= !readCheckpointBytes(hFile, nullptr, (long long)numKnotsInCurLayer * sizeof(PlyInfoVarType), checksum);
+        readingFailed |= !readCheckpointBytes(hFile, nullptr, (long long)numKnotsInCurLayer * sizeof(CountArrayVarType), checksum);
+    }
+
+    if (readingFailed || checksum != header.checksum) {
+        PRINT(0, this, "WARNING: Checkpoint file " << fileName << " is damaged or belongs to other layers. Starting from the beginning.");
+        CloseHandle(hFile);
+        return true;
+    }
+
+    PRINT(1, this, "  *** Resume from checkpoint before ply " << header.nextPly << ": " << fileName << " ***");
+
+    // read the arrays
+    liDistanceToMove.QuadPart = sizeof(header) + retroVars.layersToCalculate.size() * (sizeof(unsigned int) + sizeof(StateNumberVarType));
+    readingFailed |= !SetFilePointerEx(hFile, liDistanceToMove, nullptr, FILE_BEGIN);
+
+    for (curLayer = 0; curLayer < retroVars.layersToCalculate.size() && !readingFailed; curLayer++) {
+        layerNumber = retroVars.layersToCalculate[curLayer];
+        numKnotsInCurLayer = layerStats[layerNumber].knotsInLayer;
+        retroVars.countArrays[curLayer] = new CountArrayVarType[numKnotsInCurLayer];
+        memoryUsed2 += numKnotsInCurLayer * sizeof(CountArrayVarType);
+        arrayInfos.addArray(layerNumber, ArrayInfo::arrayType_countArray, numKnotsInCurLayer * sizeof(CountArrayVarType), 0);
+        if (!numKnotsInCurLayer)
+            continue;
+        allocateCheckpointArrays(layerNumber);
+        readingFailed |= !readCheckpointBytes(hFile, layerStats[layerNumber].shortKnotValueByte, layerStats[layerNumber].sizeInBytes, checksum);
+        readingFailed |= !readCheckpointBytes(hFile, plyInfos[layerNumber].plyInfo, (long long)numKnotsInCurLayer * sizeof(PlyInfoVarType), checksum);
+        readingFailed |= !readCheckpointBytes(hFile, retroVars.countArrays[curLayer], (long long)numKnotsInCurLayer * sizeof(CountArrayVarType), checksum);
+    }
+
+    CloseHandle(hFile);
+
+    if (readingFailed) {
+        PRINT(0, this, "ERROR: Could not read checkpoint file " << fileName << "!");
+        return falseOrStop();
+    }
+
+    // the states to process are not part of the checkpoint
+    retroVars.firstPly = (PlyInfoVarType)header.nextPly;
+    checkpointLoaded = true;
+
+    return restoreStatesToProcess(retroVars);
+}
+
+//-----------------------------------------------------------------------------
+// restoreStatesToProcess()
+// Each won or lost state of the calculated layers and their succeeding layers
+// has been added to 'statesToProcess' with its ply info as ply number. So the
+// states not processed yet are those with a ply info not smaller than
+// 'firstPly'. They are distributed evenly over the threads.
+//-----------------------------------------------------------------------------
+bool MiniMax::restoreStatesToProcess(retroAnalysisGlobalVars &retroVars)
+{
+    // locals
+    unsigned int curLayer;
+    unsigned int curSuccLayer;
+    unsigned int numThreads = threadManager.getNumThreads();
+    long long numStatesRestored = 0;
+    StateAdress curState;
+    TwoBit curStateValue;
+    PlyInfoVarType numPlies;
+    vector<unsigned int> layersToRestore(retroVars.layersToCalculate);
+    vector<bool> layerAdded(skvfHeader.numLayers, false);
+
+    PRINT(2, this, "  *** Restore states to process ***");
+
+    // the calculated layers and their succeeding layers
+    for (curLayer = 0; curLayer < retroVars.layersToCalculate.size(); curLayer++) {
+        layerAdded[retroVars.layersToCalculate[curLayer]] = true;
+    }
+    for (curLayer = 0; curLayer < retroVars.layersToCalculate.size(); curLayer++) {
+        for (curSuccLayer = 0; curSuccLayer < layerStats[retroVars.layersToCalculate[curLayer]].numSuccLayers; curSuccLayer++) {
+            if (layerAdded[layerStats[retroVars.layersToCalculate[curLayer]].succLayers[curSuccLayer]])
+                continue;
+            layerAdded[layerStats[retroVars.layersToCalculate[curLayer]].succLayers[curSuccLayer]] = true;
+            layersToRestore.push_back(layerStats[retroVars.layersToCalculate[curLayer]].succLayers[curSuccLayer]);
+        }
+    }
+
+    for (curLayer = 0; curLayer < layersToRestore.size(); curLayer++) {
+        curState.layerNumber = layersToRestore[curLayer];
+        for (curState.stateNumber = 0; curState.stateNumber < layerStats[curState.layerNumber].knotsInLayer; curState.stateNumber++) {
+            readKnotValueFromDatabase(curState.layerNumber, curState.stateNumber, curStateValue);
+            if (curStateValue != SKV_VALUE_GAME_WON && curStateValue != SKV_VALUE_GAME_LOST)
+                continue;
+            readPlyInfoFromDatabase(curState.layerNumber, curState.stateNumber, numPlies);
+            if (numPlies == PLYINFO_VALUE_UNCALCULATED || numPlies < retroVars.firstPly)
+                continue;
+            if (!addStateToProcessQueue(retroVars, retroVars.thread[numStatesRestored % numThreads], numPlies, &curState))
+                return false;
+            numStatesRestored++;
+        }
+    }
+
+    PRINT(2, this, "    states restored: " << numStatesRestored);
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// allocateCheckpointArrays()
+// The arrays of a layer being calculated are allocated with default values by
+// the first write. Writing the default value does not change them.
+//-----------------------------------------------------------------------------
+void MiniMax::allocateCheckpointArrays(unsigned int layerNumber)
+{
+    if (!layerStats[layerNumber].layerIsLoaded)
+        saveKnotValueInDatabase(layerNumber, 0, SKV_VALUE_INVALID);
+    if (!plyInfos[layerNumber].plyInfoIsLoaded)
+        savePlyInfoInDatabase(layerNumber, 0, PLYINFO_VALUE_UNCALCULATED);
+}
+
+//-----------------------------------------------------------------------------
+// deleteCheckpoint()
+// Called when the layer has been saved completely.
+//-----------------------------------------------------------------------------
+void MiniMax::deleteCheckpoint(unsigned int layerNumber)
+{
+    DeleteFileA(getCheckpointFileName(layerNumber).c_str());
+}
+
+//-----------------------------------------------------------------------------
+// calcChecksum()
+// FNV-1a checksum of the passed bytes, continuing the passed checksum.
+//-----------------------------------------------------------------------------
+unsigned long long MiniMax::calcChecksum(const void *pBytes, long long numBytes, unsigned long long checksum)
+{
+    const unsigned char *myPointer = (const unsigned char *)pBytes;
+
+    for (long long curByte = 0; curByte < numBytes; curByte++) {
+        checksum ^= myPointer[curByte];
+        checksum *= 0x100000001B3ull;
+    }
+
+    return checksum;
+}
+
+//-----------------------------------------------------------------------------
+// calcHeaderChecksum()
+// Checksum of the header fields except the checksum itself, with which the
+// checksum of the rest of the file begins. Fields are hashed one by one, so
+// that padding bytes don't count.
+//-----------------------------------------------------------------------------
+unsigned long long MiniMax::calcHeaderChecksum(const CheckpointFileHeader &header)
+{
+    unsigned long long checksum = CHECKPOINT_CHECKSUM_BASIS;
+
+    checksum = calcChecksum(&header.headerCode, sizeof(header.headerCode), checksum);
+    checksum = calcChecksum(&header.numLayers, sizeof(header.numLayers), checksum);
+    checksum = calcChecksum(&header.nextPly, sizeof(header.nextPly), checksum);
+
+    return checksum;
+}
+
+//-----------------------------------------------------------------------------
+// writeCheckpointBytes()
+// Writes numBytes to the current file position and updates the checksum.
+//-----------------------------------------------------------------------------
+bool MiniMax::writeCheckpointBytes(HANDLE hFile, const void *pBytes, long long numBytes, unsigned long long &checksum)
+{
+    const unsigned char *myPointer = (const unsigned char *)pBytes;
+    DWORD dwBytesToWrite;
+    DWORD dwBytesWritten;
+
+    checksum = calcChecksum(pBytes, numBytes, checksum);
+
+    while (numBytes > 0) {
+        dwBytesToWrite = (DWORD)min(numBytes, (long long)FILE_BUFFER_SIZE);
+        if (!WriteFile(hFile, myPointer, dwBytesToWrite, &dwBytesWritten, nullptr) || dwBytesWritten != dwBytesToWrite)
+            return false;
+        myPointer += dwBytesWritten;
+        numBytes -= dwBytesWritten;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// readCheckpointBytes()
+// Reads numBytes from the current file position and updates the checksum. If
+// pBytes is nullptr the bytes are only used for the checksum.
+//-----------------------------------------------------------------------------
+bool MiniMax::readCheckpointBytes(HANDLE hFile, void *pBytes, long long numBytes, unsigned long long &checksum)
+{
+    vector<unsigned char> buffer(pBytes == nullptr ? FILE_BUFFER_SIZE : 0);
+    unsigned char *myPointer = (unsigned char *)pBytes;
+    DWORD dwBytesToRead;
+    DWORD dwBytesRead;
+
+    while (numBytes > 0) {
+        dwBytesToRead = (DWORD)min(numBytes, (long long)FILE_BUFFER_SIZE);
+        if (pBytes == nullptr)
+            myPointer = &buffer[0];
+        if (!ReadFile(hFile, myPointer, dwBytesToRead, &dwBytesRead, nullptr) || dwBytesRead != dwBytesToRead)
+            return false;
+        checksum = calcChecksum(myPointer, dwBytesRead, checksum);
+        if (pBytes != nullptr)
+            myPointer += dwBytesRead;
+        numBytes -= dwBytesRead;
+    }
 
     return true;
 }
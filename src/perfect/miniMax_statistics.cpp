@@ -115,6 +115,10 @@ void MiniMax::showMemoryStatus()
     cout << endl << "ullTotalPageFile       : " << memStatus.ullTotalPageFile;
     cout << endl << "ullTotalPhys           : " << memStatus.ullTotalPhys;
     cout << endl << "ullTotalVirtual        : " << memStatus.ullTotalVirtual;
+    cout << endl << "memoryBudget           : " << memoryBudget;
+    cout << endl << "memoryResident         : " << memoryResident;
+    cout << endl << "numEvictions           : " << arrayInfos.numEvictions;
+    cout << endl << "numBytesEvicted        : " << arrayInfos.numBytesEvicted;
 }
 
 //-----------------------------------------------------------------------------
@@ -158,6 +162,10 @@ void MiniMax::showLayerStats(unsigned int layerNumber)
     PRINT(1, this, " lost    states: " << statsValueCounter[SKV_VALUE_GAME_LOST]);
     PRINT(1, this, " draw    states: " << statsValueCounter[SKV_VALUE_GAME_DRAWN]);
     PRINT(1, this, " invalid states: " << statsValueCounter[SKV_VALUE_INVALID]);
+
+    if (layerStats[layerNumber].skvCompressed != nullptr && layerStats[layerNumber].sizeInBytes) {
+        PRINT(1, this, " compressed size: " << layerStats[layerNumber].skvCompressed->getImageSize() << " of " << layerStats[layerNumber].sizeInBytes << " bytes (" << 100.0 * layerStats[layerNumber].skvCompressed->getImageSize() / layerStats[layerNumber].sizeInBytes << "%)");
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -7,6 +7,9 @@
 Mill *mill = nullptr;
 PerfectAI *ai = nullptr;
 
+// true while a completed database is open for the probes of the search
+static bool probeDatabaseOpen = false;
+
 int perfect_init(void)
 {
     if (mill != nullptr || ai != nullptr) {
@@ -16,6 +19,7 @@ int perfect_init(void)
     mill = new Mill();
     ai = new PerfectAI(databaseDirectory);
     ai->setDatabasePath(databaseDirectory);
+    ai->setMemoryBudget(databaseMemoryBudget);
     mill->beginNewGame(ai, ai, fieldStruct::playerOne);
 
     return 0;
@@ -23,6 +27,8 @@ int perfect_init(void)
 
 int perfect_exit(void)
 {
+    probeDatabaseOpen = false;
+
     if (mill != nullptr) {
         delete mill;
         mill = nullptr;
@@ -107,9 +113,141 @@ void to_perfect_move(Move move, unsigned int &from, unsigned int &to)
     }
 }
 
-void to_perfect_postition(Position &pos)
+// The database stores positions from the view of the side to move
+bool to_perfect_position(Position &pos, unsigned int &layerNum, unsigned int &stateNumber)
+{
+    int board[fieldStruct::size];
+    unsigned int stoneMustBeRemoved = 0;
+    Color us = pos.side_to_move();
+
+    if (ai == nullptr) {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < fieldStruct::size; i++) {
+        Color c = pos.color_on(from_perfect_sq(i));
+
+        if (c == NOCOLOR) {
+            board[i] = fieldStruct::squareIsFree;
+        } else if (c == us) {
+            board[i] = fieldStruct::playerOne;
+        } else {
+            board[i] = fieldStruct::playerTwo;
+        }
+    }
+
+    if (pos.get_action() == Action::remove) {
+        stoneMustBeRemoved = pos.piece_to_remove_count();
+    }
+
+    ai->getLayerAndStateNumber(board, fieldStruct::playerOne, pos.get_phase() == Phase::placing, stoneMustBeRemoved, layerNum, stateNumber);
+
+    return true;
+}
+
+// Only the moving phase is probed. The states of the placing phase assume that
+// the number of placed pieces follows from the pieces on the board.
+static bool perfect_probe_rule(Position &pos)
+{
+    return rule.piecesCount == 9 &&
+        rule.flyPieceCount == 3 &&
+        !rule.hasDiagonalLines &&
+        rule.mayFly &&
+        !rule.mayRemoveMultiple &&
+        !rule.mayRemoveFromMillsAlways &&
+        rule.isLoseButNotChangeSideWhenNoWay &&
+        pos.get_phase() == Phase::moving &&
+        pos.piece_on_board_count(WHITE) >= 3 &&
+        pos.piece_on_board_count(BLACK) >= 3;
+}
+
+bool perfect_probe(Position &pos, Value &value)
+{
+    unsigned int layerNum, stateNumber;
+    MiniMax::TwoBit knotValue;
+    MiniMax::PlyInfoVarType plyInfo;
+    unsigned int nMoveRule = 0;
+
+    // the same limits as in Position::check_if_game_is_over(), 0 means none
+#ifdef RULE_50
+    if (rule.nMoveRule > 0) {
+        nMoveRule = rule.nMoveRule;
+    }
+
+    if (rule.endgameNMoveRule < rule.nMoveRule && pos.is_three_endgame()) {
+        nMoveRule = rule.endgameNMoveRule;
+    }
+#endif // RULE_50
+
+    if (!probeDatabaseOpen ||
+        !perfect_probe_rule(pos) ||
+        !to_perfect_position(pos, layerNum, stateNumber) ||
+        !ai->probeDatabase(layerNum, stateNumber, knotValue, plyInfo)) {
+        return false;
+    }
+
+    switch (knotValue) {
+    case SKV_VALUE_GAME_DRAWN:
+        value = VALUE_DRAW;
+        return true;
+    case SKV_VALUE_GAME_WON:
+    case SKV_VALUE_GAME_LOST:
+        // The database knows no N-move rule, so trust it only if the game ends in time
+        if (plyInfo >= PLYINFO_VALUE_DRAWN ||
+            (nMoveRule > 0 && pos.rule50_count() + plyInfo >= nMoveRule)) {
+            return false;
+        }
+        value = knotValue == SKV_VALUE_GAME_WON ? VALUE_MATE : -VALUE_MATE;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Opens the database for the probes of the search. Unlike openDatabase() it
+// neither waits for a missing directory nor creates missing files.
+bool perfect_probe_init(bool enabled)
+{
+    const string directory = databaseDirectory;
+
+    probeDatabaseOpen = false;
+
+    if (!enabled) {
+        return false;
+    }
+
+    if (!PathFileExistsA((directory + "\\shortKnotValue.dat").c_str()) ||
+        !PathFileExistsA((directory + "\\plyInfo.dat").c_str())) {
+        sync_cout << "No perfect database found in " << directory << sync_endl;
+        return false;
+    }
+
+    if (ai == nullptr) {
+        perfect_init();
+    }
+
+    if (!ai->openDatabase(databaseDirectory, MAX_NUM_POS_MOVES) ||
+        !ai->isDatabaseCompleted()) {
+        sync_cout << "The perfect database in " << directory << " is not completed" << sync_endl;
+        return false;
+    }
+
+    probeDatabaseOpen = true;
+
+    return true;
+}
+
+void perfect_prefetch(Position &pos)
 {
+    unsigned int layerNum, stateNumber;
 
+    if (!probeDatabaseOpen || !perfect_probe_rule(pos)) {
+        return;
+    }
+
+    if (to_perfect_position(pos, layerNum, stateNumber)) {
+        ai->prefetchLayer(layerNum);
+    }
 }
 
 Move perfect_search()
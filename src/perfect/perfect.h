@@ -5,7 +5,11 @@
 #include "perfectAI.h"
 #include "types.h"
 
+class Position;
+
 static const char databaseDirectory[] = "D:\\Muehle\\Muehle";
+static const long long databaseMemoryBudget = 0; // maximum size in bytes of the database layers kept in memory, 0 for unlimited
+static const unsigned int databaseCheckpointInterval = 1800; // seconds between two checkpoints while calculating the database, 0 for none
 
 extern Mill *mill;
 extern PerfectAI *ai;
@@ -18,6 +22,10 @@ Square from_perfect_sq(unsigned int sq);
 Move from_perfect_move(unsigned int from, unsigned int to);
 unsigned to_perfect_sq(Square sq);
 void to_perfect_move(Move move, unsigned int &from, unsigned int &to);
+bool to_perfect_position(Position &pos, unsigned int &layerNum, unsigned int &stateNumber);
+bool perfect_probe_init(bool enabled);
+bool perfect_probe(Position &pos, Value &value);
+void perfect_prefetch(Position &pos);
 Move perfect_search();
 bool perfect_do_move(Move move);
 bool perfect_command(const char *cmd);
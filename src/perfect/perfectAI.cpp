@@ -795,6 +795,11 @@ bool PerfectAI::testLayers(unsigned int startTestFromLayer, unsigned int endTest
     unsigned int curLayer;
     bool result = true;
 
+    if (!CompressedArray::test()) {
+        cout << "ERROR: Compressed arrays are not restored correctly!" << endl;
+        result = false;
+    }
+
     for (curLayer = startTestFromLayer; curLayer <= endTestAtLayer; curLayer++) {
         closeDatabase();
         if (!openDatabase(databaseDirectory.c_str(), MAX_NUM_POS_MOVES))
@@ -1600,25 +1605,33 @@ unsigned int PerfectAI::getLayerAndStateNumber(unsigned int threadNo, unsigned i
 // Current player has white stones, the opponent the black ones.
 //-----------------------------------------------------------------------------
 unsigned int PerfectAI::ThreadVars::getLayerAndStateNumber(unsigned int &layerNum, unsigned int &stateNumber)
+{
+    return parent->calcLayerAndStateNumber(field->board, field->curPlayer->id, field->curPlayer->numStones, field->oppPlayer->numStones, field->settingPhase, field->stoneMustBeRemoved, layerNum, stateNumber);
+}
+
+//-----------------------------------------------------------------------------
+// calcLayerAndStateNumber()
+// Current player has white stones, the opponent the black ones.
+// Only reads the precalculated tables, so it can be called by any thread.
+//-----------------------------------------------------------------------------
+unsigned int PerfectAI::calcLayerAndStateNumber(const int *board, int curPlayerId, unsigned int numWhiteStones, unsigned int numBlackStones, bool settingPhase, unsigned int stoneMustBeRemoved, unsigned int &layerNum, unsigned int &stateNumber)
 {
     // locals
     unsigned int myField[fieldStruct::size];
     unsigned int symField[fieldStruct::size];
-    unsigned int numBlackStones = field->oppPlayer->numStones;
-    unsigned int numWhiteStones = field->curPlayer->numStones;
-    unsigned int phaseIndex = (field->settingPhase == true) ? LAYER_INDEX_SETTING_PHASE : LAYER_INDEX_MOVING_PHASE;
+    unsigned int phaseIndex = (settingPhase == true) ? LAYER_INDEX_SETTING_PHASE : LAYER_INDEX_MOVING_PHASE;
     unsigned int wCD = 0, bCD = 0;
     unsigned int stateAB, stateCD;
     unsigned int i;
 
     // layer number
-    layerNum = parent->layerIndex[phaseIndex][numWhiteStones][numBlackStones];
+    layerNum = layerIndex[phaseIndex][numWhiteStones][numBlackStones];
 
     // make white and black fields
     for (i = 0; i < fieldStruct::size; i++) {
-        if (field->board[i] == fieldStruct::squareIsFree) {
+        if (board[i] == fieldStruct::squareIsFree) {
             myField[i] = FREE_SQUARE;
-        } else if (field->board[i] == field->curPlayer->id) {
+        } else if (board[i] == curPlayerId) {
             myField[i] = WHITE_STONE;
             if (fieldPosIsOfGroup[i] == GROUP_C)
                 wCD++;
@@ -1634,18 +1647,18 @@ unsigned int PerfectAI::ThreadVars::getLayerAndStateNumber(unsigned int &layerNu
     }
 
     // calc stateCD
-    stateCD = myField[squareIndexGroupC[0]] * parent->powerOfThree[15] + myField[squareIndexGroupC[1]] * parent->powerOfThree[14] + myField[squareIndexGroupC[2]] * parent->powerOfThree[13] + myField[squareIndexGroupC[3]] * parent->powerOfThree[12] + myField[squareIndexGroupC[4]] * parent->powerOfThree[11] + myField[squareIndexGroupC[5]] * parent->powerOfThree[10] + myField[squareIndexGroupC[6]] * parent->powerOfThree[9] + myField[squareIndexGroupC[7]] * parent->powerOfThree[8] + myField[squareIndexGroupD[0]] * parent->powerOfThree[7] + myField[squareIndexGroupD[1]] * parent->powerOfThree[6] + myField[squareIndexGroupD[2]] * parent->powerOfThree[5] + myField[squareIndexGroupD[3]] * parent->powerOfThree[4] + myField[squareIndexGroupD[4]] * parent->powerOfThree[3] + myField[squareIndexGroupD[5]] * parent->powerOfThree[2] + myField[squareIndexGroupD[6]] * parent->powerOfThree[1] + myField[squareIndexGroupD[7]] * parent->powerOfThree[0];
+    stateCD = myField[squareIndexGroupC[0]] * powerOfThree[15] + myField[squareIndexGroupC[1]] * powerOfThree[14] + myField[squareIndexGroupC[2]] * powerOfThree[13] + myField[squareIndexGroupC[3]] * powerOfThree[12] + myField[squareIndexGroupC[4]] * powerOfThree[11] + myField[squareIndexGroupC[5]] * powerOfThree[10] + myField[squareIndexGroupC[6]] * powerOfThree[9] + myField[squareIndexGroupC[7]] * powerOfThree[8] + myField[squareIndexGroupD[0]] * powerOfThree[7] + myField[squareIndexGroupD[1]] * powerOfThree[6] + myField[squareIndexGroupD[2]] * powerOfThree[5] + myField[squareIndexGroupD[3]] * powerOfThree[4] + myField[squareIndexGroupD[4]] * powerOfThree[3] + myField[squareIndexGroupD[5]] * powerOfThree[2] + myField[squareIndexGroupD[6]] * powerOfThree[1] + myField[squareIndexGroupD[7]] * powerOfThree[0];
 
     // apply symmetry operation on group A&B
-    parent->applySymmetrieOperationOnField(parent->symmetryOperationCD[stateCD], myField, symField);
+    applySymmetrieOperationOnField(symmetryOperationCD[stateCD], myField, symField);
 
     // calc stateAB
-    stateAB = symField[squareIndexGroupA[0]] * parent->powerOfThree[7] + symField[squareIndexGroupA[1]] * parent->powerOfThree[6] + symField[squareIndexGroupA[2]] * parent->powerOfThree[5] + symField[squareIndexGroupA[3]] * parent->powerOfThree[4] + symField[squareIndexGroupB[0]] * parent->powerOfThree[3] + symField[squareIndexGroupB[1]] * parent->powerOfThree[2] + symField[squareIndexGroupB[2]] * parent->powerOfThree[1] + symField[squareIndexGroupB[3]] * parent->powerOfThree[0];
+    stateAB = symField[squareIndexGroupA[0]] * powerOfThree[7] + symField[squareIndexGroupA[1]] * powerOfThree[6] + symField[squareIndexGroupA[2]] * powerOfThree[5] + symField[squareIndexGroupA[3]] * powerOfThree[4] + symField[squareIndexGroupB[0]] * powerOfThree[3] + symField[squareIndexGroupB[1]] * powerOfThree[2] + symField[squareIndexGroupB[2]] * powerOfThree[1] + symField[squareIndexGroupB[3]] * powerOfThree[0];
 
     // calc index
-    stateNumber = parent->layer[layerNum].subLayer[parent->layer[layerNum].subLayerIndexCD[wCD][bCD]].minIndex * MAX_NUM_STONES_REMOVED_MINUS_1 + parent->indexAB[stateAB] * parent->anzahlStellungenCD[wCD][bCD] * MAX_NUM_STONES_REMOVED_MINUS_1 + parent->indexCD[stateCD] * MAX_NUM_STONES_REMOVED_MINUS_1 + field->stoneMustBeRemoved;
+    stateNumber = layer[layerNum].subLayer[layer[layerNum].subLayerIndexCD[wCD][bCD]].minIndex * MAX_NUM_STONES_REMOVED_MINUS_1 + indexAB[stateAB] * anzahlStellungenCD[wCD][bCD] * MAX_NUM_STONES_REMOVED_MINUS_1 + indexCD[stateCD] * MAX_NUM_STONES_REMOVED_MINUS_1 + stoneMustBeRemoved;
 
-    return parent->symmetryOperationCD[stateCD];
+    return symmetryOperationCD[stateCD];
 }
 
 //-----------------------------------------------------------------------------
@@ -1928,6 +1941,25 @@ void PerfectAI::getLayerAndStateNumber(unsigned int &layerNum, unsigned int &sta
     /*symmetryOperation = */ threadVars[0].getLayerAndStateNumber(layerNum, stateNumber);
 }
 
+//-----------------------------------------------------------------------------
+// getLayerAndStateNumber()
+// Board given by the caller, containing curPlayerId for the stones of the
+// player to move. Needs no thread vars, so the search can probe the database.
+//-----------------------------------------------------------------------------
+void PerfectAI::getLayerAndStateNumber(const int *board, int curPlayerId, bool settingPhase, unsigned int stoneMustBeRemoved, unsigned int &layerNum, unsigned int &stateNumber)
+{
+    unsigned int numWhiteStones = 0, numBlackStones = 0;
+
+    for (unsigned int i = 0; i < fieldStruct::size; i++) {
+        if (board[i] == curPlayerId)
+            numWhiteStones++;
+        else if (board[i] != fieldStruct::squareIsFree)
+            numBlackStones++;
+    }
+
+    calcLayerAndStateNumber(board, curPlayerId, numWhiteStones, numBlackStones, settingPhase, stoneMustBeRemoved, layerNum, stateNumber);
+}
+
 //-----------------------------------------------------------------------------
 // setOpponentLevel()
 // 
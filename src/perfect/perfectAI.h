@@ -201,6 +201,7 @@ protected:
     bool setSituation(unsigned int threadNo, unsigned int layerNum, unsigned int stateNumber);
     unsigned int getLayerNumber(unsigned int threadNo);
     unsigned int getLayerAndStateNumber(unsigned int threadNo, unsigned int &layerNum, unsigned int &stateNumber);
+    unsigned int calcLayerAndStateNumber(const int *board, int curPlayerId, unsigned int numWhiteStones, unsigned int numBlackStones, bool settingPhase, unsigned int stoneMustBeRemoved, unsigned int &layerNum, unsigned int &stateNumber);
 
     // integrity test functions
     bool checkMoveAndSetSituation();
@@ -236,6 +237,7 @@ public:
     void getValueOfMoves(unsigned char *moveValue, unsigned int *freqValuesSubMoves, PlyInfoVarType *plyInfo, unsigned int *moveQuality, unsigned char &knotValue, PlyInfoVarType &bestAmountOfPlies);
     void getField(unsigned int layerNum, unsigned int stateNumber, fieldStruct *field, bool *gameHasFinished);
     void getLayerAndStateNumber(unsigned int &layerNum, unsigned int &stateNumber);
+    void getLayerAndStateNumber(const int *board, int curPlayerId, bool settingPhase, unsigned int stoneMustBeRemoved, unsigned int &layerNum, unsigned int &stateNumber);
 
     // Testing functions
     bool testLayers(unsigned int startTestFromLayer, unsigned int endTestAtLayer);
@@ -55,6 +55,7 @@ int perfect_main(void)
 
     if (calculateDatabase) {
         // calculate
+        ai->setCheckpointInterval(databaseCheckpointInterval);
         ai->calculateDatabase(MAX_DEPTH_OF_TREE, false);
 
         // test database
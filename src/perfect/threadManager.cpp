@@ -6,6 +6,8 @@
     https://github.com/madweasel/Muehle
 \*********************************************************************/
 
+#include <cassert>
+
 #include "threadManager.h"
 
 //-----------------------------------------------------------------------------
@@ -14,30 +16,20 @@
 //-----------------------------------------------------------------------------
 ThreadManager::ThreadManager()
 {
-    // locals
-    unsigned int curThreadNo;
-    SYSTEM_INFO m_si = { 0 };
-
-    GetSystemInfo(&m_si);
-
     // init default values
     executionPaused = false;
     executionCancelled = false;
-    numThreads = m_si.dwNumberOfProcessors;
-    hThread = new HANDLE[numThreads];
-    threadId = new DWORD[numThreads];
-    hBarrier = new HANDLE[numThreads];
+    numThreads = thread::hardware_concurrency();
+    if (numThreads == 0)
+        numThreads = 1;
+    hThread.resize(numThreads);
+    threadId.resize(numThreads);
+    workQueues = nullptr;
+    nextIteration = 0;
     numThreadsPassedBarrier = 0;
+    numThreadsAtBarrier = numThreads;
+    barrierGeneration = 0;
     termineAllThreads = false;
-
-    InitializeCriticalSection(&csBarrier);
-    hEventBarrierPassedByEveryBody = CreateEvent(nullptr, true, false, nullptr);
-
-    for (curThreadNo = 0; curThreadNo < numThreads; curThreadNo++) {
-        hThread[curThreadNo] = nullptr;
-        threadId[curThreadNo] = 0;
-        hBarrier[curThreadNo] = CreateEvent(nullptr, false, false, nullptr);
-    }
 }
 
 //-----------------------------------------------------------------------------
@@ -46,27 +38,7 @@ ThreadManager::ThreadManager()
 //-----------------------------------------------------------------------------
 ThreadManager::~ThreadManager()
 {
-    // locals
-    unsigned int curThreadNo;
-
-    for (curThreadNo = 0; curThreadNo < numThreads; curThreadNo++) {
-        CloseHandle(hBarrier[curThreadNo]);
-    }
-
-    DeleteCriticalSection(&csBarrier);
-    CloseHandle(hEventBarrierPassedByEveryBody);
-
-    if (hBarrier != nullptr)
-        delete[] hBarrier;
-    hBarrier = nullptr;
-
-    if (hThread != nullptr)
-        delete[] hThread;
-    hThread = nullptr;
-
-    if (threadId != nullptr)
-        delete[] threadId;
-    threadId = nullptr;
+    joinAllThreads();
 }
 
 //-----------------------------------------------------------------------------
@@ -75,42 +47,28 @@ ThreadManager::~ThreadManager()
 //-----------------------------------------------------------------------------
 void ThreadManager::waitForOtherThreads(unsigned int threadNo)
 {
-    // wait if other threads are still waiting at the barrier
-    //cout << endl << "thread=" << threadNo << ", numThreadsPassedBarrier= " << numThreadsPassedBarrier << ": " << "while (numThreadsPassedBarrier>0)";
-    if (numThreadsPassedBarrier > 0) {
-        WaitForSingleObject(hEventBarrierPassedByEveryBody, INFINITE);
-    }
-
-    // a simple while (numThreadsPassedBarrier>0) {}; does not work, since the variable 'numThreadsPassedBarrier' is not updated, due to compiler optimizations
+    unique_lock<mutex> lock(csBarrier);
+    unsigned int myGeneration = barrierGeneration;
 
-    // set signal that barrier is reached
-    //cout << endl << "thread=" << threadNo << ", numThreadsPassedBarrier= " << numThreadsPassedBarrier << ": " << "SetEvent()";
-    SetEvent(hBarrier[threadNo]);
+    // only the threads started by executeInParallel() count at the barrier
+    assert(threadNo < numThreadsAtBarrier);
+    (void)threadNo;
 
-    // enter the barrier one by one
-    //cout << endl << "thread=" << threadNo << ", numThreadsPassedBarrier= " << numThreadsPassedBarrier << ": " << "EnterCriticalSection()";
-    EnterCriticalSection(&csBarrier);
-
-    // if the first one which entered, then wait until other threads
-    if (numThreadsPassedBarrier == 0) {
-        //cout << endl << "thread=" << threadNo << ", numThreadsPassedBarrier= " << numThreadsPassedBarrier << ": " << "WaitForMultipleObjects()";
-        WaitForMultipleObjects(numThreads, hBarrier, TRUE, INFINITE);
-        ResetEvent(hEventBarrierPassedByEveryBody);
-    }
-
-    // count threads which passed the barrier
-    //cout << endl << "thread=" << threadNo << ", numThreadsPassedBarrier= " << numThreadsPassedBarrier << ": " << "numThreadsPassedBarrier++";
+    // the last one opens the door for everybody
     numThreadsPassedBarrier++;
 
-    // the last one closes the door
-    //cout << endl << "thread=" << threadNo << ", numThreadsPassedBarrier= " << numThreadsPassedBarrier << ": " << "if (numThreadsPassedBarrier == numThreads) numThreadsPassedBarrier = 0";
-    if (numThreadsPassedBarrier == numThreads) {
+    if (numThreadsPassedBarrier == numThreadsAtBarrier) {
         numThreadsPassedBarrier = 0;
-        SetEvent(hEventBarrierPassedByEveryBody);
+        barrierGeneration++;
+        condBarrier.notify_all();
+    } else {
+        condBarrier.wait(lock, [&] { return barrierGeneration != myGeneration; });
     }
 
-    //cout << endl << "thread=" << threadNo << ", numThreadsPassedBarrier= " << numThreadsPassedBarrier << ": " << "LeaveCriticalSection()";
-    LeaveCriticalSection(&csBarrier);
+    lock.unlock();
+
+    // a paused execution goes on here at the latest, even where threads cannot be suspended
+    waitWhilePaused();
 }
 
 //-----------------------------------------------------------------------------
@@ -129,47 +87,86 @@ unsigned int ThreadManager::getNumThreads()
 bool ThreadManager::setNumThreads(unsigned int newNumThreads)
 {
     // cancel if any thread running
-    EnterCriticalSection(&csBarrier);
+    lock_guard<mutex> lock(csBarrier);
 
     for (unsigned int curThreadNo = 0; curThreadNo < numThreads; curThreadNo++) {
-        if (hThread[curThreadNo]) {
-            LeaveCriticalSection(&csBarrier);
+        if (hThread[curThreadNo].joinable()) {
             return false;
         }
     }
 
-    for (unsigned int curThreadNo = 0; curThreadNo < numThreads; curThreadNo++) {
-        CloseHandle(hBarrier[curThreadNo]);
-    }
-
     numThreads = newNumThreads;
-
-    for (unsigned int curThreadNo = 0; curThreadNo < numThreads; curThreadNo++) {
-        hBarrier[curThreadNo] = CreateEvent(nullptr, false, false, nullptr);
-    }
-
-    LeaveCriticalSection(&csBarrier);
+    hThread.resize(numThreads);
+    threadId.resize(numThreads);
 
     return true;
 }
 
 //-----------------------------------------------------------------------------
 // pauseExecution()
-// 
+// On Windows the threads are suspended at once. Elsewhere they stop before
+// the next iteration of executeParallelLoop() or at the next barrier.
 //-----------------------------------------------------------------------------
 void ThreadManager::pauseExecution()
 {
+#ifdef _WIN32
     for (unsigned int curThread = 0; curThread < numThreads; curThread++) {
+        if (!hThread[curThread].joinable())
+            continue;
         // unsuspend all threads
         if (!executionPaused) {
-            SuspendThread(hThread[curThread]);
+            SuspendThread(hThread[curThread].native_handle());
             // suspend all threads
         } else {
-            ResumeThread(hThread[curThread]);
+            ResumeThread(hThread[curThread].native_handle());
         }
     }
+#endif
 
+    lock_guard<mutex> lock(csPause);
     executionPaused = (!executionPaused);
+    condPause.notify_all();
+}
+
+//-----------------------------------------------------------------------------
+// waitWhilePaused()
+// 
+//-----------------------------------------------------------------------------
+void ThreadManager::waitWhilePaused()
+{
+#ifndef _WIN32
+    if (executionPaused) {
+        unique_lock<mutex> lock(csPause);
+        condPause.wait(lock, [&] { return !executionPaused; });
+    }
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// setThreadPriorityBelowNormal()
+// 
+//-----------------------------------------------------------------------------
+void ThreadManager::setThreadPriorityBelowNormal(thread &t)
+{
+#ifdef _WIN32
+    SetThreadPriority(t.native_handle(), THREAD_PRIORITY_BELOW_NORMAL);
+#else
+    (void)t;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// joinAllThreads()
+// 
+//-----------------------------------------------------------------------------
+void ThreadManager::joinAllThreads()
+{
+    for (unsigned int curThreadNo = 0; curThreadNo < numThreads; curThreadNo++) {
+        if (hThread[curThreadNo].joinable()) {
+            hThread[curThreadNo].join();
+        }
+        threadId[curThreadNo] = thread::id();
+    }
 }
 
 //-----------------------------------------------------------------------------
@@ -212,7 +209,7 @@ bool ThreadManager::wasExecutionCancelled()
 unsigned int ThreadManager::getThreadNumber()
 {
     // locals
-    DWORD curThreadId = GetCurrentThreadId();
+    thread::id curThreadId = this_thread::get_id();
     unsigned int curThreadNo;
 
     for (curThreadNo = 0; curThreadNo < numThreads; curThreadNo++) {
@@ -232,7 +229,6 @@ unsigned int ThreadManager::executeInParallel(DWORD threadProc(void *pParameter)
 {
     // locals
     unsigned int curThreadNo;
-    SIZE_T dwStackSize = 0;
 
     // parameters ok?
     if (pParameter == nullptr)
@@ -241,38 +237,38 @@ unsigned int ThreadManager::executeInParallel(DWORD threadProc(void *pParameter)
     // globals
     termineAllThreads = false;
 
-    // create threads
-    for (curThreadNo = 0; curThreadNo < numThreads; curThreadNo++) {
-
-        hThread[curThreadNo] = CreateThread(nullptr, dwStackSize, (LPTHREAD_START_ROUTINE)threadProc, (void *)(((char *)pParameter) + curThreadNo * parameterStructSize), CREATE_SUSPENDED, &threadId[curThreadNo]);
-        
-        if (hThread[curThreadNo] != nullptr) {
-            SetThreadPriority(hThread[curThreadNo], THREAD_PRIORITY_BELOW_NORMAL);
-        }
-
-        if (hThread[curThreadNo] == nullptr) {
-            for (curThreadNo; curThreadNo > 0; curThreadNo--) {
-                CloseHandle(hThread[curThreadNo - 1]);
-                hThread[curThreadNo - 1] = nullptr;
+    // create threads. getThreadNumber() must know all of them before the first one starts working.
+    {
+        lock_guard<mutex> lock(csBarrier);
+
+        for (curThreadNo = 0; curThreadNo < numThreads; curThreadNo++) {
+            try {
+                hThread[curThreadNo] = thread([=] {
+                    { lock_guard<mutex> startLock(csBarrier); }
+                    waitWhilePaused();
+                    threadProc((void *)(((char *)pParameter) + curThreadNo * parameterStructSize));
+                });
+            } catch (const system_error &) {
+                termineAllThreads = true;
+                break;
             }
-            return TM_RETURN_VALUE_UNEXPECTED_ERROR;
+            threadId[curThreadNo] = hThread[curThreadNo].get_id();
+            setThreadPriorityBelowNormal(hThread[curThreadNo]);
+#ifdef _WIN32
+            if (executionPaused)
+                SuspendThread(hThread[curThreadNo].native_handle());
+#endif
         }
-    }
 
-    // start threads
-    for (curThreadNo = 0; curThreadNo < numThreads; curThreadNo++) {
-        if (!executionPaused)
-            ResumeThread(hThread[curThreadNo]);
+        // the threads started so far must not wait at the barrier for the missing ones
+        numThreadsAtBarrier = curThreadNo;
     }
 
     // wait for every thread to end
-    WaitForMultipleObjects(numThreads, hThread, TRUE, INFINITE);
+    joinAllThreads();
 
-    // Close all thread handles upon completion.
-    for (curThreadNo = 0; curThreadNo < numThreads; curThreadNo++) {
-        CloseHandle(hThread[curThreadNo]);
-        hThread[curThreadNo] = nullptr;
-        threadId[curThreadNo] = 0;
+    if (curThreadNo < numThreads) {
+        return TM_RETURN_VALUE_UNEXPECTED_ERROR;
     }
 
     // everything ok
@@ -288,6 +284,14 @@ unsigned int ThreadManager::executeInParallel(DWORD threadProc(void *pParameter)
 // 
 // lpParameter - an array of size numThreads
 // finalValue  - this value is part of the iteration, meaning that index ranges from initialValue to finalValue including both border values
+//
+// TM_SCHEDULE_STATIC  - each thread processes one contiguous block of iterations
+// TM_SCHEDULE_DYNAMIC - each thread starts on such a block, but takes only
+//                       TM_DYNAMIC_CHUNK_SIZE iterations at a time. A thread
+//                       which has run out of work steals the second half of
+//                       the remaining iterations of another thread.
+// TM_SCHEDULE_GUIDED  - the threads take chunks of decreasing size from a
+//                       shared counter
 //-----------------------------------------------------------------------------
 unsigned int ThreadManager::executeParallelLoop(DWORD threadProc(void *pParameter, unsigned index),
                                                 void *pParameter,
@@ -307,6 +311,9 @@ unsigned int ThreadManager::executeParallelLoop(DWORD threadProc(void *pParamete
     if (scheduleType >= TM_SCHEDULE_NUM_TYPES)
         return TM_RETURN_VALUE_INVALID_PARAM;
 
+    if (scheduleType == TM_SCHEDULE_USER_DEFINED || scheduleType == TM_SCHEDULE_RUNTIME)
+        return TM_RETURN_VALUE_INVALID_PARAM;
+
     if (inkrement == 0)
         return TM_RETURN_VALUE_INVALID_PARAM;
 
@@ -317,77 +324,72 @@ unsigned int ThreadManager::executeParallelLoop(DWORD threadProc(void *pParamete
     unsigned int curThreadNo;										 // the threads are enumerated from 0 to numThreads-1
     int numIterations = (finalValue - initialValue) / inkrement + 1; // total number of iterations
     int chunkSize = 0;												 // number of iterations per chunk
-    SIZE_T dwStackSize = 0;											 // initital stack size of each thread. 0 means default size ~1MB
+    int firstIteration = 0;											 // first iteration of the block of the current thread
     ForLoop *forLoopParameters = new ForLoop[numThreads];			 //
 
     // globals
     termineAllThreads = false;
-
-    // create threads
-    for (curThreadNo = 0; curThreadNo < numThreads; curThreadNo++) {
-        forLoopParameters[curThreadNo].pParameter = (pParameter != nullptr ? (void *)(((char *)pParameter) + curThreadNo * parameterStructSize) : nullptr);
-        forLoopParameters[curThreadNo].threadManager = this;
-        forLoopParameters[curThreadNo].threadProc = threadProc;
-        forLoopParameters[curThreadNo].inkrement = inkrement;
-        forLoopParameters[curThreadNo].scheduleType = scheduleType;
-
-        switch (scheduleType) {
-        case TM_SCHEDULE_STATIC:
-            chunkSize = numIterations / numThreads + (curThreadNo < numIterations %numThreads ? 1 : 0);
-            if (curThreadNo == 0) {
-                forLoopParameters[curThreadNo].initialValue = initialValue;
-            } else {
-                forLoopParameters[curThreadNo].initialValue = forLoopParameters[curThreadNo - 1].finalValue + 1;
+    nextIteration = 0;
+    workQueues = new WorkQueue[numThreads];
+
+    // create threads. getThreadNumber() must know all of them before the first one starts working.
+    {
+        lock_guard<mutex> lock(csBarrier);
+
+        for (curThreadNo = 0; curThreadNo < numThreads; curThreadNo++) {
+            forLoopParameters[curThreadNo].pParameter = (pParameter != nullptr ? (void *)(((char *)pParameter) + curThreadNo * parameterStructSize) : nullptr);
+            forLoopParameters[curThreadNo].threadManager = this;
+            forLoopParameters[curThreadNo].threadProc = threadProc;
+            forLoopParameters[curThreadNo].threadNo = curThreadNo;
+            forLoopParameters[curThreadNo].inkrement = inkrement;
+            forLoopParameters[curThreadNo].loopInitialValue = initialValue;
+            forLoopParameters[curThreadNo].numIterations = numIterations;
+            forLoopParameters[curThreadNo].scheduleType = scheduleType;
+
+            // static blocks, which are the initial work queues as well
+            chunkSize = numIterations / numThreads + (curThreadNo < numIterations % numThreads ? 1 : 0);
+            forLoopParameters[curThreadNo].initialValue = initialValue + firstIteration * inkrement;
+            forLoopParameters[curThreadNo].finalValue = forLoopParameters[curThreadNo].initialValue + (chunkSize - 1) * inkrement;
+            if (chunkSize > 0) {
+                workQueues[curThreadNo].ranges.push_back(make_pair(firstIteration, firstIteration + chunkSize));
             }
-            forLoopParameters[curThreadNo].finalValue = forLoopParameters[curThreadNo].initialValue + chunkSize - 1;
-            break;
-        case TM_SCHEDULE_DYNAMIC:
-            return TM_RETURN_VALUE_INVALID_PARAM;
-            break;
-        case TM_SCHEDULE_GUIDED:
-            return TM_RETURN_VALUE_INVALID_PARAM;
-            break;
-        case TM_SCHEDULE_RUNTIME:
-            return TM_RETURN_VALUE_INVALID_PARAM;
-            break;
-        }
-
-        // create suspended thread
-        hThread[curThreadNo] = CreateThread(nullptr, dwStackSize, threadForLoop, (LPVOID)(&forLoopParameters[curThreadNo]), CREATE_SUSPENDED, &threadId[curThreadNo]);
-
-        if (hThread[curThreadNo] != nullptr) {
-            SetThreadPriority(hThread[curThreadNo], THREAD_PRIORITY_BELOW_NORMAL);
-        }
-
-        if (hThread[curThreadNo] == nullptr) {
-            for (curThreadNo; curThreadNo > 0; curThreadNo--) {
-                CloseHandle(hThread[curThreadNo - 1]);
-                hThread[curThreadNo - 1] = nullptr;
+            firstIteration += chunkSize;
+
+            // create thread, which waits until all threads are created
+            try {
+                hThread[curThreadNo] = thread([=] {
+                    { lock_guard<mutex> startLock(csBarrier); }
+                    threadForLoop(&forLoopParameters[curThreadNo]);
+                });
+            } catch (const system_error &) {
+                termineAllThreads = true;
+                break;
             }
-
-            return TM_RETURN_VALUE_UNEXPECTED_ERROR;
+            threadId[curThreadNo] = hThread[curThreadNo].get_id();
+            setThreadPriorityBelowNormal(hThread[curThreadNo]);
+#ifdef _WIN32
+            // don't start if in pause mode
+            if (executionPaused)
+                SuspendThread(hThread[curThreadNo].native_handle());
+#endif
+
+            //DWORD dwThreadAffinityMask = 1 << curThreadNo;
+            //SetThreadAffinityMask(hThread[curThreadNo], &dwThreadAffinityMask);
         }
 
-        //DWORD dwThreadAffinityMask = 1 << curThreadNo;
-        //SetThreadAffinityMask(hThread[curThreadNo], &dwThreadAffinityMask);
-    }
-
-    // start threads, but don't resume if in pause mode
-    for (curThreadNo = 0; curThreadNo < numThreads; curThreadNo++) {
-        if (!executionPaused)
-            ResumeThread(hThread[curThreadNo]);
+        // the threads started so far must not wait at the barrier for the missing ones
+        numThreadsAtBarrier = curThreadNo;
     }
 
     // wait for every thread to end
-    WaitForMultipleObjects(numThreads, hThread, TRUE, INFINITE);
+    joinAllThreads();
+    delete[] forLoopParameters;
+    delete[] workQueues;
+    workQueues = nullptr;
 
-    // Close all thread handles upon completion.
-    for (curThreadNo = 0; curThreadNo < numThreads; curThreadNo++) {
-        CloseHandle(hThread[curThreadNo]);
-        hThread[curThreadNo] = nullptr;
-        threadId[curThreadNo] = 0;
+    if (curThreadNo < numThreads) {
+        return TM_RETURN_VALUE_UNEXPECTED_ERROR;
     }
-    delete[] forLoopParameters;
 
     // everything ok
     if (executionCancelled) {
@@ -397,41 +399,141 @@ unsigned int ThreadManager::executeParallelLoop(DWORD threadProc(void *pParamete
     }
 }
 
+//-----------------------------------------------------------------------------
+// runIteration()
+// Calls the user function for one iteration. Returns false if the loop shall end.
+//-----------------------------------------------------------------------------
+bool ThreadManager::runIteration(ForLoop *forLoopParameters, int iteration)
+{
+    waitWhilePaused();
+
+    switch (forLoopParameters->threadProc(forLoopParameters->pParameter, iteration)) {
+    case TM_RETURN_VALUE_OK:
+        break;
+    case TM_RETURN_VALUE_TERMINATE_ALL_THREADS:
+        termineAllThreads = true;
+        break;
+    default:
+        break;
+    }
+
+    return !termineAllThreads;
+}
+
+//-----------------------------------------------------------------------------
+// takeIterations()
+// Takes the next iterations [first, last) for a thread from its own work
+// queue, or steals them from another thread. Returns false if there are none.
+//-----------------------------------------------------------------------------
+bool ThreadManager::takeIterations(unsigned int threadNo, int &first, int &last)
+{
+    WorkQueue &ownQueue = workQueues[threadNo];
+
+    while (true) {
+        // own iterations are taken from the front, so that they are processed in ascending order
+        {
+            lock_guard<mutex> lock(ownQueue.csQueue);
+
+            if (!ownQueue.ranges.empty()) {
+                pair<int, int> &range = ownQueue.ranges.front();
+                first = range.first;
+                last = min(range.second, range.first + TM_DYNAMIC_CHUNK_SIZE);
+                range.first = last;
+                if (range.first == range.second)
+                    ownQueue.ranges.pop_front();
+                return true;
+            }
+        }
+
+        // steal from the back of the other queues
+        pair<int, int> stolenRange(0, 0);
+
+        for (unsigned int i = 1; i < numThreads && stolenRange.first == stolenRange.second; i++) {
+            WorkQueue &victimQueue = workQueues[(threadNo + i) % numThreads];
+            lock_guard<mutex> lock(victimQueue.csQueue);
+
+            if (victimQueue.ranges.empty())
+                continue;
+
+            pair<int, int> &range = victimQueue.ranges.back();
+            int numLeft = range.second - range.first;
+
+            if (numLeft <= TM_DYNAMIC_CHUNK_SIZE) {
+                stolenRange = range;
+                victimQueue.ranges.pop_back();
+            } else {
+                stolenRange = make_pair(range.second - numLeft / 2, range.second);
+                range.second = stolenRange.first;
+            }
+        }
+
+        // everything is done or in progress
+        if (stolenRange.first == stolenRange.second)
+            return false;
+
+        lock_guard<mutex> lock(ownQueue.csQueue);
+        ownQueue.ranges.push_back(stolenRange);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// takeGuidedIterations()
+// Takes a chunk proportional to the number of iterations left. Returns false if there are none.
+//-----------------------------------------------------------------------------
+bool ThreadManager::takeGuidedIterations(int numIterations, int &first, int &last)
+{
+    int chunkSize;
+
+    first = nextIteration;
+
+    do {
+        if (first >= numIterations)
+            return false;
+        chunkSize = max((numIterations - first) / (2 * (int)numThreads), 1);
+    } while (!nextIteration.compare_exchange_weak(first, first + chunkSize));
+
+    last = first + chunkSize;
+
+    return true;
+}
+
 //-----------------------------------------------------------------------------
 // threadForLoop()
 // 
 //-----------------------------------------------------------------------------
-DWORD WINAPI ThreadManager::threadForLoop(LPVOID lpParameter)
+DWORD ThreadManager::threadForLoop(ForLoop *forLoopParameters)
 {
     // locals
-    ForLoop *forLoopParameters = (ForLoop *)lpParameter;
+    ThreadManager *tm = forLoopParameters->threadManager;
     int index;
+    int first, last;
+    int iteration;
 
     switch (forLoopParameters->scheduleType) {
     case TM_SCHEDULE_STATIC:
         for (index = forLoopParameters->initialValue; (forLoopParameters->inkrement < 0) ? index >= forLoopParameters->finalValue : index <= forLoopParameters->finalValue; index += forLoopParameters->inkrement) {
-            switch (forLoopParameters->threadProc(forLoopParameters->pParameter, index)) {
-            case TM_RETURN_VALUE_OK:
-                break;
-            case TM_RETURN_VALUE_TERMINATE_ALL_THREADS:
-                forLoopParameters->threadManager->termineAllThreads = true;
-                break;
-            default:
-                break;
-            }
-            if (forLoopParameters->threadManager->termineAllThreads)
+            if (!tm->runIteration(forLoopParameters, index))
                 break;
         }
         break;
     case TM_SCHEDULE_DYNAMIC:
-        return TM_RETURN_VALUE_INVALID_PARAM;
+        while (!tm->termineAllThreads && tm->takeIterations(forLoopParameters->threadNo, first, last)) {
+            for (iteration = first; iteration < last; iteration++) {
+                if (!tm->runIteration(forLoopParameters, forLoopParameters->loopInitialValue + iteration * forLoopParameters->inkrement))
+                    break;
+            }
+        }
         break;
     case TM_SCHEDULE_GUIDED:
-        return TM_RETURN_VALUE_INVALID_PARAM;
+        while (!tm->termineAllThreads && tm->takeGuidedIterations(forLoopParameters->numIterations, first, last)) {
+            for (iteration = first; iteration < last; iteration++) {
+                if (!tm->runIteration(forLoopParameters, forLoopParameters->loopInitialValue + iteration * forLoopParameters->inkrement))
+                    break;
+            }
+        }
         break;
-    case TM_SCHEDULE_RUNTIME:
+    default:
         return TM_RETURN_VALUE_INVALID_PARAM;
-        break;
     }
 
     return TM_RETURN_VALUE_OK;
@@ -10,12 +10,26 @@
 #define THREADMANAGER_H
 
 // standard library & win32 api
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
 
 using namespace std; // use standard library namespace
 
+#ifndef _WIN32
+typedef unsigned int DWORD;
+#endif
 
 #define TM_SCHEDULE_USER_DEFINED 0
 #define TM_SCHEDULE_STATIC 1
@@ -30,6 +44,8 @@ using namespace std; // use standard library namespace
 #define TM_RETURN_VALUE_INVALID_PARAM 3
 #define TM_RETURN_VALUE_UNEXPECTED_ERROR 4
 
+#define TM_DYNAMIC_CHUNK_SIZE 64 // number of iterations a thread takes at once from its work queue with TM_SCHEDULE_DYNAMIC
+
 
 
 /*** Strukturen ******************************************************/
@@ -43,31 +59,54 @@ private:
     struct ForLoop
     {
         unsigned int scheduleType;
+        unsigned int threadNo;
         int inkrement;
         int initialValue;
         int finalValue;
+        int loopInitialValue; // index of the first iteration of the whole loop
+        int numIterations;
         void *pParameter;
         DWORD(*threadProc)
             (void *pParameter, unsigned int index); // pointer to the user function to be executed by the threads
         ThreadManager *threadManager;
     };
 
+    // iterations [first, last) not yet processed, owned by one thread but open to all others for stealing
+    struct WorkQueue
+    {
+        mutex csQueue;
+        deque<pair<int, int>> ranges;
+    };
+
     // Variables
-    unsigned int numThreads; // number of threads
-    HANDLE *hThread;		 // array of size 'numThreads' containing the thread handles
-    DWORD *threadId;		 // array of size 'numThreads' containing the thread ids
-    bool termineAllThreads;
-    bool executionPaused;	 // switch for the
-    bool executionCancelled; // true when cancelExecution() was called
+    unsigned int numThreads;	   // number of threads
+    vector<thread> hThread;		   // array of size 'numThreads' containing the threads
+    vector<thread::id> threadId;   // array of size 'numThreads' containing the thread ids
+    atomic<bool> termineAllThreads;
+    atomic<bool> executionPaused;  // switch for the
+    atomic<bool> executionCancelled; // true when cancelExecution() was called
+    mutex csPause;				   // threads wait on condPause while execution is paused, where they cannot be suspended
+    condition_variable condPause;  //
+
+    // scheduling of executeParallelLoop()
+    WorkQueue *workQueues;		   // array of size 'numThreads' used by TM_SCHEDULE_DYNAMIC
+    atomic<int> nextIteration;	   // first iteration not yet taken by any thread with TM_SCHEDULE_GUIDED
 
     // barier stuff
-    HANDLE hEventBarrierPassedByEveryBody;
-    HANDLE *hBarrier; // array of size 'numThreads' containing the event handles for the barrier
+    mutex csBarrier;
+    condition_variable condBarrier;
     unsigned int numThreadsPassedBarrier;
-    CRITICAL_SECTION csBarrier;
+    unsigned int numThreadsAtBarrier; // number of threads actually started, which all have to reach the barrier
+    unsigned int barrierGeneration; // incremented each time all threads have reached the barrier
 
     // functions
-    static DWORD WINAPI threadForLoop(LPVOID lpParameter);
+    static DWORD threadForLoop(ForLoop *forLoopParameters);
+    bool runIteration(ForLoop *forLoopParameters, int iteration);
+    bool takeIterations(unsigned int threadNo, int &first, int &last);
+    bool takeGuidedIterations(int numIterations, int &first, int &last);
+    void waitWhilePaused();
+    void setThreadPriorityBelowNormal(thread &t);
+    void joinAllThreads();
 
 public:
     class ThreadVarsArrayItem
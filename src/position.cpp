@@ -20,7 +20,9 @@
 #include <sstream>
 
 #include "bitboard.h"
+#include "evaluate.h"
 #include "position.h"
+#include "nnue/evaluate_nnue.h"
 #include "thread.h"
 #include "mills.h"
 #include "option.h"
@@ -30,8 +32,15 @@ using std::string;
 namespace Zobrist
 {
 constexpr int KEY_MISC_BIT = 2;
+constexpr int IN_HAND_NB = 13;  // 0 ~ 12 pieces in hand
+constexpr int PHASE_NB = 5;
 Key psq[PIECE_TYPE_NB][SQUARE_NB];
 Key side;
+Key inHand[COLOR_NB][IN_HAND_NB];
+Key phase[PHASE_NB];
+#ifdef SYMMETRY_KEY_ENABLE
+Key psqSym[PIECE_TYPE_NB][SQUARE_NB][SYMMETRY_NB];
+#endif // SYMMETRY_KEY_ENABLE
 }
 
 namespace
@@ -171,13 +180,46 @@ void Position::init()
 
     Zobrist::side = rng.rand<Key>() << Zobrist::KEY_MISC_BIT >> Zobrist::KEY_MISC_BIT;
 
+    for (Color c : { WHITE, BLACK })
+        for (int n = 0; n < Zobrist::IN_HAND_NB; n++)
+            Zobrist::inHand[c][n] = rng.rand<Key>() << Zobrist::KEY_MISC_BIT >> Zobrist::KEY_MISC_BIT;
+
+    for (int p = 0; p < Zobrist::PHASE_NB; p++)
+        Zobrist::phase[p] = rng.rand<Key>() << Zobrist::KEY_MISC_BIT >> Zobrist::KEY_MISC_BIT;
+
+#ifdef SYMMETRY_KEY_ENABLE
+    // Symmetry index bits: 0-1 rotate by 90 degrees, 2 mirror, 3 swap rings.
+    // Within a ring, squares are numbered clockwise from the top middle.
+    for (int i = 0; i < SYMMETRY_NB; i++) {
+        for (Square s = SQ_0; s < SQUARE_NB; ++s) {
+            symmetrySquare[i][s] = inverseSymmetrySquare[i][s] = s;
+        }
+
+        for (Square s = SQ_BEGIN; s < SQ_END; ++s) {
+            const int f = static_cast<int>(s) >> 3;
+            int r = static_cast<int>(s) & 7;
+
+            if (i & 4)
+                r = (8 - r) & 7;
+
+            r = (r + 2 * (i & 3)) & 7;
+
+            const Square t = static_cast<Square>(((i & 8) ? 4 - f : f) * 8 + r);
+            symmetrySquare[i][s] = t;
+            inverseSymmetrySquare[i][t] = s;
+        }
+
+        for (PieceType pt : PieceTypes)
+            for (Square s = SQ_BEGIN; s < SQ_END; ++s)
+                Zobrist::psqSym[pt][s][i] = Zobrist::psq[pt][symmetrySquare[i][s]];
+    }
+#endif // SYMMETRY_KEY_ENABLE
+
     return;
 }
 
 Position::Position()
 {
-    construct_key();
-
     reset();
 
     score[WHITE] = score[BLACK] = score_draw = gamesPlayedCount = 0;
@@ -299,6 +341,16 @@ Position &Position::set(const string &fenStr, Thread *th)
 
     thisThread = th;
 
+    construct_key();
+    calculate_mobility_diff();
+    calculate_pattern_value();
+
+#ifdef NNUE_ENABLE
+    if (Eval::useNNUE) {
+        Eval::NNUE::refresh_accumulator(*this, accumulator);
+    }
+#endif // NNUE_ENABLE
+
     return *this;
 }
 
@@ -408,6 +460,7 @@ bool Position::legal(Move m) const
 /// to a StateInfo object. The move is assumed to be legal. Pseudo-legal
 /// moves should be filtered out before this function is called.
 
+template<class R>
 void Position::do_move(Move m)
 {
     bool ret = false;
@@ -416,20 +469,20 @@ void Position::do_move(Move m)
 
     switch (mt) {
     case MOVETYPE_REMOVE:
-        ret = remove_piece(to_sq(m));
+        ret = remove_piece<R>(to_sq(m));
         if (ret) {
             // Reset rule 50 counter
             st.rule50 = 0;
         }
         break;
     case MOVETYPE_MOVE:
-        ret = move_piece(from_sq(m), to_sq(m));
+        ret = move_piece<R>(from_sq(m), to_sq(m));
         if (ret) {
             ++st.rule50;
         }
         break;
     case MOVETYPE_PLACE:
-        ret = put_piece(to_sq(m));
+        ret = put_piece<R>(to_sq(m));
         if (ret) {
             // Reset rule 50 counter
             st.rule50 = 0;
@@ -448,6 +501,8 @@ void Position::do_move(Move m)
     ++st.pliesFromNull;
 
     move = m;
+
+    assert(key_is_ok());
 }
 
 
@@ -484,6 +539,9 @@ Key Position::key_after(Move m) const
 
     if (mt == MOVETYPE_MOVE) {
         k ^= Zobrist::psq[side_to_move()][from_sq(m)];
+    } else {
+        const int n = pieceInHandCount[side_to_move()];
+        k ^= Zobrist::inHand[side_to_move()][n] ^ Zobrist::inHand[side_to_move()][n - 1];
     }
 
 out:
@@ -492,6 +550,60 @@ out:
     return k;
 }
 
+#ifdef SYMMETRY_KEY_ENABLE
+/// Position::canonical_key_after() is the symmetry-invariant counterpart of
+/// key_after(), used to prefetch the TT entries of the children.
+
+Key Position::canonical_key_after(Move m) const
+{
+    const Square s = static_cast<Square>(to_sq(m));
+    const MoveType mt = type_of(m);
+    int pt1 = side_to_move();
+    int pt2 = NO_PIECE_TYPE;
+    Square s2 = SQ_0;
+
+    if (mt == MOVETYPE_REMOVE) {
+        pt1 = ~side_to_move();
+
+        if (rule.hasBannedLocations && phase == Phase::placing) {
+            pt2 = BAN;
+            s2 = s;
+        }
+    } else if (mt == MOVETYPE_MOVE) {
+        pt2 = side_to_move();
+        s2 = from_sq(m);
+    }
+
+    Key k = st.symmetryKey[0] ^ Zobrist::psqSym[pt1][s][0] ^ Zobrist::psqSym[pt2][s2][0];
+
+    for (int i = 1; i < SYMMETRY_NB; i++) {
+        k = std::min(k, st.symmetryKey[i] ^ Zobrist::psqSym[pt1][s][i] ^ Zobrist::psqSym[pt2][s2][i]);
+    }
+
+    return k ^ st.key ^ st.symmetryKey[0] ^ Zobrist::side;
+}
+
+/// Position::transform_move() maps a move to the symmetric image 'sym' of the
+/// board, or back from it if 'inverse' is set.
+
+Move Position::transform_move(Move m, int sym, bool inverse)
+{
+    if (m == MOVE_NONE || m == MOVE_NULL)
+        return m;
+
+    const Square *t = inverse ? inverseSymmetrySquare[sym] : symmetrySquare[sym];
+
+    switch (type_of(m)) {
+    case MOVETYPE_REMOVE:
+        return static_cast<Move>(-t[to_sq(m)]);
+    case MOVETYPE_MOVE:
+        return make_move(t[from_sq(m)], t[to_sq(m)]);
+    default:
+        return static_cast<Move>(t[to_sq(m)]);
+    }
+}
+#endif // SYMMETRY_KEY_ENABLE
+
 int repetition;
 
 // Position::has_repeated() tests whether there has been at least one repetition
@@ -560,13 +672,14 @@ bool Position::reset()
     memset(byTypeBB, 0, sizeof(byTypeBB));
     memset(byColorBB, 0, sizeof(byColorBB));
 
-    st.key = 0;
-
     pieceOnBoardCount[WHITE] = pieceOnBoardCount[BLACK] = 0;
     pieceInHandCount[WHITE] = pieceInHandCount[BLACK] = rule.piecesCount;
     pieceToRemoveCount = 0;
 
-    mobilityDiff = 0;
+    construct_key();
+
+    mobility[WHITE] = mobility[BLACK] = 0;
+    patternValue = 0;
 
     MoveList<LEGAL>::create();
     create_mill_table();
@@ -607,13 +720,14 @@ bool Position::start()
         reset();
         [[fallthrough]];
     case Phase::ready:
-        phase = Phase::placing;
+        change_phase(Phase::placing);
         return true;
     default:
         return false;
     }
 }
 
+template<class R>
 bool Position::put_piece(Square s, bool updateRecord)
 {
     Piece piece = NO_PIECE;
@@ -630,8 +744,8 @@ bool Position::put_piece(Square s, bool updateRecord)
     }
 
     if (phase == Phase::placing) {
-        piece = (Piece)((0x01 | make_piece(sideToMove)) + rule.piecesCount - pieceInHandCount[us]);
-        pieceInHandCount[us]--;
+        piece = (Piece)((0x01 | make_piece(sideToMove)) + R::rule.piecesCount - pieceInHandCount[us]);
+        change_piece_in_hand_count(us, -1);
         pieceOnBoardCount[us]++;
 
         const Piece pc = board[s] = piece;
@@ -641,6 +755,8 @@ bool Position::put_piece(Square s, bool updateRecord)
         update_key(s);
 
         updateMobility(MOVETYPE_PLACE, s);
+        update_pattern(s, NO_PIECE, pc);
+        update_accumulator(s, NO_PIECE, pc);
 
         if (updateRecord) {
             snprintf(record, RECORD_LEN_MAX, "(%1u,%1u)", file_of(s), rank_of(s));
@@ -651,7 +767,7 @@ bool Position::put_piece(Square s, bool updateRecord)
 #ifdef MADWEASEL_MUEHLE_RULE
         if (pieceInHandCount[WHITE] == 0 &&
             pieceInHandCount[BLACK] == 0 &&
-            is_all_surrounded(~sideToMove, SQ_0, s)) {
+            is_all_surrounded<R>(~sideToMove, SQ_0, s)) {
             set_gameover(sideToMove, GameOverReason::loseReasonNoWay);
             //change_side_to_move();
             return true;
@@ -668,53 +784,51 @@ bool Position::put_piece(Square s, bool updateRecord)
             assert(pieceInHandCount[WHITE] >= 0 && pieceInHandCount[BLACK] >= 0);
 
             if (pieceInHandCount[WHITE] == 0 && pieceInHandCount[BLACK] == 0) {
-                if (check_if_game_is_over()) {
+                if (check_if_game_is_over<R>()) {
                     return true;
                 }
 
-                phase = Phase::moving;
+                change_phase(Phase::moving);
                 action = Action::select;
 
-                if (rule.hasBannedLocations) {
+                if (R::rule.hasBannedLocations) {
                     remove_ban_stones();
                 }
 
-                if (!rule.isDefenderMoveFirst) {
+                if (!R::rule.isDefenderMoveFirst) {
                     change_side_to_move();
                 }
 
-                if (check_if_game_is_over()) {
+                if (check_if_game_is_over<R>()) {
                     return true;
                 }
             } else {
                 change_side_to_move();
             }
         } else {
-            pieceToRemoveCount = rule.mayRemoveMultiple ? n : 1;
+            pieceToRemoveCount = R::rule.mayRemoveMultiple ? n : 1;
             update_key_misc();
 
-            if (rule.mayOnlyRemoveUnplacedPieceInPlacingPhase) {
-                pieceInHandCount[them] -= 1; // Or pieceToRemoveCount?;
-
-                if (pieceInHandCount[them] < 0) {
-                    pieceInHandCount[them] = 0;
+            if (R::rule.mayOnlyRemoveUnplacedPieceInPlacingPhase) {
+                if (pieceInHandCount[them] > 0) {
+                    change_piece_in_hand_count(them, -1); // Or pieceToRemoveCount?
                 }
 
                 assert(pieceInHandCount[WHITE] >= 0 && pieceInHandCount[BLACK] >= 0);
 
                 if (pieceInHandCount[WHITE] == 0 && pieceInHandCount[BLACK] == 0) {
-                    if (check_if_game_is_over()) {
+                    if (check_if_game_is_over<R>()) {
                         return true;
                     }
 
-                    phase = Phase::moving;
+                    change_phase(Phase::moving);
                     action = Action::select;
 
-                    if (rule.isDefenderMoveFirst) {
+                    if (R::rule.isDefenderMoveFirst) {
                         change_side_to_move();
                     }
 
-                    if (check_if_game_is_over()) {
+                    if (check_if_game_is_over<R>()) {
                         return true;
                     }
                 }
@@ -726,18 +840,18 @@ bool Position::put_piece(Square s, bool updateRecord)
     } else if (phase == Phase::moving) {
 
 #ifdef MADWEASEL_MUEHLE_RULE
-        if (is_all_surrounded(~sideToMove, currentSquare, s)) {
+        if (is_all_surrounded<R>(~sideToMove, currentSquare, s)) {
             set_gameover(sideToMove, GameOverReason::loseReasonNoWay);
         }
 #else
-        if (check_if_game_is_over()) {
+        if (check_if_game_is_over<R>()) {
             return true;
         }
 #endif // MADWEASEL_MUEHLE_RULE
 
         // If illegal
-        if (pieceOnBoardCount[sideToMove] > rule.flyPieceCount ||
-            !rule.mayFly) {
+        if (pieceOnBoardCount[sideToMove] > R::rule.flyPieceCount ||
+            !R::rule.mayFly) {
             if ((square_bb(s) & MoveList<LEGAL>::adjacentSquaresBB[currentSquare]) == 0) {
                 return false;
             }
@@ -763,11 +877,14 @@ bool Position::put_piece(Square s, bool updateRecord)
         SET_BIT(byColorBB[color_of(pc)], s);
 
         updateMobility(MOVETYPE_PLACE, s);
-
+        update_pattern(s, NO_PIECE, pc);
+        update_accumulator(s, NO_PIECE, pc);
         board[s] = pc;
         update_key(s);
         revert_key(currentSquare);
 
+        update_pattern(currentSquare, pc, NO_PIECE);
+        update_accumulator(currentSquare, pc, NO_PIECE);
         board[currentSquare] = NO_PIECE;
 
         currentSquare = s;
@@ -782,11 +899,11 @@ bool Position::put_piece(Square s, bool updateRecord)
             action = Action::select;
             change_side_to_move();
 
-            if (check_if_game_is_over()) {
+            if (check_if_game_is_over<R>()) {
                 return true;
             }
         } else {
-            pieceToRemoveCount = rule.mayRemoveMultiple ? n : 1;
+            pieceToRemoveCount = R::rule.mayRemoveMultiple ? n : 1;
             update_key_misc();
             action = Action::remove;
         }
@@ -797,6 +914,7 @@ bool Position::put_piece(Square s, bool updateRecord)
     return true;
 }
 
+template<class R>
 bool Position::remove_piece(Square s, bool updateRecord)
 {
     if (phase == Phase::ready || phase == Phase::gameOver)
@@ -812,7 +930,7 @@ bool Position::remove_piece(Square s, bool updateRecord)
     if (!(make_piece(~side_to_move()) & board[s]))
         return false;
 
-    if (!rule.mayRemoveFromMillsAlways &&
+    if (!R::rule.mayRemoveFromMillsAlways &&
         potential_mills_count(s, NOBODY)
 #ifndef MADWEASEL_MUEHLE_RULE
         && !is_all_in_mills(~sideToMove)
@@ -824,13 +942,14 @@ bool Position::remove_piece(Square s, bool updateRecord)
     revert_key(s);
 
     Piece pc = board[s];
+    const Piece removed = pc;
 
     CLEAR_BIT(byTypeBB[type_of(pc)], s);    // TODO: rule.hasBannedLocations and placing need?
     CLEAR_BIT(byColorBB[color_of(pc)], s);
 
     updateMobility(MOVETYPE_REMOVE, s);
 
-    if (rule.hasBannedLocations && phase == Phase::placing) {
+    if (R::rule.hasBannedLocations && phase == Phase::placing) {
         // Remove and put ban
         pc = board[s] = BAN_STONE;
         update_key(s);
@@ -841,6 +960,9 @@ bool Position::remove_piece(Square s, bool updateRecord)
         board[s] = NO_PIECE;
     }
 
+    update_pattern(s, removed, board[s]);
+    update_accumulator(s, removed, board[s]);
+
     if (updateRecord) {
         snprintf(record, RECORD_LEN_MAX, "-(%1u,%1u)", file_of(s), rank_of(s));
         st.rule50 = 0;     // TODO: Need to move out?
@@ -848,7 +970,7 @@ bool Position::remove_piece(Square s, bool updateRecord)
 
     pieceOnBoardCount[them]--;
 
-    if (pieceOnBoardCount[them] + pieceInHandCount[them] < rule.piecesAtLeastCount) {
+    if (pieceOnBoardCount[them] + pieceInHandCount[them] < R::rule.piecesAtLeastCount) {
         set_gameover(sideToMove, GameOverReason::loseReasonlessThanThree);
         return true;
     }
@@ -864,14 +986,14 @@ bool Position::remove_piece(Square s, bool updateRecord)
 
     if (phase == Phase::placing) {
         if (pieceInHandCount[WHITE] == 0 && pieceInHandCount[BLACK] == 0) {
-            phase = Phase::moving;
+            change_phase(Phase::moving);
             action = Action::select;
 
-            if (rule.hasBannedLocations) {
+            if (R::rule.hasBannedLocations) {
                 remove_ban_stones();
             }
 
-            if (rule.isDefenderMoveFirst) {
+            if (R::rule.isDefenderMoveFirst) {
                 goto check;
             }
         } else {
@@ -884,7 +1006,7 @@ bool Position::remove_piece(Square s, bool updateRecord)
     change_side_to_move();
 
 check:
-    if (check_if_game_is_over()) {
+    if (check_if_game_is_over<R>()) {
         return true;
     }
 
@@ -985,7 +1107,7 @@ Color Position::get_winner() const noexcept
 
 void Position::set_gameover(Color w, GameOverReason reason)
 {
-    phase = Phase::gameOver;
+    change_phase(Phase::gameOver);
     gameOverReason = reason;
     winner = w;
 
@@ -1004,6 +1126,7 @@ void Position::update_score()
     }
 }
 
+template<class R>
 bool Position::check_if_game_is_over()
 {
 #ifdef RULE_50
@@ -1022,7 +1145,7 @@ bool Position::check_if_game_is_over()
 #endif // RULE_50
 
     if (pieceOnBoardCount[WHITE] + pieceOnBoardCount[BLACK] >= EFFECTIVE_SQUARE_NB) {
-        if (rule.isWhiteLoseButNotDrawWhenBoardFull) {
+        if (R::rule.isWhiteLoseButNotDrawWhenBoardFull) {
             set_gameover(BLACK, GameOverReason::loseReasonBoardIsFull);
         } else {
             set_gameover(DRAW, GameOverReason::drawReasonBoardIsFull);
@@ -1031,8 +1154,8 @@ bool Position::check_if_game_is_over()
         return true;
     }
 
-    if (phase == Phase::moving && action == Action::select && is_all_surrounded(sideToMove)) {
-        if (rule.isLoseButNotChangeSideWhenNoWay) {
+    if (phase == Phase::moving && action == Action::select && is_all_surrounded<R>(sideToMove)) {
+        if (R::rule.isLoseButNotChangeSideWhenNoWay) {
             set_gameover(~sideToMove, GameOverReason::loseReasonNoWay);
             return true;
         } else {
@@ -1044,30 +1167,24 @@ bool Position::check_if_game_is_over()
     return false;
 }
 
+/// Position::calculate_mobility_diff() computes the mobility counts from
+/// scratch. It is used when the board is set up without updateMobility(),
+/// e.g. from a FEN string. Ban stones count as free squares.
+
 int Position::calculate_mobility_diff()
 {
-    // TODO: Deal with rule is no ban location
-    int mobilityWhite = 0;
-    int mobilityBlack = 0;
+    const Bitboard freeBB = BoardBB & ~(byColorBB[WHITE] | byColorBB[BLACK]);
 
-    for (Square s = SQ_BEGIN; s < SQ_END; ++s) {
-        if (board[s] == NO_PIECE || board[s] == BAN_STONE) {
-            Square moveSquare;
-            for (MoveDirection d = MD_BEGIN; d < MD_NB; ++d) {
-                moveSquare = static_cast<Square>(MoveList<LEGAL>::adjacentSquares[s][d]);
-                if (moveSquare) {
-                    if (board[moveSquare] & W_STONE) {
-                        mobilityWhite++;
-                    }
-                    if (board[moveSquare] & B_STONE) {
-                        mobilityBlack++;
-                    }
-                }
-            }
-        }
+    mobility[WHITE] = mobility[BLACK] = 0;
+
+    for (Bitboard b = freeBB; b; ) {
+        const Bitboard adjacent = MoveList<LEGAL>::adjacentSquaresBB[pop_lsb(&b)];
+
+        mobility[WHITE] += popcount(byColorBB[WHITE] & adjacent);
+        mobility[BLACK] += popcount(byColorBB[BLACK] & adjacent);
     }
 
-    return mobilityWhite - mobilityBlack;
+    return get_mobility_diff();
 }
 
 void Position::remove_ban_stones()
@@ -1089,6 +1206,10 @@ void Position::remove_ban_stones()
             }
         }
     }
+
+    if (gameOptions.getConsiderPattern()) {
+        calculate_pattern_value();
+    }
 }
 
 inline void Position::set_side_to_move(Color c)
@@ -1104,12 +1225,62 @@ inline void Position::change_side_to_move()
     st.key ^= Zobrist::side;
 }
 
+inline void Position::change_phase(Phase p)
+{
+    st.key ^= Zobrist::phase[static_cast<int>(phase)] ^ Zobrist::phase[static_cast<int>(p)];
+
+#ifdef NNUE_ENABLE
+    if (Eval::useNNUE) {
+        if (Eval::NNUE::phase_feature(phase) >= 0) {
+            Eval::NNUE::remove_feature(accumulator, Eval::NNUE::phase_feature(phase));
+        }
+
+        if (Eval::NNUE::phase_feature(p) >= 0) {
+            Eval::NNUE::add_feature(accumulator, Eval::NNUE::phase_feature(p));
+        }
+    }
+#endif // NNUE_ENABLE
+
+    phase = p;
+}
+
+inline void Position::change_piece_in_hand_count(Color c, int delta)
+{
+    st.key ^= Zobrist::inHand[c][pieceInHandCount[c]];
+
+#ifdef NNUE_ENABLE
+    if (Eval::useNNUE) {
+        // Thermometer code: feature k is active while more than k pieces are in hand
+        for (int k = pieceInHandCount[c]; k < pieceInHandCount[c] + delta; k++) {
+            if (k < Eval::NNUE::MaxPiecesInHand) {
+                Eval::NNUE::add_feature(accumulator, Eval::NNUE::hand_feature(c, k));
+            }
+        }
+
+        for (int k = pieceInHandCount[c] + delta; k < pieceInHandCount[c]; k++) {
+            if (k < Eval::NNUE::MaxPiecesInHand) {
+                Eval::NNUE::remove_feature(accumulator, Eval::NNUE::hand_feature(c, k));
+            }
+        }
+    }
+#endif // NNUE_ENABLE
+
+    pieceInHandCount[c] += delta;
+    st.key ^= Zobrist::inHand[c][pieceInHandCount[c]];
+}
+
 inline Key Position::update_key(Square s)
 {
     const int pieceType = color_on(s);
 
     st.key ^= Zobrist::psq[pieceType][s];
 
+#ifdef SYMMETRY_KEY_ENABLE
+    for (int i = 0; i < SYMMETRY_NB; i++) {
+        st.symmetryKey[i] ^= Zobrist::psqSym[pieceType][s][i];
+    }
+#endif // SYMMETRY_KEY_ENABLE
+
     return st.key;
 }
 
@@ -1118,6 +1289,97 @@ inline Key Position::revert_key(Square s)
     return update_key(s);
 }
 
+/// Position::compute_key() computes the hash key of the position from scratch.
+/// The key covers the board, side to move, pieces in hand, phase and, in its
+/// top bits, the number of pieces still to be removed. The pending action
+/// is not hashed on its own: a remove is implied by the top bits, and select
+/// and place only differ transiently while a piece is being moved.
+
+Key Position::compute_key() const
+{
+    Key k = 0;
+
+    for (Square s = SQ_BEGIN; s < SQ_END; ++s) {
+        if (board[s] != NO_PIECE) {
+            k ^= Zobrist::psq[color_on(s)][s];
+        }
+    }
+
+    if (sideToMove == BLACK) {
+        k ^= Zobrist::side;
+    }
+
+    k ^= Zobrist::inHand[WHITE][pieceInHandCount[WHITE]];
+    k ^= Zobrist::inHand[BLACK][pieceInHandCount[BLACK]];
+    k ^= Zobrist::phase[static_cast<int>(phase)];
+
+    k |= static_cast<Key>(pieceToRemoveCount) << (CHAR_BIT * sizeof(Key) - Zobrist::KEY_MISC_BIT);
+
+    return k;
+}
+
+#ifdef SYMMETRY_KEY_ENABLE
+/// Position::compute_symmetry_keys() computes the board part of the key of
+/// each symmetric image from scratch.
+
+void Position::compute_symmetry_keys(Key keys[SYMMETRY_NB]) const
+{
+    memset(keys, 0, sizeof(Key) * SYMMETRY_NB);
+
+    for (Square s = SQ_BEGIN; s < SQ_END; ++s) {
+        if (board[s] != NO_PIECE) {
+            for (int i = 0; i < SYMMETRY_NB; i++) {
+                keys[i] ^= Zobrist::psqSym[color_on(s)][s][i];
+            }
+        }
+    }
+}
+#endif // SYMMETRY_KEY_ENABLE
+
+/// Position::construct_key() initializes the hash keys from scratch. Called
+/// whenever the position is set up other than by making moves.
+
+void Position::construct_key()
+{
+    st.key = compute_key();
+
+#ifdef SYMMETRY_KEY_ENABLE
+    compute_symmetry_keys(st.symmetryKey);
+#endif // SYMMETRY_KEY_ENABLE
+}
+
+/// Position::key_is_ok() checks the incrementally updated hash keys against
+/// a full recomputation. Only active with HASH_KEY_DEBUG.
+
+bool Position::key_is_ok() const
+{
+#ifdef HASH_KEY_DEBUG
+    const Key k = compute_key();
+
+    if (st.key != k) {
+        loggerDebug("[key] Mismatch: incremental 0x%016llx, computed 0x%016llx, fen: %s\n",
+                    static_cast<unsigned long long>(st.key), static_cast<unsigned long long>(k), fen().c_str());
+        return false;
+    }
+
+#ifdef SYMMETRY_KEY_ENABLE
+    Key symKeys[SYMMETRY_NB];
+    compute_symmetry_keys(symKeys);
+
+    for (int i = 0; i < SYMMETRY_NB; i++) {
+        if (st.symmetryKey[i] != symKeys[i]) {
+            loggerDebug("[key] Symmetry %d mismatch: incremental 0x%016llx, computed 0x%016llx, fen: %s\n",
+                        i, static_cast<unsigned long long>(st.symmetryKey[i]),
+                        static_cast<unsigned long long>(symKeys[i]), fen().c_str());
+            return false;
+        }
+    }
+#endif // SYMMETRY_KEY_ENABLE
+#endif // HASH_KEY_DEBUG
+
+    return true;
+}
+
 Key Position::update_key_misc()
 {
     st.key = st.key << Zobrist::KEY_MISC_BIT >> Zobrist::KEY_MISC_BIT;
@@ -1133,6 +1395,14 @@ Key Position::update_key_misc()
 #include "misc.h"
 
 Bitboard Position::millTableBB[SQUARE_NB][LD_NB] = {{0}};
+Bitboard Position::millLinesBB[MILL_LINE_NB] = {0};
+int Position::squareLines[SQUARE_NB][LD_NB];
+Square Position::lineSquares[MILL_LINE_NB][3];
+
+#ifdef SYMMETRY_KEY_ENABLE
+Square Position::symmetrySquare[SYMMETRY_NB][SQUARE_NB];
+Square Position::inverseSymmetrySquare[SYMMETRY_NB][SQUARE_NB];
+#endif // SYMMETRY_KEY_ENABLE
 
 
 void Position::create_mill_table()
@@ -1190,106 +1460,191 @@ bool Position::bitboard_is_ok()
     return true;
 }
 
-int Position::potential_mills_count(Square to, Color c, Square from)
+int Position::potential_mills_count(Square to, Color c, Square from) const
 {
-    int n = 0;
-    Piece locbak = NO_PIECE;
-
     assert(SQ_0 <= from && from < SQUARE_NB);
 
     if (c == NOBODY) {
         c = color_on(to);
     }
 
-    if (from != SQ_0 && from >= SQ_BEGIN && from < SQ_END) {
-        locbak = board[from];
-        board[from] = NO_PIECE;
+    // The piece that moves away from |from| can not be part of the new mill
+    const Bitboard bc = byColorBB[c] & ~square_bb(from);
+    const Bitboard *mt = millTableBB[to];
 
-        CLEAR_BIT(byTypeBB[ALL_PIECES], from);
-        CLEAR_BIT(byTypeBB[type_of(locbak)], from);
-        CLEAR_BIT(byColorBB[color_of(locbak)], from);
-    }
+    return ((bc & mt[LD_HORIZONTAL]) == mt[LD_HORIZONTAL]) +
+           ((bc & mt[LD_VERTICAL]) == mt[LD_VERTICAL]) +
+           ((bc & mt[LD_SLASH]) == mt[LD_SLASH]);
+}
 
+int Position::mills_count(Square s) const
+{
+    return potential_mills_count(s, color_on(s));
+}
+
+/// Position::pieces_in_mills() returns the pieces of the given color that
+/// are part of a closed mill, as the union of all complete mill lines.
+
+Bitboard Position::pieces_in_mills(Color c) const
+{
     const Bitboard bc = byColorBB[c];
-    const Bitboard *mt = millTableBB[to];
+    Bitboard b = 0;
 
-    for (int l = 0; l < LD_NB; l++) {
-        if ((bc & mt[l]) == mt[l]) {
-            n++;
+    for (const Bitboard line : millLinesBB) {
+        if ((bc & line) == line) {
+            b |= line;
         }
     }
 
-    if (from != SQ_0 && from >= SQ_BEGIN && from < SQ_END) {
-        board[from] = locbak;
+    return b;
+}
 
-        SET_BIT(byTypeBB[ALL_PIECES], from);
-        SET_BIT(byTypeBB[type_of(locbak)], from);
-        SET_BIT(byColorBB[color_of(locbak)], from);
+/// Position::mill_closing_squares() returns the empty squares that complete
+/// a mill line of the given color, whether or not a piece can get there.
+
+Bitboard Position::mill_closing_squares(Color c) const
+{
+    const Bitboard bc = byColorBB[c];
+    const Bitboard empty = ~pieces() & BoardBB;
+    Bitboard b = 0;
+
+    for (const Bitboard line : millLinesBB) {
+        if ((line & empty) && popcount(bc & line) == 2) {
+            b |= line & empty;
+        }
     }
 
-    return n;
+    return b;
+}
+
+bool Position::is_all_in_mills(Color c) const
+{
+    return (byColorBB[c] & ~pieces_in_mills(c)) == 0;
 }
 
-int Position::mills_count(Square s)
+/// Position::update_pattern() updates the pattern value when the piece on
+/// square s changes from 'before' to 'after'. All the other squares must be
+/// up to date. Each mill line through s is scored by its base 3 configuration,
+/// where the digit of a square is the Color of its piece; a line with a ban
+/// stone can never be closed and is not counted. Nothing is done unless the
+/// pattern is evaluated, the search recomputes the value of the root position
+/// when it starts.
+
+void Position::update_pattern(Square s, Piece before, Piece after)
 {
-    int n = 0;
+    if (!gameOptions.getConsiderPattern()) {
+        return;
+    }
+
+    constexpr int pow3[] = { 1, 3, 9 };
+
+    for (int k = 0; k < LD_NB && squareLines[s][k] >= 0; k++) {
+        const int l = squareLines[s][k];
+        int config = 0;
+        int weight = 0;
+        bool banned = false;
+
+        for (int i = 0; i < 3; i++) {
+            const Square sq = lineSquares[l][i];
+
+            if (sq == s) {
+                weight = pow3[i];
+            } else {
+                banned |= board[sq] == BAN_STONE;
+                config += pow3[i] * color_of(board[sq]);
+            }
+        }
+
+        if (banned) {
+            continue;
+        }
 
-    const Bitboard bc = byColorBB[color_on(s)];
-    const Bitboard *mt = millTableBB[s];
+        if (before != BAN_STONE) {
+            patternValue -= Eval::LineConfigValue[config + weight * color_of(before)];
+        }
 
-    for (auto i = 0; i < LD_NB; ++i) {
-        if (((bc & mt[i]) == mt[i])) {
-            n++;
+        if (after != BAN_STONE) {
+            patternValue += Eval::LineConfigValue[config + weight * color_of(after)];
         }
     }
 
-    return n;
+    patternValue += square_pattern(s, after) - square_pattern(s, before);
 }
 
-bool Position::is_all_in_mills(Color c)
+/// Position::update_accumulator() updates the accumulator of the network when
+/// the piece on square s changes from 'before' to 'after'. Nothing is done
+/// unless the NNUE evaluation is compiled in and used, the search refreshes
+/// the accumulator of the root position when it starts.
+
+void Position::update_accumulator(Square s, Piece before, Piece after)
 {
-    for (Square i = SQ_BEGIN; i < SQ_END; ++i) {
-        if (board[i] & ((uint8_t)make_piece(c))) {
-            if (!potential_mills_count(i, NOBODY)) {
-                return false;
-            }
-        }
+#ifndef NNUE_ENABLE
+    (void)s;
+    (void)before;
+    (void)after;
+#else
+    if (!Eval::useNNUE) {
+        return;
     }
 
-    return true;
+    const Color cb = color_of(before);
+    const Color ca = color_of(after);
+
+    if (cb == WHITE || cb == BLACK) {
+        Eval::NNUE::remove_feature(accumulator, Eval::NNUE::square_feature(cb, s));
+    }
+
+    if (ca == WHITE || ca == BLACK) {
+        Eval::NNUE::add_feature(accumulator, Eval::NNUE::square_feature(ca, s));
+    }
+#endif // NNUE_ENABLE
 }
 
-void Position::surrounded_pieces_count(Square s, int &ourPieceCount, int &theirPieceCount, int &bannedCount, int &emptyCount)
+/// Position::square_pattern() returns the square table value of piece pc on
+/// square s from WHITE's point of view.
+
+int Position::square_pattern(Square s, Piece pc)
 {
-    Square moveSquare;
+    const Color c = color_of(pc);
+
+    return c == WHITE ? Eval::SquareValue[s] : c == BLACK ? -Eval::SquareValue[s] : 0;
+}
 
-    for (MoveDirection d = MD_BEGIN; d < MD_NB; ++d) {
-        moveSquare = static_cast<Square>(MoveList<LEGAL>::adjacentSquares[s][d]);
+/// Position::calculate_pattern_value() computes the pattern value from
+/// scratch, e.g. after a FEN string is set or the ban stones are removed.
 
-        if (!moveSquare) {
+int Position::calculate_pattern_value()
+{
+    patternValue = 0;
+
+    for (int l = 0; l < MILL_LINE_NB; l++) {
+        if (!millLinesBB[l] || (millLinesBB[l] & byTypeBB[BAN])) {
             continue;
         }
 
-        const enum Piece pieceType = static_cast<Piece>(board[moveSquare]);
+        patternValue += Eval::LineConfigValue[color_of(board[lineSquares[l][0]]) +
+                                              color_of(board[lineSquares[l][1]]) * 3 +
+                                              color_of(board[lineSquares[l][2]]) * 9];
+    }
 
-        switch (pieceType) {
-        case NO_PIECE:
-            emptyCount++;
-            break;
-        case BAN_STONE:
-            bannedCount++;
-            break;
-        default:
-            if (color_of(pieceType) == sideToMove) {
-                ourPieceCount++;
-            } else {
-                theirPieceCount++;
-            }
-            break;
-        }
+    for (Square s = SQ_BEGIN; s < SQ_END; ++s) {
+        patternValue += square_pattern(s, board[s]);
     }
+
+    return patternValue;
 }
 
+void Position::surrounded_pieces_count(Square s, int &ourPieceCount, int &theirPieceCount, int &bannedCount, int &emptyCount) const
+{
+    const Bitboard adjacent = MoveList<LEGAL>::adjacentSquaresBB[s];
+
+    ourPieceCount += popcount(adjacent & byColorBB[sideToMove]);
+    theirPieceCount += popcount(adjacent & byColorBB[~sideToMove]);
+    bannedCount += popcount(adjacent & byTypeBB[BAN]);
+    emptyCount += popcount(adjacent & ~byTypeBB[ALL_PIECES]);
+}
+
+template<class R>
 bool Position::is_all_surrounded(Color c
 #ifdef MADWEASEL_MUEHLE_RULE
                                  , Square from, Square to
@@ -1301,11 +1656,19 @@ bool Position::is_all_surrounded(Color c
         return true;
 
     // Can fly
-    if (pieceOnBoardCount[c] <= rule.flyPieceCount &&
-        rule.mayFly) {
+    if (pieceOnBoardCount[c] <= R::rule.flyPieceCount &&
+        R::rule.mayFly) {
         return false;
     }
 
+#ifndef MADWEASEL_MUEHLE_RULE
+    // Ban stones block a square but count as free in the mobility counts,
+    // they are only on the board in the placing phase though.
+    if (!byTypeBB[BAN]) {
+        return mobility[c] == 0;
+    }
+#endif // !MADWEASEL_MUEHLE_RULE
+
     Bitboard bb = byTypeBB[ALL_PIECES];
 
 #ifdef MADWEASEL_MUEHLE_RULE
@@ -1323,6 +1686,24 @@ bool Position::is_all_surrounded(Color c
     return true;
 }
 
+#ifdef MADWEASEL_MUEHLE_RULE
+#define IS_ALL_SURROUNDED_ARGS Color c, Square from, Square to
+#else
+#define IS_ALL_SURROUNDED_ARGS Color c
+#endif // MADWEASEL_MUEHLE_RULE
+
+#define INSTANTIATE_POSITION(R) \
+    template void Position::do_move<R>(Move m); \
+    template bool Position::put_piece<R>(Square s, bool updateRecord); \
+    template bool Position::remove_piece<R>(Square s, bool updateRecord); \
+    template bool Position::check_if_game_is_over<R>(); \
+    template bool Position::is_all_surrounded<R>(IS_ALL_SURROUNDED_ARGS) const;
+
+FOR_EACH_RULE_VARIANT(INSTANTIATE_POSITION)
+
+#undef INSTANTIATE_POSITION
+#undef IS_ALL_SURROUNDED_ARGS
+
 bool Position::is_star_square(Square s)
 {
     if (rule.hasDiagonalLines == true) {
@@ -1383,37 +1764,26 @@ void Position::reset_bb()
     }
 }
 
+/// Position::updateMobility() updates the mobility counts when a piece has
+/// just been put on or taken from square s. The counts are kept even when
+/// mobility is not evaluated, since is_all_surrounded() relies on them.
+
 void Position::updateMobility(MoveType mt, Square s)
 {
-    if (!gameOptions.getConsiderMobility()) {
-        return;
-    }
-
-    Bitboard adjacentWhiteBB = byColorBB[WHITE] & MoveList<LEGAL>::adjacentSquaresBB[s];
-    Bitboard adjacentBlackBB = byColorBB[BLACK] & MoveList<LEGAL>::adjacentSquaresBB[s];
-    Bitboard adjacentNoColorBB = (~(byColorBB[BLACK] | byColorBB[WHITE])) & MoveList<LEGAL>::adjacentSquaresBB[s];
-    int adjacentWhiteBBCount = popcount(adjacentWhiteBB);
-    int adjacentBlackBBCount = popcount(adjacentBlackBB);
-    int adjacentNoColorBBCount = popcount(adjacentNoColorBB);
+    const Bitboard adjacent = MoveList<LEGAL>::adjacentSquaresBB[s];
+    const int adjacentWhiteCount = popcount(byColorBB[WHITE] & adjacent);
+    const int adjacentBlackCount = popcount(byColorBB[BLACK] & adjacent);
+    const int adjacentFreeCount = popcount(adjacent) - adjacentWhiteCount - adjacentBlackCount;
 
     if (mt == MOVETYPE_PLACE) {
-        mobilityDiff -= adjacentWhiteBBCount;
-        mobilityDiff += adjacentBlackBBCount;
-
-        if (side_to_move() == WHITE) {
-            mobilityDiff += adjacentNoColorBBCount;
-        } else {
-            mobilityDiff -= adjacentNoColorBBCount;
-        }
+        // The neighbours lose square s, the piece gains its free neighbours
+        mobility[WHITE] -= adjacentWhiteCount;
+        mobility[BLACK] -= adjacentBlackCount;
+        mobility[sideToMove] += adjacentFreeCount;
     } else if (mt == MOVETYPE_REMOVE) {
-        mobilityDiff += adjacentWhiteBBCount;
-        mobilityDiff -= adjacentBlackBBCount;
-
-        if ( color_of(board[s]) == WHITE) {
-            mobilityDiff -= adjacentNoColorBBCount;
-        } else {
-            mobilityDiff += adjacentNoColorBBCount;
-        }
+        mobility[WHITE] += adjacentWhiteCount;
+        mobility[BLACK] += adjacentBlackCount;
+        mobility[color_of(board[s])] -= adjacentFreeCount;
     } else {
         assert(0);
     }
@@ -29,10 +29,18 @@
 #include "rule.h"
 #include "stack.h"
 
+#include "nnue/nnue_architecture.h"
+
 /// StateInfo struct stores information needed to restore a Position object to
 /// its previous state when we retract a move. Whenever a move is made on the
 /// board (by calling Position::do_move), a StateInfo object must be passed.
 
+#ifdef SYMMETRY_KEY_ENABLE
+/// The board has 16 symmetries: 4 rotations, optionally mirrored, optionally
+/// with the inner and outer rings swapped. Symmetry 0 is the identity.
+constexpr int SYMMETRY_NB = 16;
+#endif // SYMMETRY_KEY_ENABLE
+
 struct StateInfo
 {
     // Copied when making a move
@@ -41,6 +49,9 @@ struct StateInfo
 
     // Not copied when making a move (will be recomputed anyhow)
     Key key;
+#ifdef SYMMETRY_KEY_ENABLE
+    Key symmetryKey[SYMMETRY_NB];   // Board part of the key of each symmetric image
+#endif // SYMMETRY_KEY_ENABLE
 };
 
 
@@ -75,16 +86,27 @@ public:
     Piece moved_piece(Move m) const;
 
     // Doing and undoing moves
-    void do_move(Move m);
+    template<class R = CustomRule> void do_move(Move m);
     void undo_move(Sanmill::Stack<Position> &ss);
 
     // Accessing hash keys
     Key key() const noexcept;
     Key key_after(Move m) const;
     void construct_key();
+    Key compute_key() const;
+#ifdef SYMMETRY_KEY_ENABLE
+    void compute_symmetry_keys(Key keys[SYMMETRY_NB]) const;
+#endif // SYMMETRY_KEY_ENABLE
+    bool key_is_ok() const;
     Key revert_key(Square s);
     Key update_key(Square s);
     Key update_key_misc();
+#ifdef SYMMETRY_KEY_ENABLE
+    Key canonical_key() const;
+    Key canonical_key(int &sym) const;
+    Key canonical_key_after(Move m) const;
+    static Move transform_move(Move m, int sym, bool inverse = false);
+#endif // SYMMETRY_KEY_ENABLE
 
     // Other properties of the position
     Color side_to_move() const;
@@ -98,6 +120,8 @@ public:
     /// Mill Game
 
     Piece *get_board() noexcept;
+    Bitboard pieces() const;
+    Bitboard pieces(Color c) const;
     Square current_square() const;
     enum Phase get_phase() const;
     enum Action get_action() const;
@@ -108,11 +132,13 @@ public:
     bool resign(Color loser);
     bool command(const char *cmd);
     void update_score();
-    bool check_if_game_is_over();
+    template<class R = CustomRule> bool check_if_game_is_over();
     void remove_ban_stones();
     void set_side_to_move(Color c);
 
     void change_side_to_move();
+    void change_phase(Phase p);
+    void change_piece_in_hand_count(Color c, int delta);
     Color get_winner() const noexcept;
     void set_gameover(Color w, GameOverReason reason);
 
@@ -123,13 +149,16 @@ public:
     void reset_bb();
 
     void create_mill_table();
-    int mills_count(Square s);
+    int mills_count(Square s) const;
 
     // The number of mills that would be closed by the given move.
-    int potential_mills_count(Square to, Color c, Square from = SQ_0);
-    bool is_all_in_mills(Color c);
+    int potential_mills_count(Square to, Color c, Square from = SQ_0) const;
+    Bitboard pieces_in_mills(Color c) const;
+    Bitboard mill_closing_squares(Color c) const;
+    bool is_all_in_mills(Color c) const;
 
-    void surrounded_pieces_count(Square s, int &ourPieceCount, int &theirPieceCount, int &bannedCount, int &emptyCount);
+    void surrounded_pieces_count(Square s, int &ourPieceCount, int &theirPieceCount, int &bannedCount, int &emptyCount) const;
+    template<class R = CustomRule>
     bool is_all_surrounded(Color c
 #ifdef MADWEASEL_MUEHLE_RULE
                            , Square from = SQ_0, Square to = SQ_0
@@ -144,6 +173,12 @@ public:
     int piece_to_remove_count() const;
 
     int get_mobility_diff() const;
+    int mobility_count(Color c) const;
+    int pattern_value() const;
+    void update_pattern(Square s, Piece before, Piece after);
+    void update_accumulator(Square s, Piece before, Piece after);
+    int calculate_pattern_value();
+    static int square_pattern(Square s, Piece pc);
     void updateMobility(MoveType mt, Square s);
     //template <typename Mt> void updateMobility(Square from, Square to);
     int calculate_mobility_diff();
@@ -160,13 +195,13 @@ public:
 
     void put_piece(Piece pc, Square s);
     bool put_piece(File f, Rank r);
-    bool put_piece(Square s, bool updateRecord = false);
+    template<class R = CustomRule> bool put_piece(Square s, bool updateRecord = false);
 
     bool remove_piece(File f, Rank r);
-    bool remove_piece(Square s, bool updateRecord = false);
+    template<class R = CustomRule> bool remove_piece(Square s, bool updateRecord = false);
 
     bool move_piece(File f1, Rank r1, File f2, Rank r2);
-    bool move_piece(Square from, Square to);
+    template<class R = CustomRule> bool move_piece(Square from, Square to);
 
     // Data members
     Piece board[SQUARE_NB];
@@ -175,7 +210,23 @@ public:
     int pieceInHandCount[COLOR_NB] { 0, 9, 9 };
     int pieceOnBoardCount[COLOR_NB] { 0, 0, 0 };
     int pieceToRemoveCount{ 0 };
-    int mobilityDiff { 0 };
+
+    // Number of (piece, free adjacent square) pairs of each color. Updated by
+    // updateMobility() on every change of the board, and restored on undo
+    // together with the rest of the position.
+    int mobility[COLOR_NB] { 0 };
+
+    // Sum of the pattern tables of Eval over all mill lines and pieces, from
+    // WHITE's point of view. Updated by update_pattern() on every change of
+    // the board while the pattern is evaluated.
+    int patternValue { 0 };
+
+#ifdef NNUE_ENABLE
+    // Output of the first layer of the network, maintained while the NNUE
+    // evaluation is used
+    Eval::NNUE::Accumulator accumulator;
+#endif // NNUE_ENABLE
+
     int gamePly { 0 };
     Color sideToMove { NOCOLOR };
     Thread *thisThread {nullptr};
@@ -195,6 +246,16 @@ public:
     // Relate to Rule
     static Bitboard millTableBB[SQUARE_NB][LD_NB];
 
+    static constexpr int MILL_LINE_NB = 20;
+    static Bitboard millLinesBB[MILL_LINE_NB];
+    static int squareLines[SQUARE_NB][LD_NB];       // Indices into millLinesBB, -1 if none
+    static Square lineSquares[MILL_LINE_NB][3];     // Squares of each line in increasing order
+
+#ifdef SYMMETRY_KEY_ENABLE
+    static Square symmetrySquare[SYMMETRY_NB][SQUARE_NB];
+    static Square inverseSymmetrySquare[SYMMETRY_NB][SQUARE_NB];
+#endif // SYMMETRY_KEY_ENABLE
+
     Square currentSquare;
     int gamesPlayedCount { 0 };
 
@@ -243,11 +304,34 @@ inline Key Position::key() const noexcept
     return st.key;
 }
 
-inline void Position::construct_key()
+#ifdef SYMMETRY_KEY_ENABLE
+/// Position::canonical_key() returns the smallest key among the symmetric
+/// images of the position, and the symmetry which maps the position to it.
+/// Side to move and the other non-board parts of the key are invariant.
+
+inline Key Position::canonical_key(int &sym) const
 {
-    st.key = 0;
+    Key k = st.symmetryKey[0];
+    sym = 0;
+
+    for (int i = 1; i < SYMMETRY_NB; i++) {
+        if (st.symmetryKey[i] < k) {
+            k = st.symmetryKey[i];
+            sym = i;
+        }
+    }
+
+    return k ^ st.key ^ st.symmetryKey[0];
 }
 
+inline Key Position::canonical_key() const
+{
+    int sym;
+
+    return canonical_key(sym);
+}
+#endif // SYMMETRY_KEY_ENABLE
+
 inline int Position::game_ply() const
 {
     return gamePly;
@@ -294,10 +378,11 @@ inline bool Position::remove_piece(File f, Rank r)
     return ret;
 }
 
+template<class R>
 inline bool Position::move_piece(Square from, Square to)
 {
     if (select_piece(from)) {
-        if (put_piece(to)) {
+        if (put_piece<R>(to)) {
             return true;
         }
     }
@@ -313,6 +398,16 @@ inline Piece *Position::get_board() noexcept
     return static_cast<Piece *>(board);
 }
 
+inline Bitboard Position::pieces() const
+{
+    return byTypeBB[ALL_PIECES];
+}
+
+inline Bitboard Position::pieces(Color c) const
+{
+    return byColorBB[c];
+}
+
 inline Square Position::current_square() const
 {
     return currentSquare;
@@ -350,7 +445,17 @@ inline int Position::piece_to_remove_count() const
 
 inline int Position::get_mobility_diff() const
 {
-    return mobilityDiff;
+    return mobility[WHITE] - mobility[BLACK];
+}
+
+inline int Position::mobility_count(Color c) const
+{
+    return mobility[c];
+}
+
+inline int Position::pattern_value() const
+{
+    return patternValue;
 }
 
 inline bool Position::is_three_endgame() const
@@ -42,130 +42,6 @@ struct Rule rule = {
         true        // 三次重复局面和
 };
 
-const struct Rule RULES[N_RULES] = {
-    {
-        "成三棋",   // 成三棋
-        // 规则说明
-        "1. 双方各9颗子，开局依次摆子；\n"
-        "2. 凡出现三子相连，就提掉对手一子；\n"
-        "3. 不能提对手的“三连”子，除非无子可提；\n"
-        "4. 同时出现两个“三连”只能提一子；\n"
-        "5. 摆完后依次走子，每次只能往相邻位置走一步；\n"
-        "6. 把对手棋子提到少于3颗时胜利；\n"
-        "7. 走棋阶段不能行动（被“闷”）算负。",
-        9,          // 双方各9子
-        3,          // 飞子条件为剩余3颗子
-        3,          // 赛点子数为3
-        false,      // 没有斜线
-        false,      // 没有禁点，摆棋阶段被提子的点可以再摆子
-        false,      // Lasker Morris
-        false,      // 先摆棋者先行棋
-        false,      // 多个“三连”只能提一子
-        false,      // 不能提对手的“三连”子，除非无子可提；
-        false,      // 摆子阶段不移除对方未摆的棋子；
-        true,       // 摆棋满子（闷棋，只有12子棋才出现）算先手负
-        true,       // 走棋阶段不能行动（被“闷”）算负
-        false,      // 剩三子时不可以飞棋
-        100,        // 连续多少步未吃子则和棋
-        100,        // 一方只剩3枚棋子时连续多少步未吃子则和棋
-        true        // 三次重复局面和
-    },
-    {
-        "打三棋(12连棋)",           // 打三棋
-        // 规则说明
-        "1. 双方各12颗子，棋盘有斜线；\n"
-        "2. 摆棋阶段被提子的位置不能再摆子，直到走棋阶段；\n"
-        "3. 摆棋阶段，摆满棋盘算先手负；\n"
-        "4. 走棋阶段，后摆棋的一方先走；\n"
-        "5. 同时出现两个“三连”只能提一子；\n"
-        "6. 其它规则与成三棋基本相同。",
-        12,         // 双方各12子
-        3,          // 飞子条件为剩余3颗子
-        3,          // 赛点子数为3
-        true,       // 有斜线
-        true,       // 有禁点，摆棋阶段被提子的点不能再摆子
-        false,      // Lasker Morris
-        true,       // 后摆棋者先行棋
-        false,      // 多个“三连”只能提一子
-        true,       // 可以提对手的“三连”子
-        false,      // 摆子阶段不移除对方未摆的棋子；
-        true,       // 摆棋满子（闷棋，只有12子棋才出现）算先手负
-        true,       // 走棋阶段不能行动（被“闷”）算负
-        false,      // 剩三子时不可以飞棋
-        100,        // 连续多少步未吃子则和棋
-        100,        // 一方只剩3枚棋子时连续多少步未吃子则和棋
-        true        // 三次重复局面和
-    },
-    {
-        "Nine men's morris",      // 莫里斯九子棋
-        // 规则说明
-        "规则与成三棋基本相同，只是在走子阶段，当一方仅剩3子时，他可以飞子到任意空位。",
-        9,          // 双方各9子
-        3,          // 飞子条件为剩余3颗子
-        3,          // 赛点子数为3
-        false,      // 没有斜线
-        false,      // 没有禁点，摆棋阶段被提子的点可以再摆子
-        false,      // Lasker Morris
-        false,      // 先摆棋者先行棋
-        false,      // 多个“三连”只能提一子
-        false,      // 不能提对手的“三连”子，除非无子可提；
-        false,      // 摆子阶段不移除对方未摆的棋子；
-        true,       // 摆棋满子（闷棋，只有12子棋才出现）算先手负
-        true,       // 走棋阶段不能行动（被“闷”）算负
-        true,       // 剩三子时可以飞棋
-        100,        // 连续多少步未吃子则和棋
-        100,        // 一方只剩3枚棋子时连续多少步未吃子则和棋
-        true        // 三次重复局面和
-    },
-    {
-        "Twelve men's morris",      // 莫里斯十二子棋
-        // 规则说明
-        "1. 双方各12颗子，棋盘有斜线；\n"
-        "2. 摆棋阶段被提子的位置不能再摆子，直到走棋阶段；\n"
-        "3. 摆棋阶段，摆满棋盘算先手负；\n"
-        "4. 走棋阶段，后摆棋的一方先走；\n"
-        "5. 同时出现两个“三连”只能提一子；\n"
-        "6. 其它规则与成三棋基本相同。",
-        12,         // 双方各12子
-        3,          // 飞子条件为剩余3颗子
-        3,          // 赛点子数为3
-        true,       // 有斜线
-        false,      // 没有禁点，摆棋阶段被提子的点可以再摆子
-        false,      // Lasker Morris
-        false,      // 先摆棋者先行棋
-        false,      // 多个“三连”只能提一子
-        false,      // 不能提对手的“三连”子，除非无子可提；
-        false,      // 摆子阶段不移除对方未摆的棋子；
-        true,       // 摆棋满子（闷棋，只有12子棋才出现）算先手负
-        true,       // 走棋阶段不能行动（被“闷”）算负
-        true,       // 剩三子时可以飞棋
-        100,        // 连续多少步未吃子则和棋
-        100,        // 一方只剩3枚棋子时连续多少步未吃子则和棋
-        true        // 三次重复局面和
-    },
-    {
-        "Lasker Morris",      // 莫里斯九子棋
-        // 规则说明
-        "规则与成三棋基本相同，只是在走子阶段，当一方仅剩3子时，他可以飞子到任意空位。",
-        10,         // 双方各9子
-        3,          // 飞子条件为剩余3颗子
-        3,          // 赛点子数为3
-        false,      // 没有斜线
-        false,      // 没有禁点，摆棋阶段被提子的点可以再摆子
-        true,       // Lasker Morris
-        false,      // 先摆棋者先行棋
-        false,      // 多个“三连”只能提一子
-        false,      // 不能提对手的“三连”子，除非无子可提；
-        false,      // 摆子阶段不移除对方未摆的棋子；
-        true,       // 摆棋满子（闷棋，只有12子棋才出现）算先手负
-        true,       // 走棋阶段不能行动（被“闷”）算负
-        true,       // 剩三子时可以飞棋
-        100,        // 连续多少步未吃子则和棋
-        100,        // 一方只剩3枚棋子时连续多少步未吃子则和棋
-        true        // 三次重复局面和
-    }
-};
-
 bool set_rule(int ruleIdx) noexcept
 {
     if (ruleIdx <= 0 || ruleIdx >= N_RULES) {
@@ -177,3 +53,28 @@ bool set_rule(int ruleIdx) noexcept
 
     return true;
 }
+
+int rule_variant() noexcept
+{
+    for (int i = 0; i < N_RULES; i++) {
+        const Rule &r = RULES[i];
+
+        if (rule.piecesCount == r.piecesCount &&
+            rule.flyPieceCount == r.flyPieceCount &&
+            rule.piecesAtLeastCount == r.piecesAtLeastCount &&
+            rule.hasDiagonalLines == r.hasDiagonalLines &&
+            rule.hasBannedLocations == r.hasBannedLocations &&
+            rule.mayMoveInPlacingPhase == r.mayMoveInPlacingPhase &&
+            rule.isDefenderMoveFirst == r.isDefenderMoveFirst &&
+            rule.mayRemoveMultiple == r.mayRemoveMultiple &&
+            rule.mayRemoveFromMillsAlways == r.mayRemoveFromMillsAlways &&
+            rule.mayOnlyRemoveUnplacedPieceInPlacingPhase == r.mayOnlyRemoveUnplacedPieceInPlacingPhase &&
+            rule.isWhiteLoseButNotDrawWhenBoardFull == r.isWhiteLoseButNotDrawWhenBoardFull &&
+            rule.isLoseButNotChangeSideWhenNoWay == r.isLoseButNotChangeSideWhenNoWay &&
+            rule.mayFly == r.mayFly) {
+            return i;
+        }
+    }
+
+    return CUSTOM_RULE;
+}
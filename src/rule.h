@@ -84,8 +84,162 @@ struct Rule
 };
 
 #define N_RULES 5
-extern const struct Rule RULES[N_RULES];
+
+inline constexpr struct Rule RULES[N_RULES] = {
+    {
+        "成三棋",   // 成三棋
+        // 规则说明
+        "1. 双方各9颗子，开局依次摆子；\n"
+        "2. 凡出现三子相连，就提掉对手一子；\n"
+        "3. 不能提对手的“三连”子，除非无子可提；\n"
+        "4. 同时出现两个“三连”只能提一子；\n"
+        "5. 摆完后依次走子，每次只能往相邻位置走一步；\n"
+        "6. 把对手棋子提到少于3颗时胜利；\n"
+        "7. 走棋阶段不能行动（被“闷”）算负。",
+        9,          // 双方各9子
+        3,          // 飞子条件为剩余3颗子
+        3,          // 赛点子数为3
+        false,      // 没有斜线
+        false,      // 没有禁点，摆棋阶段被提子的点可以再摆子
+        false,      // Lasker Morris
+        false,      // 先摆棋者先行棋
+        false,      // 多个“三连”只能提一子
+        false,      // 不能提对手的“三连”子，除非无子可提；
+        false,      // 摆子阶段不移除对方未摆的棋子；
+        true,       // 摆棋满子（闷棋，只有12子棋才出现）算先手负
+        true,       // 走棋阶段不能行动（被“闷”）算负
+        false,      // 剩三子时不可以飞棋
+        100,        // 连续多少步未吃子则和棋
+        100,        // 一方只剩3枚棋子时连续多少步未吃子则和棋
+        true        // 三次重复局面和
+    },
+    {
+        "打三棋(12连棋)",           // 打三棋
+        // 规则说明
+        "1. 双方各12颗子，棋盘有斜线；\n"
+        "2. 摆棋阶段被提子的位置不能再摆子，直到走棋阶段；\n"
+        "3. 摆棋阶段，摆满棋盘算先手负；\n"
+        "4. 走棋阶段，后摆棋的一方先走；\n"
+        "5. 同时出现两个“三连”只能提一子；\n"
+        "6. 其它规则与成三棋基本相同。",
+        12,         // 双方各12子
+        3,          // 飞子条件为剩余3颗子
+        3,          // 赛点子数为3
+        true,       // 有斜线
+        true,       // 有禁点，摆棋阶段被提子的点不能再摆子
+        false,      // Lasker Morris
+        true,       // 后摆棋者先行棋
+        false,      // 多个“三连”只能提一子
+        true,       // 可以提对手的“三连”子
+        false,      // 摆子阶段不移除对方未摆的棋子；
+        true,       // 摆棋满子（闷棋，只有12子棋才出现）算先手负
+        true,       // 走棋阶段不能行动（被“闷”）算负
+        false,      // 剩三子时不可以飞棋
+        100,        // 连续多少步未吃子则和棋
+        100,        // 一方只剩3枚棋子时连续多少步未吃子则和棋
+        true        // 三次重复局面和
+    },
+    {
+        "Nine men's morris",      // 莫里斯九子棋
+        // 规则说明
+        "规则与成三棋基本相同，只是在走子阶段，当一方仅剩3子时，他可以飞子到任意空位。",
+        9,          // 双方各9子
+        3,          // 飞子条件为剩余3颗子
+        3,          // 赛点子数为3
+        false,      // 没有斜线
+        false,      // 没有禁点，摆棋阶段被提子的点可以再摆子
+        false,      // Lasker Morris
+        false,      // 先摆棋者先行棋
+        false,      // 多个“三连”只能提一子
+        false,      // 不能提对手的“三连”子，除非无子可提；
+        false,      // 摆子阶段不移除对方未摆的棋子；
+        true,       // 摆棋满子（闷棋，只有12子棋才出现）算先手负
+        true,       // 走棋阶段不能行动（被“闷”）算负
+        true,       // 剩三子时可以飞棋
+        100,        // 连续多少步未吃子则和棋
+        100,        // 一方只剩3枚棋子时连续多少步未吃子则和棋
+        true        // 三次重复局面和
+    },
+    {
+        "Twelve men's morris",      // 莫里斯十二子棋
+        // 规则说明
+        "1. 双方各12颗子，棋盘有斜线；\n"
+        "2. 摆棋阶段被提子的位置不能再摆子，直到走棋阶段；\n"
+        "3. 摆棋阶段，摆满棋盘算先手负；\n"
+        "4. 走棋阶段，后摆棋的一方先走；\n"
+        "5. 同时出现两个“三连”只能提一子；\n"
+        "6. 其它规则与成三棋基本相同。",
+        12,         // 双方各12子
+        3,          // 飞子条件为剩余3颗子
+        3,          // 赛点子数为3
+        true,       // 有斜线
+        false,      // 没有禁点，摆棋阶段被提子的点可以再摆子
+        false,      // Lasker Morris
+        false,      // 先摆棋者先行棋
+        false,      // 多个“三连”只能提一子
+        false,      // 不能提对手的“三连”子，除非无子可提；
+        false,      // 摆子阶段不移除对方未摆的棋子；
+        true,       // 摆棋满子（闷棋，只有12子棋才出现）算先手负
+        true,       // 走棋阶段不能行动（被“闷”）算负
+        true,       // 剩三子时可以飞棋
+        100,        // 连续多少步未吃子则和棋
+        100,        // 一方只剩3枚棋子时连续多少步未吃子则和棋
+        true        // 三次重复局面和
+    },
+    {
+        "Lasker Morris",      // 莫里斯九子棋
+        // 规则说明
+        "规则与成三棋基本相同，只是在走子阶段，当一方仅剩3子时，他可以飞子到任意空位。",
+        10,         // 双方各9子
+        3,          // 飞子条件为剩余3颗子
+        3,          // 赛点子数为3
+        false,      // 没有斜线
+        false,      // 没有禁点，摆棋阶段被提子的点可以再摆子
+        true,       // Lasker Morris
+        false,      // 先摆棋者先行棋
+        false,      // 多个“三连”只能提一子
+        false,      // 不能提对手的“三连”子，除非无子可提；
+        false,      // 摆子阶段不移除对方未摆的棋子；
+        true,       // 摆棋满子（闷棋，只有12子棋才出现）算先手负
+        true,       // 走棋阶段不能行动（被“闷”）算负
+        true,       // 剩三子时可以飞棋
+        100,        // 连续多少步未吃子则和棋
+        100,        // 一方只剩3枚棋子时连续多少步未吃子则和棋
+        true        // 三次重复局面和
+    }
+};
+
 extern struct Rule rule;
 extern bool set_rule(int ruleIdx) noexcept;
 
+/// RuleVariant<N> lets the search hot path be instantiated once per built-in
+/// rule. In code templated on R, R::rule.field is a compile-time constant for
+/// the variants in RULES[], so rule-dependent branches fold away. The last
+/// variant, CUSTOM_RULE, reads the runtime rule and serves customised rules.
+constexpr int CUSTOM_RULE = N_RULES;
+
+template<int N>
+struct RuleVariant
+{
+    static constexpr const Rule &rule = RULES[N];
+};
+
+template<>
+struct RuleVariant<CUSTOM_RULE>
+{
+    static constexpr const Rule &rule = ::rule;
+};
+
+using CustomRule = RuleVariant<CUSTOM_RULE>;
+
+static_assert(N_RULES == 5, "FOR_EACH_RULE_VARIANT must list every built-in rule");
+
+#define FOR_EACH_RULE_VARIANT(X) \
+    X(RuleVariant<0>) X(RuleVariant<1>) X(RuleVariant<2>) \
+    X(RuleVariant<3>) X(RuleVariant<4>) X(CustomRule)
+
+/// rule_variant() returns the index of the built-in rule whose hot-path fields
+/// match the current rule, or CUSTOM_RULE if none does.
+extern int rule_variant() noexcept;
+
 #endif /* RULE_H */
@@ -20,17 +20,45 @@
 #include "thread.h"
 //#include "uci.h"
 
+#include "nnue/evaluate_nnue.h"
+
 #include "endgame.h"
 #include "option.h"
+#include "tune.h"
+#include "uci.h"
+
+#ifdef PERFECT_DATABASE_PROBE_ENABLE
+#include "perfect/perfect.h"
+#endif
 
 using std::string;
 using Eval::evaluate;
 using namespace Search;
 
+template<class R>
 Value MTDF(Position *pos, Sanmill::Stack<Position> &ss, Value firstguess, Depth depth, Depth originDepth, Move &bestMove);
 
+template<class R>
 Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth, Depth originDepth, Value alpha, Value beta, Move &bestMove);
 
+namespace
+{
+
+// The searchers instantiated for each rule variant, indexed by rule_variant()
+typedef Value (*MTDFFn)(Position *, Sanmill::Stack<Position> &, Value, Depth, Depth, Move &);
+typedef Value (*QSearchFn)(Position *, Sanmill::Stack<Position> &, Depth, Depth, Value, Value, Move &);
+
+#define MTDF_OF(R) MTDF<R>,
+#define QSEARCH_OF(R) qsearch<R>,
+
+constexpr MTDFFn MTDFs[] = { FOR_EACH_RULE_VARIANT(MTDF_OF) };
+constexpr QSearchFn QSearches[] = { FOR_EACH_RULE_VARIANT(QSEARCH_OF) };
+
+#undef MTDF_OF
+#undef QSEARCH_OF
+
+} // namespace
+
 bool is_timeout(TimePoint startTime);
 
 /// Search::init() is called at startup
@@ -54,6 +82,55 @@ void Search::clear()
 }
 
 
+namespace
+{
+
+// perft() is our utility to verify move generation. All the leaf nodes up
+// to the given depth are generated and counted, and the sum is returned.
+// A finished game has no moves and contributes no nodes.
+template<bool Root>
+uint64_t perft(Position *pos, Sanmill::Stack<Position> &ss, Depth depth)
+{
+    uint64_t cnt, nodes = 0;
+
+    if (pos->get_phase() == Phase::gameOver) {
+        return 0;
+    }
+
+    for (const auto &m : MoveList<LEGAL>(*pos)) {
+        if (depth <= 1) {
+            cnt = 1;
+        } else {
+            ss.push(*pos);
+            pos->do_move(m);
+            cnt = perft<false>(pos, ss, depth - 1);
+            pos->undo_move(ss);
+        }
+
+        nodes += cnt;
+
+        if (Root) {
+            sync_cout << UCI::move(m) << ": " << cnt << sync_endl;
+        }
+    }
+
+    return nodes;
+}
+
+} // namespace
+
+
+/// Search::perft() counts the leaf nodes of the move generation tree of the
+/// given depth, printing the count below each root move ("divide").
+
+uint64_t Search::perft(Position *pos, Depth depth)
+{
+    Sanmill::Stack<Position> ss;
+
+    return ::perft<true>(pos, ss, depth);
+}
+
+
 /// Thread::search() is the main iterative deepening loop. It calls search()
 /// repeatedly with increasing depth until the allocated thinking time has been
 /// consumed, the user stops the search, or the maximum search depth is reached.
@@ -63,6 +140,9 @@ int Thread::search()
     Sanmill::Stack<Position> ss;
 
     Value value = VALUE_ZERO;
+
+    // Pick the search specialised for the current rule once per search
+    const int variant = rule_variant();
     Depth d = get_depth();
 
     if (gameOptions.getAiIsLazy()) {
@@ -123,6 +203,25 @@ int Thread::search()
         rootPos->st.rule50 = (unsigned int)posKeyHistory.size();
     }
 
+#ifdef PERFECT_DATABASE_PROBE_ENABLE
+    // The probes only read layers in memory, so load the reachable ones now
+    if (gameOptions.getPerfectDatabaseProbeEnabled()) {
+        perfect_prefetch(*rootPos);
+    }
+#endif // PERFECT_DATABASE_PROBE_ENABLE
+
+
+    // The pattern value and the accumulator of the network are not kept up
+    // to date while they are not used
+    if (gameOptions.getConsiderPattern()) {
+        rootPos->calculate_pattern_value();
+    }
+
+#ifdef NNUE_ENABLE
+    if (Eval::useNNUE) {
+        Eval::NNUE::refresh_accumulator(*rootPos, rootPos->accumulator);
+    }
+#endif // NNUE_ENABLE
 
     MoveList<LEGAL>::shuffle();
 
@@ -160,9 +259,9 @@ int Thread::search()
 
             if (gameOptions.getAlgorithm() == 2 /* MTD(f) */) {
                 //loggerDebug("Algorithm: MTD(f).\n");
-                value = MTDF(rootPos, ss, value, i, i, bestMove);
+                value = MTDFs[variant](rootPos, ss, value, i, i, bestMove);
             } else {
-                value = qsearch(rootPos, ss, i, i, alpha, beta, bestMove);
+                value = QSearches[variant](rootPos, ss, i, i, alpha, beta, bestMove);
             }
 
             loggerDebug("%d(%d) ", value, value - lastValue);
@@ -193,9 +292,9 @@ int Thread::search()
     }
 
     if (gameOptions.getAlgorithm() == 2 /* MTD(f) */) {
-        value = MTDF(rootPos, ss, value, originDepth, originDepth, bestMove);
+        value = MTDFs[variant](rootPos, ss, value, originDepth, originDepth, bestMove);
     } else {
-        value = qsearch(rootPos, ss, d, originDepth, alpha, beta, bestMove);
+        value = QSearches[variant](rootPos, ss, d, originDepth, alpha, beta, bestMove);
     }
 
 out:
@@ -218,6 +317,83 @@ extern ThreadPool Threads;
 
 vector<Key> posKeyHistory;
 
+#ifdef QUIESCENCE_ENABLE
+
+/// quiescence() searches the leaves of the main search until the position is
+/// quiet: a pending remove is always played out, otherwise the side to move
+/// may stand pat or close a mill. The search below one leaf visits at most
+/// Tune::QuiescenceNodes nodes, after which the static evaluation is used.
+
+template<class R>
+Value quiescence(Position *pos, Sanmill::Stack<Position> &ss, Value alpha, Value beta, int &budget)
+{
+    if (pos->phase == Phase::gameOver ||
+        --budget < 0 ||
+        Threads.stop.load(std::memory_order_relaxed)) {
+        return Eval::evaluate<R>(*pos);
+    }
+
+    const Color us = pos->side_to_move();
+    const bool mustRemove = pos->get_action() == Action::remove;
+    Value bestValue = -VALUE_INFINITE;
+
+    if (!mustRemove) {
+        bestValue = Eval::evaluate<R>(*pos);
+
+        // Most leaves have no mill to close, so look for one before
+        // generating the moves
+        if (bestValue >= beta || !pos->mill_closing_squares(us)) {
+            return bestValue;
+        }
+
+        if (bestValue > alpha) {
+            alpha = bestValue;
+        }
+    }
+
+    ExtMove moves[MAX_MOVES];
+    const ExtMove *end = generate<LEGAL, R>(*pos, moves);
+
+    for (const ExtMove *m = moves; m < end; ++m) {
+        const Move move = m->move;
+
+        if (!mustRemove && !pos->potential_mills_count(to_sq(move), us, from_sq(move))) {
+            continue;
+        }
+
+        ss.push(*pos);
+        pos->do_move<R>(move);
+
+        const Value value = pos->side_to_move() != us ?
+            -quiescence<R>(pos, ss, -beta, -alpha, budget) :
+            quiescence<R>(pos, ss, alpha, beta, budget);
+
+        pos->undo_move(ss);
+
+        if (value > bestValue) {
+            bestValue = value;
+
+            if (value > alpha) {
+                if (value >= beta) {
+                    break;
+                }
+
+                alpha = value;
+            }
+        }
+    }
+
+    // No piece may be removed
+    if (bestValue == -VALUE_INFINITE) {
+        bestValue = Eval::evaluate<R>(*pos);
+    }
+
+    return bestValue;
+}
+
+#endif // QUIESCENCE_ENABLE
+
+template<class R>
 Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth, Depth originDepth, Value alpha, Value beta, Move &bestMove)
 {
     Value value = VALUE_ZERO;
@@ -257,7 +433,16 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth, Depth or
     // Transposition table lookup
 
 #if defined (TRANSPOSITION_TABLE_ENABLE) || defined(ENDGAME_LEARNING)
+#ifdef SYMMETRY_KEY_ENABLE
+#ifdef TT_MOVE_ENABLE
+    int posSym;
+    const Key posKey = pos->canonical_key(posSym);
+#else
+    const Key posKey = pos->canonical_key();
+#endif // TT_MOVE_ENABLE
+#else
     const Key posKey = pos->key();
+#endif // SYMMETRY_KEY_ENABLE
 #endif
 
 #ifdef ENDGAME_LEARNING
@@ -283,6 +468,50 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth, Depth or
     }
 #endif /* ENDGAME_LEARNING */
 
+    // process leaves
+
+    // Leaves are evaluated before the TT lookup. The evaluation is cheaper
+    // than a probe, which is mostly a cache miss, and leaves are never saved.
+
+    // Check for aborted search
+    // TODO: and immediate draw
+    if (unlikely(pos->phase == Phase::gameOver) ||   // TODO: Deal with hash
+        depth <= 0 ||
+        Threads.stop.load(std::memory_order_relaxed)) {
+#ifdef QUIESCENCE_ENABLE
+        int budget = Tune::QuiescenceNodes;
+        bestValue = quiescence<R>(pos, ss, alpha, beta, budget);
+#else
+        bestValue = Eval::evaluate<R>(*pos);
+#endif // QUIESCENCE_ENABLE
+
+        // For win quickly
+        if (bestValue > 0) {
+            bestValue += depth;
+        } else {
+            bestValue -= depth;
+        }
+
+        return bestValue;
+    }
+
+#ifdef PERFECT_DATABASE_PROBE_ENABLE
+    // An exact value of the database ends the search of this node, but the
+    // root still needs a move
+    if (depth != originDepth &&
+        gameOptions.getPerfectDatabaseProbeEnabled() &&
+        perfect_probe(*pos, bestValue)) {
+        // For win quickly
+        if (bestValue > 0) {
+            bestValue += depth;
+        } else if (bestValue < 0) {
+            bestValue -= depth;
+        }
+
+        return bestValue;
+    }
+#endif // PERFECT_DATABASE_PROBE_ENABLE
+
 #ifdef TRANSPOSITION_TABLE_ENABLE
 
     // check transposition-table
@@ -297,6 +526,11 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth, Depth or
 #endif // TT_MOVE_ENABLE
     );
 
+#if defined(TT_MOVE_ENABLE) && defined(SYMMETRY_KEY_ENABLE)
+    // The TT move is stored relative to the canonical image
+    ttMove = Position::transform_move(ttMove, posSym, true);
+#endif
+
     if (probeVal != VALUE_UNKNOWN) {
 #ifdef TRANSPOSITION_TABLE_DEBUG
         Threads.main()->ttHitCount++;
@@ -314,25 +548,6 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth, Depth or
 
 #endif /* TRANSPOSITION_TABLE_ENABLE */
 
-    // process leaves
-
-    // Check for aborted search
-    // TODO: and immediate draw
-    if (unlikely(pos->phase == Phase::gameOver) ||   // TODO: Deal with hash
-        depth <= 0 ||
-        Threads.stop.load(std::memory_order_relaxed)) {
-        bestValue = Eval::evaluate(*pos);
-
-        // For win quickly
-        if (bestValue > 0) {
-            bestValue += depth;
-        } else {
-            bestValue -= depth;
-        }
-
-        return bestValue;
-    }
-
     // if this isn't the root of the search tree (where we have
     // to pick a move and can't simply return VALUE_DRAW) then check to
     // see if the position is a repeat. if so, we can assume that
@@ -344,8 +559,12 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth, Depth or
 
     // Initialize a MovePicker object for the current position, and prepare
     // to search the moves. 
-    MovePicker mp(*pos);
-    Move nextMove = mp.next_move();
+    MovePicker mp(*pos
+#ifdef TT_MOVE_ENABLE
+                  , ttMove
+#endif // TT_MOVE_ENABLE
+    );
+    Move nextMove = mp.next_move<R>();
     const int moveCount = mp.move_count();
 
     if (moveCount == 1 && depth == originDepth) {
@@ -354,22 +573,15 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth, Depth or
         return bestValue;
     }
 
-#if 0
-    // TODO: Weak
-    if (bestMove != MOVE_NONE) {
-        for (int i = 0; i < moveCount; i++) {
-            if (mp.moves[i].move == bestMove) {    // TODO: need to write value?
-                std::swap(mp.moves[0], mp.moves[i]);
-                break;
-            }
-        }
-    }
-#endif // TT_MOVE_ENABLE
-
 #ifdef TRANSPOSITION_TABLE_ENABLE
 #ifndef DISABLE_PREFETCH
-    for (int i = 0; i < moveCount; i++) {
+    // The children of frontier nodes are leaves, which do not probe the TT
+    for (int i = 0; depth > 1 && i < moveCount; i++) {
+#ifdef SYMMETRY_KEY_ENABLE
+        TranspositionTable::prefetch(pos->canonical_key_after(mp.moves[i].move));
+#else
         TranspositionTable::prefetch(pos->key_after(mp.moves[i].move));
+#endif // SYMMETRY_KEY_ENABLE
     }
 
 #ifdef PREFETCH_DEBUG
@@ -381,13 +593,14 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth, Depth or
 #endif // TRANSPOSITION_TABLE_ENABLE
 
     // Loop through the moves until no moves remain or a beta cutoff occurs
-    for (int i = 0; i < moveCount; i++) {
+    int i = 0;
+
+    for (Move move = nextMove; move != MOVE_NONE; move = mp.next_move<R>(), i++) {
         ss.push(*(pos));
         const Color before = pos->sideToMove;
-        Move move = mp.moves[i].move;
 
         // Make and search the move
-        pos->do_move(move);
+        pos->do_move<R>(move);
         const Color after = pos->sideToMove;
 
         if (gameOptions.getDepthExtension() == true && moveCount == 1) {
@@ -403,23 +616,23 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth, Depth or
 
             if (i == 0) {
                 if (after != before) {
-                    value = -qsearch(pos, ss, depth - 1 + epsilon, originDepth, -beta, -alpha, bestMove);
+                    value = -qsearch<R>(pos, ss, depth - 1 + epsilon, originDepth, -beta, -alpha, bestMove);
                 } else {
-                    value = qsearch(pos, ss, depth - 1 + epsilon, originDepth, alpha, beta, bestMove);
+                    value = qsearch<R>(pos, ss, depth - 1 + epsilon, originDepth, alpha, beta, bestMove);
                 }
             } else {
                 if (after != before) {
-                    value = -qsearch(pos, ss, depth - 1 + epsilon, originDepth, -alpha - VALUE_PVS_WINDOW, -alpha, bestMove);
+                    value = -qsearch<R>(pos, ss, depth - 1 + epsilon, originDepth, -alpha - Tune::PvsWindow, -alpha, bestMove);
 
                     if (value > alpha && value < beta) {
-                        value = -qsearch(pos, ss, depth - 1 + epsilon, originDepth, -beta, -alpha, bestMove);
+                        value = -qsearch<R>(pos, ss, depth - 1 + epsilon, originDepth, -beta, -alpha, bestMove);
                         //assert(value >= alpha && value <= beta);
                     }
                 } else {
-                    value = qsearch(pos, ss, depth - 1 + epsilon, originDepth, alpha, alpha + VALUE_PVS_WINDOW, bestMove);
+                    value = qsearch<R>(pos, ss, depth - 1 + epsilon, originDepth, alpha, alpha + Tune::PvsWindow, bestMove);
 
                     if (value > alpha && value < beta) {
-                        value = qsearch(pos, ss, depth - 1 + epsilon, originDepth, alpha, beta, bestMove);
+                        value = qsearch<R>(pos, ss, depth - 1 + epsilon, originDepth, alpha, beta, bestMove);
                         //assert(value >= alpha && value <= beta);
                     }
                 }
@@ -428,9 +641,9 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth, Depth or
             //loggerDebug("Algorithm: Alpha-Beta.\n");
 
             if (after != before) {
-                value = -qsearch(pos, ss, depth - 1 + epsilon, originDepth, -beta, -alpha, bestMove);
+                value = -qsearch<R>(pos, ss, depth - 1 + epsilon, originDepth, -beta, -alpha, bestMove);
             } else {
-                value = qsearch(pos, ss, depth - 1 + epsilon, originDepth, alpha, beta, bestMove);
+                value = qsearch<R>(pos, ss, depth - 1 + epsilon, originDepth, alpha, beta, bestMove);
             }
         }
 
@@ -469,7 +682,11 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth, Depth or
                              TranspositionTable::boundType(bestValue, oldAlpha, beta),
                              posKey
 #ifdef TT_MOVE_ENABLE
+#ifdef SYMMETRY_KEY_ENABLE
+                             , Position::transform_move(bestMove, posSym)
+#else
                              , bestMove
+#endif // SYMMETRY_KEY_ENABLE
 #endif // TT_MOVE_ENABLE
     );
 #endif /* TRANSPOSITION_TABLE_ENABLE */
@@ -479,6 +696,7 @@ Value qsearch(Position *pos, Sanmill::Stack<Position> &ss, Depth depth, Depth or
     return bestValue;
 }
 
+template<class R>
 Value MTDF(Position *pos, Sanmill::Stack<Position> &ss, Value firstguess, Depth depth, Depth originDepth, Move &bestMove)
 {
     Value g = firstguess;
@@ -488,12 +706,12 @@ Value MTDF(Position *pos, Sanmill::Stack<Position> &ss, Value firstguess, Depth
 
     while (lowerbound < upperbound) {
         if (g == lowerbound) {
-            beta = g + VALUE_MTDF_WINDOW;
+            beta = g + Tune::MtdfWindow;
         } else {
             beta = g;
         }
 
-        g = qsearch(pos, ss, depth, originDepth, beta - VALUE_MTDF_WINDOW, beta, bestMove);
+        g = qsearch<R>(pos, ss, depth, originDepth, beta - Tune::MtdfWindow, beta, bestMove);
 
         if (g < beta) {
             upperbound = g;    // fail low
@@ -29,11 +29,14 @@
 
 using namespace std;
 
+class Position;
+
 namespace Search
 {
 
 void init() noexcept;
 void clear();
+uint64_t perft(Position *pos, Depth depth);
 
 } // namespace Search
 
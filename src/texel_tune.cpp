@@ -0,0 +1,523 @@
+﻿/*
+  This file is part of Sanmill.
+  Copyright (C) 2019-2021 The Sanmill developers (see AUTHORS file)
+
+  Sanmill is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Sanmill is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bitboard.h"
+#include "evaluate.h"
+#include "option.h"
+#include "position.h"
+
+/// Standalone tool that tunes the evaluation weights of types.h on a set of
+/// labelled positions with Texel's method: the static evaluation is mapped to
+/// an expected score by a sigmoid, and the weights are changed one step at a
+/// time while the mean squared error against the game results decreases.
+///
+///   sanmill-tune [-j threads] [-r rule] [-o tuned.h] positions.txt...
+///
+/// Each line of the input holds a FEN string followed by the result of the
+/// game from WHITE's point of view: 1-0, 0-1, 1/2-1/2 or a number in [0, 1].
+
+using std::string;
+using std::vector;
+
+namespace {
+
+// The tuned weights. The evaluation is linear in all of them, so each
+// position is reduced to its feature counts once and the evaluation for any
+// set of weights is a dot product.
+enum Param {
+    EACH_PIECE_INHAND,
+    EACH_PIECE_ONBOARD,
+    EACH_PIECE_PLACING_NEEDREMOVE,
+    EACH_PIECE_MOVING_NEEDREMOVE,
+    MOBILITY,
+    PARAM_NB
+};
+
+constexpr const char *ParamNames[PARAM_NB] = {
+    "VALUE_EACH_PIECE_INHAND",
+    "VALUE_EACH_PIECE_ONBOARD",
+    "VALUE_EACH_PIECE_PLACING_NEEDREMOVE",
+    "VALUE_EACH_PIECE_MOVING_NEEDREMOVE",
+    "MOBILITY_WEIGHT"
+};
+
+// The weights the engine is built with. The mobility difference is added
+// unscaled in the placing phase.
+constexpr int DefaultParams[PARAM_NB] = {
+    VALUE_EACH_PIECE_INHAND,
+    VALUE_EACH_PIECE_ONBOARD,
+    VALUE_EACH_PIECE_PLACING_NEEDREMOVE,
+    VALUE_EACH_PIECE_MOVING_NEEDREMOVE,
+    1
+};
+
+// Every weight must leave the evaluation well inside the int8 Value range
+constexpr int MaxParam = VALUE_EACH_PIECE * 4;
+
+struct Sample
+{
+    int8_t features[PARAM_NB];
+    int8_t fixed;   // the pattern term, which is not tuned
+    float result;
+};
+
+/// ThreadPool runs a function over the index range [0, n) split into one
+/// chunk per worker. The workers are started once and reused for every pass
+/// over the samples.
+
+class ThreadPool
+{
+public:
+    explicit ThreadPool(size_t n)
+    {
+        for (size_t i = 0; i < n; i++) {
+            workers.emplace_back([this, i, n] { idle_loop(i, n); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            exit = true;
+        }
+
+        cv.notify_all();
+
+        for (std::thread &t : workers) {
+            t.join();
+        }
+    }
+
+    size_t size() const
+    {
+        return workers.size();
+    }
+
+    /// for_each() calls job(worker, begin, end) on every worker and returns
+    /// when all of them are done.
+    void for_each(size_t n, const std::function<void(size_t, size_t, size_t)> &f)
+    {
+        std::unique_lock<std::mutex> lk(mutex);
+        job = &f;
+        count = n;
+        pending = workers.size();
+        generation++;
+        cv.notify_all();
+        done.wait(lk, [this] { return pending == 0; });
+        job = nullptr;
+    }
+
+private:
+    void idle_loop(size_t idx, size_t n)
+    {
+        uint64_t seen = 0;
+
+        while (true) {
+            std::unique_lock<std::mutex> lk(mutex);
+            cv.wait(lk, [&] { return exit || generation != seen; });
+
+            if (exit) {
+                return;
+            }
+
+            seen = generation;
+            const auto *f = job;
+            const size_t chunk = (count + n - 1) / n;
+            const size_t begin = std::min(count, idx * chunk);
+            const size_t end = std::min(count, begin + chunk);
+            lk.unlock();
+
+            (*f)(idx, begin, end);
+
+            lk.lock();
+
+            if (--pending == 0) {
+                done.notify_one();
+            }
+        }
+    }
+
+    vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable cv, done;
+    const std::function<void(size_t, size_t, size_t)> *job {nullptr};
+    size_t count {0};
+    size_t pending {0};
+    uint64_t generation {0};
+    bool exit {false};
+};
+
+int usage()
+{
+    std::cerr << "Usage: sanmill-tune [-j threads] [-r rule] [-o tuned.h] positions..." << std::endl;
+    return EXIT_FAILURE;
+}
+
+bool parse_result(const string &token, float &result)
+{
+    if (token == "1-0") {
+        result = 1.0f;
+    } else if (token == "0-1") {
+        result = 0.0f;
+    } else if (token == "1/2-1/2") {
+        result = 0.5f;
+    } else {
+        char *end = nullptr;
+        result = std::strtof(token.c_str(), &end);
+
+        if (end == token.c_str() || *end != '\0' || result < 0.0f || result > 1.0f) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/// extract() splits the evaluation of pos into the feature counts of the
+/// tuned weights, from WHITE's point of view, the same way as
+/// Evaluation::value() combines them. Returns false for positions whose value
+/// does not depend on the weights.
+
+bool extract(const Position &pos, Sample &s)
+{
+    std::fill(std::begin(s.features), std::end(s.features), int8_t(0));
+    s.fixed = 0;
+
+    const int toRemove = pos.side_to_move() == WHITE ?
+        pos.piece_to_remove_count() : -pos.piece_to_remove_count();
+    const bool removing = pos.get_action() == Action::remove;
+
+    switch (pos.get_phase()) {
+    case Phase::placing:
+        if (gameOptions.getConsiderMobility()) {
+            s.features[MOBILITY] = (int8_t)pos.get_mobility_diff();
+        }
+
+        s.features[EACH_PIECE_INHAND] = (int8_t)(pos.piece_in_hand_count(WHITE) - pos.piece_in_hand_count(BLACK));
+        s.features[EACH_PIECE_ONBOARD] = (int8_t)(pos.piece_on_board_count(WHITE) - pos.piece_on_board_count(BLACK));
+
+        if (removing) {
+            s.features[EACH_PIECE_PLACING_NEEDREMOVE] = (int8_t)toRemove;
+        }
+
+        break;
+
+    case Phase::moving:
+        s.features[EACH_PIECE_ONBOARD] = (int8_t)(pos.piece_on_board_count(WHITE) - pos.piece_on_board_count(BLACK));
+
+        if (removing) {
+            s.features[EACH_PIECE_MOVING_NEEDREMOVE] = (int8_t)toRemove;
+        }
+
+        break;
+
+    default:
+        return false;
+    }
+
+    if (gameOptions.getConsiderPattern()) {
+        s.fixed = (int8_t)pos.pattern_value();
+    }
+
+    return true;
+}
+
+int linear_eval(const Sample &s, const int *params)
+{
+    int v = s.fixed;
+
+    for (int i = 0; i < PARAM_NB; i++) {
+        v += params[i] * s.features[i];
+    }
+
+    return v;
+}
+
+double sigmoid(double k, int v)
+{
+    return 1.0 / (1.0 + std::exp(-k * v));
+}
+
+/// mean_error() computes the mean squared difference between the results and
+/// the scores predicted from the evaluation with the given weights.
+
+double mean_error(ThreadPool &pool, const vector<Sample> &samples, const int *params, double k)
+{
+    vector<double> sums(pool.size(), 0.0);
+
+    pool.for_each(samples.size(), [&](size_t idx, size_t begin, size_t end) {
+        double sum = 0.0;
+
+        for (size_t i = begin; i < end; i++) {
+            const double d = samples[i].result - sigmoid(k, linear_eval(samples[i], params));
+            sum += d * d;
+        }
+
+        sums[idx] = sum;
+    });
+
+    double sum = 0.0;
+
+    for (double s : sums) {
+        sum += s;
+    }
+
+    return samples.empty() ? 0.0 : sum / samples.size();
+}
+
+/// fit_scale() finds the sigmoid scale that best maps the evaluation with the
+/// default weights to the results, by a coarse scan refined by ternary search.
+
+double fit_scale(ThreadPool &pool, const vector<Sample> &samples, const int *params)
+{
+    double best = 0.01;
+    double bestError = mean_error(pool, samples, params, best);
+
+    for (double k = 0.02; k <= 2.0; k += 0.01) {
+        const double e = mean_error(pool, samples, params, k);
+
+        if (e < bestError) {
+            bestError = e;
+            best = k;
+        }
+    }
+
+    double lo = std::max(0.001, best - 0.01), hi = best + 0.01;
+
+    for (int i = 0; i < 40; i++) {
+        const double m1 = lo + (hi - lo) / 3, m2 = hi - (hi - lo) / 3;
+
+        if (mean_error(pool, samples, params, m1) < mean_error(pool, samples, params, m2)) {
+            hi = m2;
+        } else {
+            lo = m1;
+        }
+    }
+
+    return (lo + hi) / 2;
+}
+
+bool write_header(const string &path, const Rule &r, size_t n, double k,
+                  double before, double after, const int *params)
+{
+    std::ofstream out(path);
+
+    if (!out) {
+        return false;
+    }
+
+    out << "// Generated by sanmill-tune, do not edit.\n"
+        << "//\n"
+        << "// Rule:     " << r.name << "\n"
+        << "// Samples:  " << n << "\n"
+        << "// Scale:    " << k << "\n"
+        << "// Error:    " << before << " -> " << after << "\n"
+        << "//\n"
+        << "// Copy the values into the Value enum of types.h. MOBILITY_WEIGHT\n"
+        << "// scales Position::get_mobility_diff() in the placing phase.\n\n"
+        << "#ifndef TUNED_VALUES_H_INCLUDED\n"
+        << "#define TUNED_VALUES_H_INCLUDED\n\n";
+
+    for (int i = 0; i < PARAM_NB; i++) {
+        out << "#define TUNED_" << ParamNames[i] << " " << params[i] << "\n";
+    }
+
+    out << "\n#endif // #ifndef TUNED_VALUES_H_INCLUDED\n";
+
+    return bool(out);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    vector<string> inputs;
+    string output = "tuned.h";
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    int ruleIdx = DEFAULT_RULE_NUMBER;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+
+        if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "-j" && i + 1 < argc) {
+            threads = (size_t)std::max(1, atoi(argv[++i]));
+        } else if (arg == "-r" && i + 1 < argc) {
+            ruleIdx = atoi(argv[++i]);
+
+            if (ruleIdx < 0 || ruleIdx >= N_RULES) {
+                return usage();
+            }
+        } else if (!arg.empty() && arg[0] == '-') {
+            return usage();
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+
+    if (inputs.empty()) {
+        return usage();
+    }
+
+    std::memcpy((void *)&rule, &RULES[ruleIdx], sizeof(Rule));
+
+    Bitboards::init();
+    Position::init();
+
+    vector<string> lines;
+
+    for (const string &path : inputs) {
+        std::ifstream in(path);
+
+        if (!in) {
+            std::cerr << "Cannot open " << path << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        for (string line; std::getline(in, line);) {
+            if (!line.empty() && line[0] != '#') {
+                lines.push_back(line);
+            }
+        }
+    }
+
+    ThreadPool pool(threads);
+
+    // One position per worker. Constructing them builds the adjacency and
+    // mill tables of the rule, so it is done before the workers start.
+    vector<Position> positions(pool.size());
+    vector<Sample> parsed(lines.size());
+    vector<char> valid(lines.size(), 0);
+    std::atomic<size_t> malformed {0}, mismatched {0};
+
+    // Parse and reduce the positions in parallel. A position is dropped when
+    // the linear model does not reproduce Eval::evaluate() with the default
+    // weights, e.g. when a drawish endgame is scored as a draw.
+    pool.for_each(lines.size(), [&](size_t idx, size_t begin, size_t end) {
+        Position &p = positions[idx];
+
+        for (size_t i = begin; i < end; i++) {
+            const string &line = lines[i];
+            const size_t sep = line.find_last_of(' ');
+            Sample &s = parsed[i];
+
+            if (sep == string::npos || !parse_result(line.substr(sep + 1), s.result)) {
+                malformed++;
+                continue;
+            }
+
+            p.set(line.substr(0, sep), nullptr);
+
+            if (!extract(p, s)) {
+                continue;
+            }
+
+            int v = Eval::evaluate<CustomRule>(p);
+
+            if (p.side_to_move() == BLACK) {
+                v = -v;
+            }
+
+            if (v != linear_eval(s, DefaultParams)) {
+                mismatched++;
+                continue;
+            }
+
+            valid[i] = 1;
+        }
+    });
+
+    vector<Sample> samples;
+
+    for (size_t i = 0; i < parsed.size(); i++) {
+        if (valid[i]) {
+            samples.push_back(parsed[i]);
+        }
+    }
+
+    std::cout << "rule:       " << rule.name << "\n"
+              << "positions:  " << lines.size() << "\n"
+              << "malformed:  " << malformed << "\n"
+              << "mismatched: " << mismatched << "\n"
+              << "samples:    " << samples.size() << std::endl;
+
+    if (samples.empty()) {
+        return EXIT_FAILURE;
+    }
+
+    int params[PARAM_NB];
+    std::copy(std::begin(DefaultParams), std::end(DefaultParams), params);
+
+    const double k = fit_scale(pool, samples, params);
+    const double before = mean_error(pool, samples, params, k);
+    double best = before;
+
+    std::cout << "scale:      " << k << "\n"
+              << "error:      " << before << std::endl;
+
+    // Local search: step each weight up or down while the error decreases
+    for (bool improved = true; improved;) {
+        improved = false;
+
+        for (int i = 0; i < PARAM_NB; i++) {
+            for (int delta : { 1, -1 }) {
+                while (params[i] + delta >= 0 && params[i] + delta <= MaxParam) {
+                    params[i] += delta;
+                    const double e = mean_error(pool, samples, params, k);
+
+                    if (e >= best) {
+                        params[i] -= delta;
+                        break;
+                    }
+
+                    best = e;
+                    improved = true;
+                }
+            }
+        }
+
+        std::cout << "error:      " << best << std::endl;
+    }
+
+    for (int i = 0; i < PARAM_NB; i++) {
+        std::cout << ParamNames[i] << " = " << params[i] << std::endl;
+    }
+
+    if (!write_header(output, rule, samples.size(), k, before, best, params)) {
+        std::cerr << "Cannot write " << output << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
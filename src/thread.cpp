@@ -80,7 +80,10 @@ Thread::~Thread()
 void Thread::clear() noexcept
 {
     // TODO: Reset histories
-    return;
+
+#ifdef EVAL_CACHE_ENABLE
+    evalCache.clear();
+#endif // EVAL_CACHE_ENABLE
 }
 
 
@@ -424,7 +427,11 @@ string Thread::next_move()
             Endgame endgame;
             endgame.type = rootPos->side_to_move() == WHITE ?
                 EndGameType::blackWin : EndGameType::whiteWin;
+#ifdef SYMMETRY_KEY_ENABLE
+            Key endgameHash = rootPos->canonical_key();
+#else
             Key endgameHash = rootPos->key(); // TODO: Do not generate hash repeatedly
+#endif // SYMMETRY_KEY_ENABLE
             saveEndgameHash(endgameHash, endgame);
         }
     }
@@ -448,6 +455,14 @@ string Thread::next_move()
 #endif // TRANSPOSITION_TABLE_DEBUG
 #endif // TRANSPOSITION_TABLE_ENABLE
 
+#ifdef EVAL_CACHE_DEBUG
+    size_t evalProbeCount = evalCache.hits + evalCache.misses;
+    if (evalProbeCount) {
+        loggerDebug("[eval] probe: %zu, hit: %zu, miss: %zu, hit rate: %zu%%\n",
+                    evalProbeCount, evalCache.hits, evalCache.misses, evalCache.hits * 100 / evalProbeCount);
+    }
+#endif // EVAL_CACHE_DEBUG
+
     return UCI::move(bestMove);
 }
 
@@ -507,6 +522,12 @@ void ThreadPool::set(size_t requested)
 
         while (size() < requested)
             push_back(new Thread(size()));
+#ifdef EVAL_CACHE_ENABLE
+        for (Thread *th : *this) {
+            th->evalCache.resize(size_t(Options["EvalCache"]));
+        }
+#endif // EVAL_CACHE_ENABLE
+
         clear();
 
 #ifdef TRANSPOSITION_TABLE_ENABLE
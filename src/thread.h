@@ -24,6 +24,7 @@
 #include <mutex>
 #include <vector>
 
+#include "evaluate.h"
 #include "movepick.h"
 #include "position.h"
 #include "search.h"
@@ -93,6 +94,10 @@ public:
     stopwatch::timer<std::chrono::system_clock>::period sortCycle;
 #endif
 
+#ifdef EVAL_CACHE_ENABLE
+    Eval::Cache evalCache;
+#endif // EVAL_CACHE_ENABLE
+
 #ifdef ENDGAME_LEARNING
     static bool probeEndgameHash(Key key, Endgame &endgame);
     static int saveEndgameHash(Key key, const Endgame &endgame);
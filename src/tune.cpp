@@ -0,0 +1,93 @@
+/*
+  This file is part of Sanmill.
+  Copyright (C) 2019-2021 The Sanmill developers (see AUTHORS file)
+
+  Sanmill is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Sanmill is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tune.h"
+
+#ifdef USE_TUNE
+
+#include <functional>
+#include <string>
+#include <vector>
+
+using std::string;
+
+namespace {
+
+struct Entry
+{
+    string name;
+    int value;
+    int minValue;
+    int maxValue;
+    std::function<void(int)> set;
+};
+
+std::vector<Entry> entries;
+
+template<typename T>
+void add(const string &name, T &v, int minValue, int maxValue)
+{
+    entries.push_back({ name, int(v), minValue, maxValue, [&v](int x) { v = T(x); } });
+}
+
+template<typename T, size_t N>
+void add(const string &name, T (&table)[N], int minValue, int maxValue)
+{
+    for (size_t i = 0; i < N; i++) {
+        add(name + "[" + std::to_string(i) + "]", table[i], minValue, maxValue);
+    }
+}
+
+// Copies the values of all the tuning options into the parameters. Any of
+// them may have changed, so they are all read.
+void on_tune(const UCI::Option &)
+{
+    for (const Entry &e : entries) {
+        e.set(int(Options[e.name]));
+    }
+}
+
+} // namespace
+
+
+/// Tune::init() registers the tunable parameters and adds a spin option for
+/// each of them. The ranges keep the values in the range of their types.
+
+void Tune::init(UCI::OptionsMap &o)
+{
+    add("PvsWindow", PvsWindow, 1, VALUE_MATE_IN_MAX_PLY);
+    add("MtdfWindow", MtdfWindow, 1, VALUE_MATE_IN_MAX_PLY);
+
+    add("QuiescenceNodes", QuiescenceNodes, 1, 64);
+
+    add("RatingOneMill", RatingOneMill, 0, RATING_TT / 3);
+    add("RatingBlockOneMill", RatingBlockOneMill, 0, RATING_TT / 3);
+    add("RatingStarSquare", RatingStarSquare, 0, RATING_TT / 3);
+
+    add("PlacingDepth9", PlacingDepth9, 0, MAX_PLY - 1);
+    add("PlacingDepth12", PlacingDepth12, 0, MAX_PLY - 1);
+    add("DevPlacingDepth12", DevPlacingDepth12, 0, MAX_PLY - 1);
+    add("DevPlacingDepth12Special", DevPlacingDepth12Special, 0, MAX_PLY - 1);
+    add("DevPlacingDepth9", DevPlacingDepth9, 0, MAX_PLY - 1);
+
+    for (const Entry &e : entries) {
+        o[e.name] << UCI::Option(e.value, e.minValue, e.maxValue, on_tune);
+    }
+}
+
+#endif // USE_TUNE
@@ -0,0 +1,110 @@
+/*
+  This file is part of Sanmill.
+  Copyright (C) 2019-2021 The Sanmill developers (see AUTHORS file)
+
+  Sanmill is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Sanmill is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TUNE_H_INCLUDED
+#define TUNE_H_INCLUDED
+
+#include "types.h"
+#include "uci.h"
+
+/// Search and move ordering parameters that an external tuner may change at
+/// run time. In a normal build they are compile-time constants. A build with
+/// tune=yes (USE_TUNE) turns them into globals and exposes every one of them,
+/// and every entry of the tables, as a UCI spin option of the same name.
+
+#ifdef USE_TUNE
+#define TUNABLE inline
+#else
+#define TUNABLE inline constexpr
+#endif
+
+namespace Tune {
+
+// Null windows of the principal variation search and of MTD(f)
+TUNABLE Value PvsWindow = VALUE_PVS_WINDOW;
+TUNABLE Value MtdfWindow = VALUE_MTDF_WINDOW;
+
+// Move ordering bonuses of the move picker
+TUNABLE int RatingOneMill = RATING_ONE_MILL;
+TUNABLE int RatingBlockOneMill = RATING_BLOCK_ONE_MILL;
+TUNABLE int RatingStarSquare = RATING_STAR_SQUARE;
+
+// Nodes the quiescence search may visit below one leaf of the main search
+TUNABLE int QuiescenceNodes = 8;
+
+// Search depths in the placing phase by the number of pieces placed so far,
+// used by Mills::get_search_depth() when drawing on human experience ...
+TUNABLE Depth PlacingDepth9[25] = {
+     +1,  1,  +1,  1,    /* 0 ~ 3 */
+     +3,  3,  +3, 15,    /* 4 ~ 7 */
+     +5,  3,  +5,  0,    /* 8 ~ 11 */
+     +0,  0,  +0,  0,    /* 12 ~ 15 */
+     +0,  0,  +0,  0,    /* 16 ~ 19 */
+     +0,  0,  +0,  0,    /* 20 ~ 23 */
+     +0                  /* 24 */
+};
+
+TUNABLE Depth PlacingDepth12[25] = {
+     +1,  2,  +2,  4,    /* 0 ~ 3 */
+     +4, 12, +12, 18,    /* 4 ~ 7 */
+    +12,  0,  +0,  0,    /* 8 ~ 11 */
+     +0,  0,  +0,  0,    /* 12 ~ 15 */
+     +0,  0,  +0,  0,    /* 16 ~ 19 */
+     +0,  0,  +0,  0,    /* 20 ~ 23 */
+     +0                  /* 24 */
+};
+
+// ... and in developer mode
+TUNABLE Depth DevPlacingDepth12[25] = {
+     +1,  2,  +2,  4,     /* 0 ~ 3 */
+     +4, 12, +12, 18,     /* 4 ~ 7 */
+    +12, 16, +16, 16,     /* 8 ~ 11 */
+    +16, 16, +16, 17,     /* 12 ~ 15 */
+    +17, 16, +16, 15,     /* 16 ~ 19 */
+    +15, 14, +14, 14,     /* 20 ~ 23 */
+    +14                   /* 24 */
+};
+
+TUNABLE Depth DevPlacingDepth12Special[25] = {
+     +1,  2,  +2,  4,     /* 0 ~ 3 */
+     +4, 12, +12, 12,     /* 4 ~ 7 */
+    +12, 13, +13, 13,     /* 8 ~ 11 */
+    +13, 13, +13, 13,     /* 12 ~ 15 */
+    +13, 13, +13, 13,     /* 16 ~ 19 */
+    +13, 13, +13, 13,     /* 20 ~ 23 */
+    +13                   /* 24 */
+};
+
+TUNABLE Depth DevPlacingDepth9[20] = {
+     +1, 7,  +7,  10,     /* 0 ~ 3 */
+    +10, 12, +12, 14,     /* 4 ~ 7 */
+    +14, 14, +14, 14,     /* 8 ~ 11 */
+    +14, 14, +14, 14,     /* 12 ~ 15 */
+    +14, 14, +14,         /* 16 ~ 18 */
+    +14                   /* 19 */
+};
+
+#ifdef USE_TUNE
+void init(UCI::OptionsMap &o);
+#endif
+
+} // namespace Tune
+
+#undef TUNABLE
+
+#endif // #ifndef TUNE_H_INCLUDED
@@ -229,6 +229,12 @@ void UCI::loop(int argc, char *argv[])
         // Additional custom non-UCI commands, mainly for debugging.
         // Do not use these commands during a search!
         else if (token == "d")        sync_cout << *pos << sync_endl;
+        else if (token == "perft") {
+            int depth = 1;
+            is >> depth;
+            const uint64_t nodes = Search::perft(pos, (Depth)depth);
+            sync_cout << "\nNodes searched: " << nodes << "\n" << sync_endl;
+        }
         else if (token == "compiler") sync_cout << compiler_info() << sync_endl;
         else
             sync_cout << "Unknown command: " << cmd << sync_endl;
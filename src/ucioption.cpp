@@ -22,6 +22,13 @@
 #include "thread.h"
 #include "uci.h"
 #include "option.h"
+#include "tune.h"
+
+#include "nnue/evaluate_nnue.h"
+
+#ifdef PERFECT_DATABASE_PROBE_ENABLE
+#include "perfect/perfect.h"
+#endif
 
 using std::string;
 
@@ -45,6 +52,17 @@ void on_hash_size(const Option &o)
 #endif
 }
 
+void on_eval_cache_size(const Option &o)
+{
+#ifdef EVAL_CACHE_ENABLE
+    Threads.main()->wait_for_search_finished();
+
+    for (Thread *th : Threads) {
+        th->evalCache.resize((size_t)o);
+    }
+#endif
+}
+
 void on_logger(const Option &o)
 {
     start_logger(o);
@@ -88,8 +106,37 @@ void on_drawOnHumanExperience(const Option &o)
 void on_considerMobility(const Option &o)
 {
     gameOptions.setConsiderMobility((bool)o);
+    Search::clear();
+}
+
+void on_considerPattern(const Option &o)
+{
+    gameOptions.setConsiderPattern((bool)o);
+    Search::clear();
 }
 
+#ifdef PERFECT_DATABASE_PROBE_ENABLE
+void on_perfectDatabaseProbe(const Option &o)
+{
+    Threads.main()->wait_for_search_finished();
+    gameOptions.setPerfectDatabaseProbeEnabled(perfect_probe_init((bool)o));
+}
+#endif // PERFECT_DATABASE_PROBE_ENABLE
+
+#ifdef NNUE_ENABLE
+void on_use_NNUE(const Option &)
+{
+    Eval::NNUE::init();
+    Search::clear();
+}
+
+void on_eval_file(const Option &)
+{
+    Eval::NNUE::init();
+    Search::clear();
+}
+#endif // NNUE_ENABLE
+
 void on_developerMode(const Option &o)
 {
     gameOptions.setDeveloperMode((bool)o);
@@ -198,6 +245,7 @@ void init(OptionsMap &o)
     o["Threads"] << Option(1, 1, 512, on_threads);
     o["Hash"] << Option(16, 1, MaxHashMB, on_hash_size);
     o["Clear Hash"] << Option(on_clear_hash);
+    o["EvalCache"] << Option(0, 0, 256, on_eval_cache_size);
     o["Ponder"] << Option(false);
     o["MultiPV"] << Option(1, 1, 500);
     o["SkillLevel"] << Option(1, 0, 30, on_skill_level);
@@ -214,6 +262,14 @@ void init(OptionsMap &o)
     o["Algorithm"] << Option(2, 0, 2, on_algorithm);
     o["DrawOnHumanExperience"] << Option(true, on_drawOnHumanExperience);
     o["ConsiderMobility"] << Option(true, on_considerMobility);
+    o["ConsiderPattern"] << Option(false, on_considerPattern);
+#ifdef PERFECT_DATABASE_PROBE_ENABLE
+    o["PerfectDatabaseProbe"] << Option(false, on_perfectDatabaseProbe);
+#endif // PERFECT_DATABASE_PROBE_ENABLE
+#ifdef NNUE_ENABLE
+    o["UseNNUE"] << Option(false, on_use_NNUE);
+    o["EvalFile"] << Option("sanmill.nnue", on_eval_file);
+#endif // NNUE_ENABLE
     o["DeveloperMode"] << Option(true, on_developerMode);
 
     // Rules
@@ -233,6 +289,10 @@ void init(OptionsMap &o)
     o["NMoveRule"] << Option(100, 10, 200, on_nMoveRule);
     o["EndgameNMoveRule"] << Option(100, 5, 200, on_endgameNMoveRule);
     o["ThreefoldRepetitionRule"] << Option(true, on_threefoldRepetitionRule);
+
+#ifdef USE_TUNE
+    Tune::init(o);
+#endif
 }
 
 